@@ -0,0 +1,266 @@
+#include "aabb_batch.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#if !defined(SPICED_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define SPICED_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SPICED_TARGET_AVX __attribute__((target("avx")))
+#else
+#define SPICED_TARGET_AVX
+#endif
+
+namespace spiced
+{
+  namespace {
+    /// Widest block any kernel works on, the arrays are padded to a multiple of it
+    const size_t block_size = 8;
+
+    enum class Test
+    {
+      Intersecting,
+      Touching
+    };
+
+    struct Query
+    {
+      float min_x;
+      float min_y;
+      float max_x;
+      float max_y;
+    };
+
+    Query make_query(const sf::FloatRect &t_box)
+    {
+      // negative sizes are allowed, as with sf::FloatRect::intersects
+      return Query{
+        std::min(t_box.left, t_box.left + t_box.width), std::min(t_box.top, t_box.top + t_box.height),
+        std::max(t_box.left, t_box.left + t_box.width), std::max(t_box.top, t_box.top + t_box.height)
+      };
+    }
+
+    struct Columns
+    {
+      const float *min_x;
+      const float *min_y;
+      const float *max_x;
+      const float *max_y;
+      size_t count;
+    };
+
+    template<Test test>
+    void scalar_kernel(const Columns &t_boxes, const Query &t_query, uint64_t *t_hits)
+    {
+      for (size_t i = 0; i < t_boxes.count; ++i)
+      {
+        bool hit;
+        if (test == Test::Intersecting) {
+          hit = std::max(t_query.min_x, t_boxes.min_x[i]) < std::min(t_query.max_x, t_boxes.max_x[i])
+             && std::max(t_query.min_y, t_boxes.min_y[i]) < std::min(t_query.max_y, t_boxes.max_y[i]);
+        } else {
+          hit = t_query.min_x <= t_boxes.max_x[i] && t_boxes.min_x[i] <= t_query.max_x
+             && t_query.min_y <= t_boxes.max_y[i] && t_boxes.min_y[i] <= t_query.max_y;
+        }
+        t_hits[i / 64] |= uint64_t(hit) << (i % 64);
+      }
+    }
+
+#ifdef SPICED_X86_SIMD
+    template<Test test>
+    void sse2_kernel(const Columns &t_boxes, const Query &t_query, uint64_t *t_hits)
+    {
+      const auto q_min_x = _mm_set1_ps(t_query.min_x);
+      const auto q_min_y = _mm_set1_ps(t_query.min_y);
+      const auto q_max_x = _mm_set1_ps(t_query.max_x);
+      const auto q_max_y = _mm_set1_ps(t_query.max_y);
+
+      for (size_t i = 0; i < t_boxes.count; i += 4)
+      {
+        const auto min_x = _mm_loadu_ps(t_boxes.min_x + i);
+        const auto min_y = _mm_loadu_ps(t_boxes.min_y + i);
+        const auto max_x = _mm_loadu_ps(t_boxes.max_x + i);
+        const auto max_y = _mm_loadu_ps(t_boxes.max_y + i);
+
+        __m128 hit;
+        if (test == Test::Intersecting) {
+          hit = _mm_and_ps(
+              _mm_cmplt_ps(_mm_max_ps(q_min_x, min_x), _mm_min_ps(q_max_x, max_x)),
+              _mm_cmplt_ps(_mm_max_ps(q_min_y, min_y), _mm_min_ps(q_max_y, max_y)));
+        } else {
+          hit = _mm_and_ps(
+              _mm_and_ps(_mm_cmple_ps(q_min_x, max_x), _mm_cmple_ps(min_x, q_max_x)),
+              _mm_and_ps(_mm_cmple_ps(q_min_y, max_y), _mm_cmple_ps(min_y, q_max_y)));
+        }
+
+        t_hits[i / 64] |= uint64_t(_mm_movemask_ps(hit)) << (i % 64);
+      }
+    }
+
+    template<Test test>
+    SPICED_TARGET_AVX void avx_kernel(const Columns &t_boxes, const Query &t_query, uint64_t *t_hits)
+    {
+      const auto q_min_x = _mm256_set1_ps(t_query.min_x);
+      const auto q_min_y = _mm256_set1_ps(t_query.min_y);
+      const auto q_max_x = _mm256_set1_ps(t_query.max_x);
+      const auto q_max_y = _mm256_set1_ps(t_query.max_y);
+
+      for (size_t i = 0; i < t_boxes.count; i += 8)
+      {
+        const auto min_x = _mm256_loadu_ps(t_boxes.min_x + i);
+        const auto min_y = _mm256_loadu_ps(t_boxes.min_y + i);
+        const auto max_x = _mm256_loadu_ps(t_boxes.max_x + i);
+        const auto max_y = _mm256_loadu_ps(t_boxes.max_y + i);
+
+        __m256 hit;
+        if (test == Test::Intersecting) {
+          hit = _mm256_and_ps(
+              _mm256_cmp_ps(_mm256_max_ps(q_min_x, min_x), _mm256_min_ps(q_max_x, max_x), _CMP_LT_OQ),
+              _mm256_cmp_ps(_mm256_max_ps(q_min_y, min_y), _mm256_min_ps(q_max_y, max_y), _CMP_LT_OQ));
+        } else {
+          hit = _mm256_and_ps(
+              _mm256_and_ps(_mm256_cmp_ps(q_min_x, max_x, _CMP_LE_OQ), _mm256_cmp_ps(min_x, q_max_x, _CMP_LE_OQ)),
+              _mm256_and_ps(_mm256_cmp_ps(q_min_y, max_y, _CMP_LE_OQ), _mm256_cmp_ps(min_y, q_max_y, _CMP_LE_OQ)));
+        }
+
+        t_hits[i / 64] |= uint64_t(_mm256_movemask_ps(hit)) << (i % 64);
+      }
+    }
+
+    bool cpu_has_avx()
+    {
+#if defined(__GNUC__)
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx");
+#elif defined(_MSC_VER)
+      // the cpu has to support it, and the OS has to save the ymm registers
+      int info[4];
+      __cpuid(info, 1);
+      const bool avx = (info[2] & (1 << 28)) != 0;
+      const bool osxsave = (info[2] & (1 << 27)) != 0;
+      return avx && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+      return false;
+#endif
+    }
+#endif
+
+    Simd_Level detect_simd_level()
+    {
+#ifdef SPICED_X86_SIMD
+      return cpu_has_avx() ? Simd_Level::Avx : Simd_Level::Sse2;
+#else
+      return Simd_Level::Scalar;
+#endif
+    }
+
+    template<Test test>
+    void run_kernel(const Columns &t_boxes, const sf::FloatRect &t_box, std::vector<uint64_t> &t_hits)
+    {
+      t_hits.assign((t_boxes.count + 63) / 64, 0);
+      const auto query = make_query(t_box);
+
+      switch (simd_level())
+      {
+#ifdef SPICED_X86_SIMD
+        case Simd_Level::Avx:
+          avx_kernel<test>(t_boxes, query, t_hits.data());
+          return;
+        case Simd_Level::Sse2:
+          sse2_kernel<test>(t_boxes, query, t_hits.data());
+          return;
+#endif
+        default:
+          scalar_kernel<test>(t_boxes, query, t_hits.data());
+          return;
+      }
+    }
+  }
+
+  Simd_Level simd_level()
+  {
+    static const auto level = detect_simd_level();
+    return level;
+  }
+
+  const char *to_string(const Simd_Level t_level)
+  {
+    switch (t_level)
+    {
+      case Simd_Level::Scalar: return "scalar";
+      case Simd_Level::Sse2: return "SSE2";
+      case Simd_Level::Avx: return "AVX";
+    }
+    return "unknown";
+  }
+
+
+  size_t Aabb_Batch::size() const
+  {
+    return m_size;
+  }
+
+  size_t Aabb_Batch::memory_bytes() const
+  {
+    return (m_min_x.capacity() + m_min_y.capacity() + m_max_x.capacity() + m_max_y.capacity()) * sizeof(float);
+  }
+
+  void Aabb_Batch::clear()
+  {
+    m_min_x.clear();
+    m_min_y.clear();
+    m_max_x.clear();
+    m_max_y.clear();
+    m_size = 0;
+  }
+
+  void Aabb_Batch::reserve(const size_t t_size)
+  {
+    const auto padded = (t_size + block_size - 1) / block_size * block_size;
+    m_min_x.reserve(padded);
+    m_min_y.reserve(padded);
+    m_max_x.reserve(padded);
+    m_max_y.reserve(padded);
+  }
+
+  void Aabb_Batch::push_back(const sf::FloatRect &t_box)
+  {
+    if (m_size == m_min_x.size())
+    {
+      // padding boxes are inverted, so no test ever matches them
+      const auto inf = std::numeric_limits<float>::infinity();
+      m_min_x.resize(m_size + block_size, inf);
+      m_min_y.resize(m_size + block_size, inf);
+      m_max_x.resize(m_size + block_size, -inf);
+      m_max_y.resize(m_size + block_size, -inf);
+    }
+
+    set(m_size++, t_box);
+  }
+
+  void Aabb_Batch::set(const size_t t_index, const sf::FloatRect &t_box)
+  {
+    const auto query = make_query(t_box);
+    m_min_x[t_index] = query.min_x;
+    m_min_y[t_index] = query.min_y;
+    m_max_x[t_index] = query.max_x;
+    m_max_y[t_index] = query.max_y;
+  }
+
+  void Aabb_Batch::intersecting(const sf::FloatRect &t_box, std::vector<uint64_t> &t_hits) const
+  {
+    run_kernel<Test::Intersecting>(Columns{ m_min_x.data(), m_min_y.data(), m_max_x.data(), m_max_y.data(), m_min_x.size() }, t_box, t_hits);
+  }
+
+  void Aabb_Batch::touching(const sf::FloatRect &t_box, std::vector<uint64_t> &t_hits) const
+  {
+    run_kernel<Test::Touching>(Columns{ m_min_x.data(), m_min_y.data(), m_max_x.data(), m_max_y.data(), m_min_x.size() }, t_box, t_hits);
+  }
+}
+
@@ -0,0 +1,80 @@
+#ifndef GAME_ENGINE_AABB_BATCH_HPP
+#define GAME_ENGINE_AABB_BATCH_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace spiced
+{
+  enum class Simd_Level
+  {
+    Scalar,
+    Sse2,
+    Avx
+  };
+
+  /// Widest instruction set the batch kernels use on this machine, detected on first use
+  Simd_Level simd_level();
+
+  const char *to_string(const Simd_Level t_level);
+
+  /// Axis aligned boxes stored as packed min/max arrays, so that one query box can be tested against
+  /// all of them a block at a time. Queries produce a hit mask, bit i being set if box i matched.
+  class Aabb_Batch
+  {
+  public:
+    size_t size() const;
+
+    /// Heap bytes of the coordinate arrays, padding included
+    size_t memory_bytes() const;
+
+    void clear();
+    void reserve(const size_t t_size);
+    void push_back(const sf::FloatRect &t_box);
+    void set(const size_t t_index, const sf::FloatRect &t_box);
+
+    /// Boxes with a non-empty overlap with t_box, as sf::FloatRect::intersects
+    void intersecting(const sf::FloatRect &t_box, std::vector<uint64_t> &t_hits) const;
+
+    /// Boxes that overlap or share an edge with t_box, as touches() from collision.hpp
+    void touching(const sf::FloatRect &t_box, std::vector<uint64_t> &t_hits) const;
+
+    /// Calls t_visitor(index) for every bit set in t_hits, in increasing order
+    template<typename Visitor>
+    static void for_each_hit(const std::vector<uint64_t> &t_hits, Visitor &&t_visitor)
+    {
+      for (size_t word = 0; word < t_hits.size(); ++word)
+      {
+        for (auto bits = t_hits[word]; bits != 0; bits &= bits - 1)
+        {
+          t_visitor(word * 64 + lowest_bit(bits));
+        }
+      }
+    }
+
+  private:
+    static size_t lowest_bit(const uint64_t t_bits)
+    {
+#if defined(__GNUC__)
+      return size_t(__builtin_ctzll(t_bits));
+#else
+      size_t bit = 0;
+      while (!((t_bits >> bit) & 1)) {
+        ++bit;
+      }
+      return bit;
+#endif
+    }
+
+    /// Padded with empty boxes up to a whole block, so the kernels never need a scalar tail
+    std::vector<float> m_min_x;
+    std::vector<float> m_min_y;
+    std::vector<float> m_max_x;
+    std::vector<float> m_max_y;
+    size_t m_size = 0;
+  };
+}
+
+#endif
+
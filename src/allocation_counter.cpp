@@ -0,0 +1,191 @@
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace spiced {
+  namespace {
+    const size_t max_zones = 64;
+
+    // no containers, registering a zone must not allocate. Slots are claimed before they are filled, readers skip empty ones.
+    std::atomic<Allocation_Zone *> zones[max_zones];
+    std::atomic<size_t> zone_count(0);
+
+    std::atomic<uint64_t> allocations(0);
+    std::atomic<uint64_t> frame_start(0);
+    std::atomic<uint64_t> last_frame_allocations(0);
+
+    thread_local uint64_t thread_count = 0;
+  }
+
+#ifdef SPICED_COUNT_ALLOCATIONS
+  namespace {
+    void *counted_allocate(const size_t t_size) noexcept
+    {
+      ++thread_count;
+      allocations.fetch_add(1, std::memory_order_relaxed);
+      return std::malloc(t_size == 0 ? 1 : t_size);
+    }
+
+    void *allocate(const size_t t_size)
+    {
+      for (;;)
+      {
+        if (auto p = counted_allocate(t_size)) {
+          return p;
+        }
+
+        const auto handler = std::get_new_handler();
+        if (!handler) {
+          throw std::bad_alloc();
+        }
+        handler();
+      }
+    }
+  }
+#endif
+
+  Allocation_Zone::Allocation_Zone(const char *t_name)
+    : m_name(t_name), m_frame(0), m_last_frame(0), m_total(0)
+  {
+    const auto index = zone_count++;
+    if (index < max_zones) {
+      zones[index].store(this);
+    }
+  }
+
+  const char *Allocation_Zone::name() const
+  {
+    return m_name;
+  }
+
+  uint64_t Allocation_Zone::last_frame() const
+  {
+    return m_last_frame.load(std::memory_order_relaxed);
+  }
+
+  uint64_t Allocation_Zone::total() const
+  {
+    return m_total.load(std::memory_order_relaxed);
+  }
+
+
+  Allocation_Scope::Allocation_Scope(Allocation_Zone &t_zone)
+    : m_zone(t_zone), m_start(thread_count)
+  {
+  }
+
+  Allocation_Scope::~Allocation_Scope()
+  {
+    const auto count = thread_count - m_start;
+    m_zone.m_frame.fetch_add(count, std::memory_order_relaxed);
+    m_zone.m_total.fetch_add(count, std::memory_order_relaxed);
+  }
+
+
+  bool Allocation_Counter::enabled()
+  {
+#ifdef SPICED_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  uint64_t Allocation_Counter::thread_allocations()
+  {
+    return thread_count;
+  }
+
+  uint64_t Allocation_Counter::total()
+  {
+    return allocations.load(std::memory_order_relaxed);
+  }
+
+  void Allocation_Counter::end_frame()
+  {
+    const auto now = allocations.load(std::memory_order_relaxed);
+    last_frame_allocations.store(now - frame_start.exchange(now), std::memory_order_relaxed);
+
+    const auto count = std::min(zone_count.load(), max_zones);
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (auto zone = zones[i].load()) {
+        zone->m_last_frame.store(zone->m_frame.exchange(0), std::memory_order_relaxed);
+      }
+    }
+  }
+
+  uint64_t Allocation_Counter::last_frame()
+  {
+    return last_frame_allocations.load(std::memory_order_relaxed);
+  }
+
+  std::string Allocation_Counter::report()
+  {
+    if (!enabled()) {
+      return "allocation counting disabled";
+    }
+
+    std::string report = "allocations last frame: " + std::to_string(last_frame());
+
+    const char *separator = " (";
+    const auto count = std::min(zone_count.load(), max_zones);
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (auto zone = zones[i].load())
+      {
+        report += separator;
+        report += zone->name();
+        report += ": " + std::to_string(zone->last_frame());
+        separator = ", ";
+      }
+    }
+
+    return separator[0] == ',' ? report + ")" : report;
+  }
+}
+
+#ifdef SPICED_COUNT_ALLOCATIONS
+void *operator new(std::size_t t_size)
+{
+  return spiced::allocate(t_size);
+}
+
+void *operator new[](std::size_t t_size)
+{
+  return spiced::allocate(t_size);
+}
+
+void *operator new(std::size_t t_size, const std::nothrow_t &) noexcept
+{
+  return spiced::counted_allocate(t_size);
+}
+
+void *operator new[](std::size_t t_size, const std::nothrow_t &) noexcept
+{
+  return spiced::counted_allocate(t_size);
+}
+
+void operator delete(void *t_ptr) noexcept
+{
+  std::free(t_ptr);
+}
+
+void operator delete[](void *t_ptr) noexcept
+{
+  std::free(t_ptr);
+}
+
+void operator delete(void *t_ptr, const std::nothrow_t &) noexcept
+{
+  std::free(t_ptr);
+}
+
+void operator delete[](void *t_ptr, const std::nothrow_t &) noexcept
+{
+  std::free(t_ptr);
+}
+#endif
+
@@ -0,0 +1,81 @@
+#ifndef GAME_ENGINE_ALLOCATION_COUNTER_HPP
+#define GAME_ENGINE_ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace spiced
+{
+  /// A named part of the frame whose heap allocations are counted, entered with an Allocation_Scope.
+  /// Zones register themselves without allocating, so they must have static storage duration:
+  ///
+  ///     static Allocation_Zone zone("Game::update");
+  ///     Allocation_Scope scope(zone);
+  class Allocation_Zone
+  {
+  public:
+    explicit Allocation_Zone(const char *t_name);
+    Allocation_Zone(const Allocation_Zone &) = delete;
+    Allocation_Zone &operator=(const Allocation_Zone &) = delete;
+
+    const char *name() const;
+
+    /// Allocations made inside the zone during the last finished frame
+    uint64_t last_frame() const;
+
+    uint64_t total() const;
+
+  private:
+    friend class Allocation_Scope;
+    friend class Allocation_Counter;
+
+    const char *m_name;
+    std::atomic<uint64_t> m_frame;
+    std::atomic<uint64_t> m_last_frame;
+    std::atomic<uint64_t> m_total;
+  };
+
+  /// Counts the allocations the current thread makes while it is alive into a zone.
+  /// Work handed to other threads, such as job system workers, is not included.
+  class Allocation_Scope
+  {
+  public:
+    explicit Allocation_Scope(Allocation_Zone &t_zone);
+    Allocation_Scope(const Allocation_Scope &) = delete;
+    Allocation_Scope &operator=(const Allocation_Scope &) = delete;
+    ~Allocation_Scope();
+
+  private:
+    Allocation_Zone &m_zone;
+    uint64_t m_start;
+  };
+
+  /// Heap allocations made through the global operator new, counted per thread and per frame.
+  ///
+  /// Counting is compiled in with SPICED_COUNT_ALLOCATIONS (the ENABLE_ALLOCATION_COUNTER cmake option),
+  /// which replaces the global operator new. Without it every count stays 0 and enabled() is false.
+  class Allocation_Counter
+  {
+  public:
+    static bool enabled();
+
+    /// Allocations made by the calling thread since it started
+    static uint64_t thread_allocations();
+
+    /// Allocations made by all threads since the program started
+    static uint64_t total();
+
+    /// Closes the current frame, called once per frame by the main loop
+    static void end_frame();
+
+    /// Allocations made by all threads during the last finished frame
+    static uint64_t last_frame();
+
+    /// One line with the last frame's allocations, overall and per zone
+    static std::string report();
+  };
+}
+
+#endif
+
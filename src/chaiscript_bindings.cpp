@@ -1,6 +1,7 @@
 #include "game.hpp"
 #include "map.hpp"
 #include "game_event.hpp"
+#include "pathfinding.hpp"
 #include "chaiscript_bindings.hpp"
 
 #include "ChaiScript/include/chaiscript/chaiscript.hpp"
@@ -23,12 +24,27 @@ namespace spiced {
     module->add(chaiscript::user_type<Game>(), "Game");
     ADD_FUN(Game, get_texture);
     ADD_FUN(Game, get_font);
+    ADD_FUN(Game, get_texture_handle);
+    ADD_FUN(Game, prefetch_texture);
+    module->add(
+      chaiscript::fun([](Game &t_game, const size_t t_bytes)
+          {
+            t_game.resources().set_budget(t_bytes);
+          }), "set_resource_budget");
+    module->add(
+      chaiscript::fun([](const Game &t_game)
+          {
+            return t_game.resources().stats().total_bytes();
+          }), "resource_memory_used");
     ADD_FUN(Game, teleport_to);
     ADD_FUN(Game, teleport_to_tile);
     ADD_FUN(Game, set_avatar);
     ADD_FUN(Game, add_map);
     ADD_FUN(Game, add_start_action);
     ADD_FUN(Game, add_queued_action);
+    ADD_FUN(Game, add_priority_action);
+    ADD_FUN(Game, add_concurrent_action);
+    ADD_FUN(Game, add_timed_action);
     ADD_FUN(Game, show_message_box);
     module->add(
       chaiscript::fun([](Game &t_game, const std::string &t_msg)
@@ -43,12 +59,18 @@ namespace spiced {
             t_game.game().show_selection_menu(t_game.state(), t_selections);
           }), "show_selection_menu");
     ADD_FUN(Game, show_conversation);
+    ADD_FUN(Game, show_shop);
+    ADD_FUN(Game, add_condition);
+    ADD_FUN(Game, load_content);
+    ADD_FUN(Game, get_conversation);
+    ADD_FUN(Game, set_character);
     ADD_FUN(Game, has_pending_events);
     ADD_FUN(Game, get_current_event);
     ADD_FUN(Game, update);
     ADD_FUN(Game, draw);
     ADD_FUN(Game, get_avatar_position);
     ADD_FUN(Game, enter_map);
+    ADD_FUN(Game, memory_report);
     ADD_FUN(Game, has_current_map);
     ADD_FUN(Game, get_current_map);
     ADD_FUN(Game, start);
@@ -60,6 +82,11 @@ namespace spiced {
     ADD_FUN(Game, set_zoom);
     ADD_FUN(Game, rotate);
     ADD_FUN(Game, zoom);
+    ADD_FUN(Game, save_game);
+    ADD_FUN(Game, load_game);
+    ADD_FUN(Game, set_autosave);
+    ADD_FUN(Game, set_bake_layers);
+    ADD_FUN(Game, bake_layers);
 
     module->add(chaiscript::fun(&Game::get_input_direction_vector), "get_input_direction_vector");
 
@@ -127,6 +154,8 @@ namespace spiced {
     module->add(chaiscript::user_type<Script_Parser>(), "Script_Parser");
     module->add(chaiscript::constructor<Script_Parser()>(), "Script_Parser");
     ADD_FUN(Script_Parser, collision_action_parser);
+    ADD_FUN(Script_Parser, collision_action);
+    ADD_FUN(Script_Parser, compiled_collision_actions);
 
 
     module->add(chaiscript::constructor<Tile_Map(Game &, const std::string &, std::vector<Tile_Defaults>, const Script_Parser &)>(), "Tile_Map");
@@ -144,6 +173,65 @@ namespace spiced {
     ADD_FUN(Tile_Map, set_collision_action);
     ADD_FUN(Tile_Map, set_action_generator);
     ADD_FUN(Tile_Map, set_portrait);
+    ADD_FUN(Tile_Map, add_exit);
+    ADD_FUN(Tile_Map, memory_usage);
+    ADD_FUN(Tile_Map, is_streamed);
+    ADD_FUN(Tile_Map, world_offset);
+    ADD_FUN(Tile_Map, set_stream_radius);
+    ADD_FUN(Tile_Map, add_chunk_load_action);
+    ADD_FUN(Tile_Map, add_chunk_unload_action);
+
+    module->add(chaiscript::user_type<Map_Memory>(), "Map_Memory");
+    ADD_FUN(Map_Memory, total);
+    ADD_FUN(Map_Memory, tileset_bytes);
+    ADD_FUN(Map_Memory, property_bytes);
+    ADD_FUN(Map_Memory, passability_bytes);
+    ADD_FUN(Map_Memory, object_bytes);
+    ADD_FUN(Map_Memory, object_tileset_bytes);
+    ADD_FUN(Map_Memory, chunk_bytes);
+    ADD_FUN(Map_Memory, layer_bytes);
+    module->add(
+      chaiscript::fun([](const Map_Memory &t_memory)
+          {
+            return t_memory.layers.size();
+          }), "layer_count");
+    module->add(
+      chaiscript::fun([](const Map_Memory &t_memory, const size_t t_layer)
+          {
+            return t_memory.layers.at(t_layer).total();
+          }), "layer_bytes");
+    ADD_FUN(Tile_Map, invalidate_paths);
+    ADD_FUN(Tile_Map, set_velocity);
+    ADD_FUN(Tile_Map, walk_to);
+    ADD_FUN(Tile_Map, set_wander);
+    ADD_FUN(Tile_Map, stop);
+    ADD_FUN(Tile_Map, tile_at);
+
+    // tile coordinates are passed as plain ints, paths come back as a script Vector of Tile_Positions
+    module->add(chaiscript::user_type<sf::Vector2i>(), "Tile_Position");
+    module->add(chaiscript::constructor<sf::Vector2i(int, int)>(), "Tile_Position");
+    module->add(chaiscript::fun(&sf::Vector2i::x), "x");
+    module->add(chaiscript::fun(&sf::Vector2i::y), "y");
+    module->add(
+      chaiscript::fun([](const Tile_Map &t_map, const int t_from_x, const int t_from_y, const int t_to_x, const int t_to_y)
+          {
+            std::vector<chaiscript::Boxed_Value> path;
+            for (const auto &tile : t_map.find_path(sf::Vector2i(t_from_x, t_from_y), sf::Vector2i(t_to_x, t_to_y)))
+            {
+              path.push_back(chaiscript::var(tile));
+            }
+            return path;
+          }), "find_path");
+    module->add(
+      chaiscript::fun([](const Tile_Map &t_map, const int t_from_x, const int t_from_y, const int t_to_x, const int t_to_y)
+          {
+            return t_map.is_reachable(sf::Vector2i(t_from_x, t_from_y), sf::Vector2i(t_to_x, t_to_y));
+          }), "is_reachable");
+    module->add(
+      chaiscript::fun([](const Tile_Map &t_map, const int t_x, const int t_y)
+          {
+            return int(t_map.region_at(sf::Vector2i(t_x, t_y)));
+          }), "region_at");
 
     module->add(chaiscript::type_conversion<std::string, sf::String>());
 
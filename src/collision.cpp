@@ -0,0 +1,95 @@
+#include "collision.hpp"
+#include "pathfinding.hpp"
+
+#include <limits>
+
+namespace spiced {
+  sf::FloatRect swept_bounds(const sf::FloatRect &t_box, const sf::Vector2f &t_distance)
+  {
+    return sf::FloatRect(t_box.left + std::min(0.0f, t_distance.x), t_box.top + std::min(0.0f, t_distance.y),
+        t_box.width + std::abs(t_distance.x), t_box.height + std::abs(t_distance.y));
+  }
+
+  bool touches(const sf::FloatRect &t_lhs, const sf::FloatRect &t_rhs)
+  {
+    return t_lhs.left <= t_rhs.left + t_rhs.width && t_rhs.left <= t_lhs.left + t_lhs.width
+        && t_lhs.top <= t_rhs.top + t_rhs.height && t_rhs.top <= t_lhs.top + t_lhs.height;
+  }
+
+  void sweep_box(const sf::FloatRect &t_box, const sf::Vector2f &t_distance, const sf::FloatRect &t_target, Sweep_Hit &t_hit)
+  {
+    if (t_box.intersects(t_target)) {
+      return;
+    }
+
+    const auto infinity = std::numeric_limits<float>::infinity();
+
+    // the interval of the move during which the boxes overlap on one axis
+    const auto axis = [infinity](const float t_min, const float t_size, const float t_target_min, const float t_target_size,
+        const float t_move, float &t_entry, float &t_exit) {
+      const auto max = t_min + t_size;
+      const auto target_max = t_target_min + t_target_size;
+
+      if (t_move > 0) {
+        t_entry = (t_target_min - max) / t_move;
+        t_exit = (target_max - t_min) / t_move;
+      } else if (t_move < 0) {
+        t_entry = (target_max - t_min) / t_move;
+        t_exit = (t_target_min - max) / t_move;
+      } else if (max > t_target_min && t_min < target_max) {
+        t_entry = -infinity;
+        t_exit = infinity;
+      } else {
+        return false;
+      }
+      return true;
+    };
+
+    float x_entry, x_exit, y_entry, y_exit;
+    if (!axis(t_box.left, t_box.width, t_target.left, t_target.width, t_distance.x, x_entry, x_exit)
+        || !axis(t_box.top, t_box.height, t_target.top, t_target.height, t_distance.y, y_entry, y_exit))
+    {
+      return;
+    }
+
+    const auto entry = std::max(x_entry, y_entry);
+    const auto exit = std::min(x_exit, y_exit);
+
+    // exactly grazing a corner (entry == exit) is not a contact
+    if (entry >= exit || entry < 0 || entry >= t_hit.time) {
+      return;
+    }
+
+    t_hit.time = entry;
+    if (x_entry > y_entry) {
+      t_hit.normal = sf::Vector2f(t_distance.x > 0 ? -1.0f : 1.0f, 0);
+    } else {
+      t_hit.normal = sf::Vector2f(0, t_distance.y > 0 ? -1.0f : 1.0f);
+    }
+  }
+
+  void sweep_tiles(const Passability_Grid &t_tiles, const sf::Vector2u &t_tile_size, const sf::FloatRect &t_box,
+      const sf::Vector2f &t_distance, const bool t_outside_blocks, Sweep_Hit &t_hit)
+  {
+    const auto area = swept_bounds(t_box, t_distance);
+    const auto tile_width = float(t_tile_size.x);
+    const auto tile_height = float(t_tile_size.y);
+
+    const auto x0 = int(std::floor(area.left / tile_width));
+    const auto y0 = int(std::floor(area.top / tile_height));
+    const auto x1 = int(std::floor((area.left + area.width) / tile_width));
+    const auto y1 = int(std::floor((area.top + area.height) / tile_height));
+
+    for (int y = y0; y <= y1; ++y)
+    {
+      for (int x = x0; x <= x1; ++x)
+      {
+        const auto blocked = t_tiles.in_bounds(x, y) ? !t_tiles.passable(x, y) : t_outside_blocks;
+        if (blocked) {
+          sweep_box(t_box, t_distance, sf::FloatRect(x * tile_width, y * tile_height, tile_width, tile_height), t_hit);
+        }
+      }
+    }
+  }
+}
+
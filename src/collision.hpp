@@ -0,0 +1,81 @@
+#ifndef GAME_ENGINE_COLLISION_HPP
+#define GAME_ENGINE_COLLISION_HPP
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace spiced
+{
+  class Passability_Grid;
+
+  /// Earliest contact found while sweeping a box along a move
+  struct Sweep_Hit
+  {
+    /// Fraction of the move done at the moment of contact, 1 if nothing was hit
+    float time = 1;
+
+    /// Points away from the surface that was hit, zero if nothing was hit
+    sf::Vector2f normal;
+
+    bool hit() const
+    {
+      return time < 1;
+    }
+  };
+
+  /// How far a sliding box stays away from what it hit, so rounding can never leave the two overlapping
+  const float contact_skin = 0.01f;
+
+  /// The area covered by t_box while moving by t_distance
+  sf::FloatRect swept_bounds(const sf::FloatRect &t_box, const sf::Vector2f &t_distance);
+
+  /// Like sf::Rect::intersects, but boxes that only share an edge count as touching
+  bool touches(const sf::FloatRect &t_lhs, const sf::FloatRect &t_rhs);
+
+  /// Sweeps t_box by t_distance against the static t_target, keeping the earliest contact in t_hit.
+  /// A target the box already overlaps is ignored, so that anything stuck inside something can move free.
+  void sweep_box(const sf::FloatRect &t_box, const sf::Vector2f &t_distance, const sf::FloatRect &t_target, Sweep_Hit &t_hit);
+
+  /// Sweeps t_box against every impassable tile it passes, outside of the grid counts as impassable if t_outside_blocks
+  void sweep_tiles(const Passability_Grid &t_tiles, const sf::Vector2u &t_tile_size, const sf::FloatRect &t_box,
+      const sf::Vector2f &t_distance, const bool t_outside_blocks, Sweep_Hit &t_hit);
+
+  /// Returns how far t_box gets when moved by t_distance, sliding along whatever it hits: after a contact
+  /// the rest of the move loses its component along the contact normal and is swept once more.
+  /// t_sweep(box, distance, hit) records the earliest contact of a move in hit.
+  template<typename Sweep>
+  sf::Vector2f slide_move(const sf::FloatRect &t_box, const sf::Vector2f &t_distance, Sweep &&t_sweep)
+  {
+    sf::Vector2f moved;
+    auto remaining = t_distance;
+    auto box = t_box;
+
+    for (int iteration = 0; iteration < 2 && remaining != sf::Vector2f(0, 0); ++iteration)
+    {
+      Sweep_Hit hit;
+      t_sweep(box, remaining, hit);
+
+      if (!hit.hit())
+      {
+        moved += remaining;
+        break;
+      }
+
+      const auto length = std::sqrt(remaining.x * remaining.x + remaining.y * remaining.y);
+      const auto step = remaining * std::max(0.0f, hit.time - contact_skin / length);
+      moved += step;
+      box.left += step.x;
+      box.top += step.y;
+
+      remaining *= 1 - hit.time;
+      if (hit.normal.x != 0) remaining.x = 0;
+      if (hit.normal.y != 0) remaining.y = 0;
+    }
+
+    return moved;
+  }
+}
+
+#endif
+
@@ -0,0 +1,192 @@
+#include "content_library.hpp"
+#include "game.hpp"
+
+#include "SimpleJSON/json.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace spiced {
+  namespace {
+    template<typename Map>
+    const typename Map::mapped_type &find_named(const Map &t_map, const std::string &t_kind, const std::string &t_name)
+    {
+      const auto itr = t_map.find(t_name);
+      if (itr == t_map.end()) {
+        throw std::runtime_error("Unknown " + t_kind + ": '" + t_name + "'");
+      }
+      return itr->second;
+    }
+
+    std::string optional_string(const json::JSON &t_json, const std::string &t_key)
+    {
+      return t_json.hasKey(t_key) ? t_json.at(t_key).ToString() : std::string();
+    }
+
+    /// "flag" must be set, "!flag" must not be
+    std::vector<std::pair<std::string, bool>> flag_tests(const json::JSON &t_json)
+    {
+      std::vector<std::pair<std::string, bool>> tests;
+      if (t_json.hasKey("if")) {
+        for (const auto &test : t_json.at("if").ArrayRange()) {
+          const auto flag = test.ToString();
+          if (!flag.empty() && flag[0] == '!') {
+            tests.emplace_back(flag.substr(1), false);
+          } else {
+            tests.emplace_back(flag, true);
+          }
+        }
+      }
+      return tests;
+    }
+  }
+
+  void Content_Library::add_condition(const std::string &t_name, Condition t_condition)
+  {
+    m_conditions[t_name] = std::move(t_condition);
+  }
+
+  const Content_Library::Condition &Content_Library::condition(const std::string &t_name) const
+  {
+    return find_named(m_conditions, "condition", t_name);
+  }
+
+  const std::shared_ptr<const Conversation> &Content_Library::conversation(const std::string &t_name) const
+  {
+    return find_named(m_conversations, "conversation", t_name);
+  }
+
+  const std::shared_ptr<const Shop> &Content_Library::shop(const std::string &t_name) const
+  {
+    return find_named(m_shops, "shop", t_name);
+  }
+
+  const Character &Content_Library::character(const std::string &t_name) const
+  {
+    return find_named(m_characters, "character", t_name);
+  }
+
+  void Content_Library::load(const std::string &t_file_path)
+  {
+    std::ifstream ifs(t_file_path);
+    if (!ifs) {
+      throw std::runtime_error("Unable to open content file: '" + t_file_path + "'");
+    }
+
+    std::stringstream buff;
+    buff << ifs.rdbuf();
+    const auto json = json::JSON::Load(buff.str());
+
+    if (json.hasKey("conversations"))
+    {
+      for (const auto &conversation : json.at("conversations").ObjectRange())
+      {
+        std::vector<Question> questions;
+
+        for (const auto &question : conversation.second.ArrayRange())
+        {
+          std::vector<Answer> answers;
+          if (question.hasKey("answers")) {
+            for (const auto &answer : question.at("answers").ArrayRange()) {
+              answers.emplace_back(answer.at("speaker").ToString(), answer.at("text").ToString());
+            }
+          }
+
+          const auto tests = flag_tests(question);
+          const auto condition_name = optional_string(question, "condition");
+          const auto script_condition = condition_name.empty() ? Condition() : condition(condition_name);
+
+          std::function<bool (const Game_State &, Object &)> is_available;
+          if (!tests.empty() || script_condition)
+          {
+            is_available = [tests, script_condition](const Game_State &t_game, Object &) {
+              for (const auto &test : tests) {
+                if (t_game.game().get_flag(test.first) != test.second) {
+                  return false;
+                }
+              }
+              return !script_condition || script_condition(t_game);
+            };
+          }
+
+          std::vector<std::string> flags;
+          if (question.hasKey("set")) {
+            for (const auto &flag : question.at("set").ArrayRange()) {
+              flags.push_back(flag.ToString());
+            }
+          }
+
+          std::function<void (const Game_State &, Object &)> action;
+          if (!flags.empty())
+          {
+            action = [flags](const Game_State &t_game, Object &) {
+              for (const auto &flag : flags) {
+                t_game.game().set_flag(flag, true);
+              }
+            };
+          }
+
+          questions.emplace_back(question.at("question").ToString(), std::move(answers), std::move(is_available), std::move(action));
+        }
+
+        m_conversations[conversation.first] = std::make_shared<const Conversation>(questions);
+      }
+    }
+
+    if (json.hasKey("shops"))
+    {
+      for (const auto &shop_json : json.at("shops").ObjectRange())
+      {
+        const auto &definition = shop_json.second;
+        auto shop = std::make_shared<Shop>();
+
+        for (const auto &good : definition.at("goods").ArrayRange()) {
+          shop->goods.push_back(Shop_Good{good.at("item").ToString(), good.at("label").ToString(), int(good.at("price").ToInt())});
+        }
+
+        if (definition.hasKey("upgrades")) {
+          for (const auto &upgrade : definition.at("upgrades").ArrayRange()) {
+            shop->upgrades.push_back(Shop_Upgrade{upgrade.at("label").ToString(), upgrade.at("flag").ToString(), int(upgrade.at("price").ToInt())});
+          }
+        }
+
+        shop->cargo_limit = int(definition.at("cargo_limit").ToInt());
+        shop->refuse_if = optional_string(definition, "refuse_if");
+        shop->refusal = optional_string(definition, "refusal");
+
+        if (!shop->refuse_if.empty()) {
+          // fail at load time rather than the first time the shop is opened
+          condition(shop->refuse_if);
+        }
+
+        m_shops[shop_json.first] = std::move(shop);
+      }
+    }
+
+    if (json.hasKey("characters"))
+    {
+      for (const auto &character_json : json.at("characters").ObjectRange())
+      {
+        const auto &definition = character_json.second;
+
+        Character character;
+        character.look = optional_string(definition, "look");
+
+        const auto conversation_name = optional_string(definition, "conversation");
+        if (!conversation_name.empty()) {
+          character.conversation = conversation(conversation_name);
+        }
+
+        const auto shop_name = optional_string(definition, "shop");
+        if (!shop_name.empty()) {
+          character.shop = shop(shop_name);
+        }
+
+        m_characters[character_json.first] = std::move(character);
+      }
+    }
+  }
+}
+
@@ -0,0 +1,103 @@
+#ifndef GAME_ENGINE_CONTENT_LIBRARY_HPP
+#define GAME_ENGINE_CONTENT_LIBRARY_HPP
+
+#include "game_event.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  class Game_State;
+
+  struct Shop_Good
+  {
+    /// Game value counting how many the player carries, also used in messages
+    std::string item;
+    std::string label;
+    int price;
+  };
+
+  /// Bought once, owning it is remembered in a flag
+  struct Shop_Upgrade
+  {
+    std::string label;
+    std::string flag;
+    int price;
+  };
+
+  struct Shop
+  {
+    std::vector<Shop_Good> goods;
+    std::vector<Shop_Upgrade> upgrades;
+
+    /// Most goods the player can carry, counting the items this shop trades
+    int cargo_limit;
+
+    /// Named condition which, when true, makes the shop refuse to open with the refusal message
+    std::string refuse_if;
+    std::string refusal;
+  };
+
+  /// The actions offered when interacting with a character, any part may be empty
+  struct Character
+  {
+    std::string look;
+    std::shared_ptr<const Conversation> conversation;
+    std::shared_ptr<const Shop> shop;
+  };
+
+  /// Dialogue trees, shops and characters loaded from a JSON content file.
+  ///
+  /// Flag tests and flag changes are evaluated natively, script is only needed for conditions
+  /// that can't be written as flags. Those are registered by name with add_condition() before
+  /// the file that refers to them is loaded.
+  ///
+  ///     {
+  ///       "conversations": {
+  ///         "Joshua": [
+  ///           { "question": "Hello", "answers": [ { "speaker": "Joshua", "text": "Hi!" } ] },
+  ///           { "question": "Rumors", "answers": [],
+  ///             "if": [ "heard_rumors", "!talked_to_Joshua" ], "condition": "script_condition",
+  ///             "set": [ "talked_to_Joshua" ] }
+  ///         ]
+  ///       },
+  ///       "shops": {
+  ///         "glennhaven": { "cargo_limit": 5, "refuse_if": "script_condition", "refusal": "Go away",
+  ///                         "goods": [ { "item": "bread", "label": "Bread", "price": 80 } ],
+  ///                         "upgrades": [ { "label": "tire chains", "flag": "has_tire_chains", "price": 150 } ] }
+  ///       },
+  ///       "characters": {
+  ///         "Joshua": { "look": "The proprietor", "conversation": "Joshua", "shop": "glennhaven" }
+  ///       }
+  ///     }
+  class Content_Library
+  {
+  public:
+    typedef std::function<bool (const Game_State &)> Condition;
+
+    void add_condition(const std::string &t_name, Condition t_condition);
+
+    /// Adds the content of t_file_path, replacing entries with the same names
+    void load(const std::string &t_file_path);
+
+    /// Throws std::runtime_error if nothing with the name was loaded
+    const std::shared_ptr<const Conversation> &conversation(const std::string &t_name) const;
+    const std::shared_ptr<const Shop> &shop(const std::string &t_name) const;
+    const Character &character(const std::string &t_name) const;
+
+    /// Throws std::runtime_error if no condition with the name was registered
+    const Condition &condition(const std::string &t_name) const;
+
+  private:
+    std::map<std::string, Condition> m_conditions;
+    std::map<std::string, std::shared_ptr<const Conversation>> m_conversations;
+    std::map<std::string, std::shared_ptr<const Shop>> m_shops;
+    std::map<std::string, Character> m_characters;
+  };
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include "dialogue_graph.hpp"
+#include "game_event.hpp"
+#include "text_geometry.hpp"
+
+#include <unordered_map>
+
+namespace spiced {
+  const uint32_t Dialogue_Graph::none;
+
+  Dialogue_Graph::Dialogue_Graph(const std::vector<Question> &t_questions)
+  {
+    // only needed while compiling, lookups afterwards go straight to an index
+    std::unordered_map<std::string, uint32_t> interned;
+    auto intern = [this, &interned](const std::string &t_string) {
+      const auto inserted = interned.emplace(t_string, uint32_t(m_strings.size()));
+      if (inserted.second) {
+        m_strings.push_back(t_string);
+      }
+      return inserted.first->second;
+    };
+
+    m_nodes.reserve(t_questions.size());
+
+    for (const auto &q : t_questions)
+    {
+      Node node;
+      node.question = intern(q.question);
+      node.first_line = uint32_t(m_lines.size());
+
+      for (const auto &answer : q.answers)
+      {
+        Line line;
+        line.speaker = intern(answer.speaker);
+        line.answer = intern(answer.answer);
+        line.message = intern(answer.speaker + ":\n\n" + answer.answer);
+        m_lines.push_back(line);
+      }
+
+      node.end_line = uint32_t(m_lines.size());
+
+      node.predicate = none;
+      if (q.is_available) {
+        node.predicate = uint32_t(m_predicates.size());
+        m_predicates.push_back(q.is_available);
+      }
+
+      node.action = none;
+      if (q.action) {
+        node.action = uint32_t(m_actions.size());
+        m_actions.push_back(q.action);
+      }
+
+      m_nodes.push_back(node);
+    }
+
+    m_strings.shrink_to_fit();
+    m_message_text.resize(m_lines.size());
+  }
+
+  const std::vector<Dialogue_Graph::Node> &Dialogue_Graph::nodes() const
+  {
+    return m_nodes;
+  }
+
+  const std::vector<Dialogue_Graph::Line> &Dialogue_Graph::lines() const
+  {
+    return m_lines;
+  }
+
+  const std::string &Dialogue_Graph::string(const uint32_t t_index) const
+  {
+    return m_strings.at(t_index);
+  }
+
+  bool Dialogue_Graph::is_available(const Node &t_node, const Game_State &t_game, Object &t_obj) const
+  {
+    return t_node.predicate == none || m_predicates[t_node.predicate](t_game, t_obj);
+  }
+
+  void Dialogue_Graph::run_action(const Node &t_node, const Game_State &t_game, Object &t_obj) const
+  {
+    if (t_node.action != none) {
+      m_actions[t_node.action](t_game, t_obj);
+    }
+  }
+
+  std::shared_ptr<const Text_Geometry> Dialogue_Graph::message_text(const uint32_t t_line, const Font_Handle &t_font,
+      const unsigned int t_character_size, const sf::Color &t_color) const
+  {
+    auto &text = m_message_text.at(t_line);
+
+    const bool current = text.geometry && text.geometry->font == t_font
+      && text.geometry->character_size == t_character_size && text.color == t_color;
+
+    if (!current)
+    {
+      auto geometry = std::make_shared<Text_Geometry>(t_font, t_character_size);
+      geometry->add_line(string(m_lines[t_line].message), sf::Vector2f(0, 0), t_color);
+      text.geometry = std::move(geometry);
+      text.color = t_color;
+    }
+
+    return text.geometry;
+  }
+}
+
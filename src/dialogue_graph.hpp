@@ -0,0 +1,88 @@
+#ifndef GAME_ENGINE_DIALOGUE_GRAPH_HPP
+#define GAME_ENGINE_DIALOGUE_GRAPH_HPP
+
+#include "resource_handle.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  class Object;
+  class Game_State;
+  struct Question;
+  struct Text_Geometry;
+
+  /// A conversation compiled once into an immutable graph: one node per question, each pointing
+  /// at a contiguous range of answer lines. Every string is interned, so a speaker named on many
+  /// lines is stored once, and the text shown for each line is composed when the graph is built.
+  ///
+  /// Graphs are shared by every copy of their Conversation and by the menu actions built from it.
+  class Dialogue_Graph
+  {
+  public:
+    typedef std::function<bool (const Game_State &, Object &)> Predicate;
+    typedef std::function<void (const Game_State &, Object &)> Action;
+
+    static const uint32_t none = 0xFFFFFFFF;
+
+    struct Line
+    {
+      uint32_t speaker;
+      uint32_t answer;
+
+      /// "speaker:\n\nanswer", as shown in the message box
+      uint32_t message;
+    };
+
+    struct Node
+    {
+      uint32_t question;
+
+      /// [first_line, end_line) range of lines()
+      uint32_t first_line;
+      uint32_t end_line;
+
+      /// Indices into the predicate and action tables, none if the question is always available / has no action
+      uint32_t predicate;
+      uint32_t action;
+    };
+
+    explicit Dialogue_Graph(const std::vector<Question> &t_questions);
+    Dialogue_Graph(const Dialogue_Graph &) = delete;
+    Dialogue_Graph &operator=(const Dialogue_Graph &) = delete;
+
+    const std::vector<Node> &nodes() const;
+    const std::vector<Line> &lines() const;
+    const std::string &string(const uint32_t t_index) const;
+
+    bool is_available(const Node &t_node, const Game_State &t_game, Object &t_obj) const;
+    void run_action(const Node &t_node, const Game_State &t_game, Object &t_obj) const;
+
+    /// Laid out glyphs of a line's message. Built on first use and reused by every later showing
+    /// with the same font, size and colour. Main thread only.
+    std::shared_ptr<const Text_Geometry> message_text(const uint32_t t_line, const Font_Handle &t_font,
+        const unsigned int t_character_size, const sf::Color &t_color) const;
+
+  private:
+    struct Message_Text
+    {
+      std::shared_ptr<const Text_Geometry> geometry;
+      sf::Color color;
+    };
+
+    std::vector<std::string> m_strings;
+    std::vector<Line> m_lines;
+    std::vector<Node> m_nodes;
+    std::vector<Predicate> m_predicates;
+    std::vector<Action> m_actions;
+
+    mutable std::vector<Message_Text> m_message_text;
+  };
+}
+
+#endif
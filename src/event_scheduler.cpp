@@ -0,0 +1,132 @@
+#include "event_scheduler.hpp"
+#include "game.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace spiced {
+  void Event_Deleter::operator()(Game_Event *t_event) const
+  {
+    // the block begins at the most derived object, which is not necessarily the Game_Event base
+    void *block = dynamic_cast<void *>(t_event);
+    t_event->~Game_Event();
+    pool->release(block);
+  }
+
+
+  void *Event_Pool::allocate()
+  {
+    if (!m_free)
+    {
+      m_chunks.emplace_back(new char[block_size * blocks_per_chunk]);
+      char *chunk = m_chunks.back().get();
+      for (size_t i = blocks_per_chunk; i > 0; --i)
+      {
+        auto block = reinterpret_cast<Free_Block *>(chunk + (i - 1) * block_size);
+        block->next = m_free;
+        m_free = block;
+      }
+    }
+
+    auto block = m_free;
+    m_free = block->next;
+    ++m_in_use;
+    return block;
+  }
+
+  void Event_Pool::release(void *t_block)
+  {
+    assert(m_in_use > 0);
+    auto block = static_cast<Free_Block *>(t_block);
+    block->next = m_free;
+    m_free = block;
+    --m_in_use;
+  }
+
+  size_t Event_Pool::blocks_allocated() const
+  {
+    return m_chunks.size() * blocks_per_chunk;
+  }
+
+  size_t Event_Pool::blocks_in_use() const
+  {
+    return m_in_use;
+  }
+
+
+  Event_Scheduler::Event_Scheduler()
+    : m_pool(new Event_Pool())
+  {
+  }
+
+  bool Event_Scheduler::runs_after(const Entry &t_lhs, const Entry &t_rhs)
+  {
+    // heap comparator: the top of the heap is the highest priority, earliest submitted event
+    if (t_lhs.priority != t_rhs.priority)
+    {
+      return t_lhs.priority < t_rhs.priority;
+    }
+
+    return t_lhs.sequence > t_rhs.sequence;
+  }
+
+  bool Event_Scheduler::promote()
+  {
+    if (!m_current && !m_pending.empty())
+    {
+      std::pop_heap(m_pending.begin(), m_pending.end(), &Event_Scheduler::runs_after);
+      m_current = std::move(m_pending.back().event);
+      m_pending.pop_back();
+    }
+
+    return bool(m_current);
+  }
+
+  bool Event_Scheduler::has_blocking_events() const
+  {
+    return m_current || !m_pending.empty();
+  }
+
+  Game_Event &Event_Scheduler::current() const
+  {
+    if (m_current)
+    {
+      return *m_current;
+    }
+    else if (!m_pending.empty()) {
+      return *m_pending.front().event;
+    }
+    else {
+      throw std::runtime_error("No pending event!");
+    }
+  }
+
+  void Event_Scheduler::update(const Game_State &t_game)
+  {
+    // events added while updating are appended, they get their first update next frame
+    const auto num_concurrent = m_concurrent.size();
+    for (size_t i = 0; i < num_concurrent; ++i)
+    {
+      m_concurrent[i]->update(t_game);
+    }
+
+    m_concurrent.erase(
+        std::remove_if(m_concurrent.begin(), m_concurrent.end(), [](const Event_Ptr &t_event) { return t_event->is_done(); }),
+        m_concurrent.end());
+
+    for (int count = 0; count < max_events_per_frame && promote(); ++count)
+    {
+      m_current->update(t_game);
+
+      if (!m_current->is_done())
+      {
+        break;
+      }
+
+      m_current.reset();
+    }
+
+    promote();
+  }
+}
@@ -0,0 +1,155 @@
+#ifndef GAME_ENGINE_EVENT_SCHEDULER_HPP
+#define GAME_ENGINE_EVENT_SCHEDULER_HPP
+
+#include "game_event.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace spiced
+{
+  class Event_Pool;
+
+  struct Event_Deleter
+  {
+    Event_Deleter()
+      : pool(nullptr)
+    {
+    }
+
+    explicit Event_Deleter(Event_Pool *t_pool)
+      : pool(t_pool)
+    {
+    }
+
+    void operator()(Game_Event *t_event) const;
+
+    Event_Pool *pool;
+  };
+
+  namespace detail
+  {
+    template<typename T>
+    constexpr T static_max(T t_lhs, T t_rhs)
+    {
+      return t_lhs < t_rhs ? t_rhs : t_lhs;
+    }
+  }
+
+  typedef std::unique_ptr<Game_Event, Event_Deleter> Event_Ptr;
+
+  /// Fixed size block allocator for the engine's Game_Event types.
+  /// Blocks are recycled through a free list, so steady state event traffic never reaches the heap.
+  class Event_Pool
+  {
+  public:
+    Event_Pool() = default;
+    Event_Pool(const Event_Pool &) = delete;
+    Event_Pool &operator=(const Event_Pool &) = delete;
+
+    template<typename T, typename ... Param>
+    Event_Ptr make(Param && ... t_param)
+    {
+      static_assert(sizeof(T) <= block_size, "Event type is too large for Event_Pool, add it to block_size");
+
+      void *block = allocate();
+      try {
+        return Event_Ptr(new (block) T(std::forward<Param>(t_param)...), Event_Deleter(this));
+      } catch (...) {
+        release(block);
+        throw;
+      }
+    }
+
+    void release(void *t_block);
+
+    size_t blocks_allocated() const;
+    size_t blocks_in_use() const;
+
+  private:
+    static constexpr size_t alignment = alignof(std::max_align_t);
+    static constexpr size_t largest_event = detail::static_max(sizeof(Queued_Action),
+        detail::static_max(sizeof(Delayed_Action), detail::static_max(sizeof(Message_Box),
+        detail::static_max(sizeof(Selection_Menu), sizeof(Object_Interaction_Menu)))));
+    static constexpr size_t block_size = ((largest_event + alignment - 1) / alignment) * alignment;
+    static constexpr size_t blocks_per_chunk = 16;
+
+    struct Free_Block
+    {
+      Free_Block *next;
+    };
+
+    void *allocate();
+
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    Free_Block *m_free = nullptr;
+    size_t m_in_use = 0;
+  };
+
+
+  /// Owns and runs the game's events.
+  ///
+  /// Blocking events pause the simulation and run one at a time, highest priority first
+  /// and in submission order within a priority. An event that has started is never
+  /// preempted. Every event that completes immediately is retired within the same frame,
+  /// so a chain of queued actions no longer costs one frame per link.
+  ///
+  /// Concurrent events run every frame alongside the simulation and never pause it.
+  class Event_Scheduler
+  {
+  public:
+    /// Upper bound on blocking events retired per frame, protects against
+    /// scripts which endlessly requeue themselves
+    static const int max_events_per_frame = 256;
+
+    Event_Scheduler();
+
+    template<typename T, typename ... Param>
+    void add(const int t_priority, Param && ... t_param)
+    {
+      m_pending.push_back(Entry{t_priority, m_sequence++, m_pool->make<T>(std::forward<Param>(t_param)...)});
+      std::push_heap(m_pending.begin(), m_pending.end(), &Event_Scheduler::runs_after);
+    }
+
+    template<typename T, typename ... Param>
+    void add_concurrent(Param && ... t_param)
+    {
+      m_concurrent.push_back(m_pool->make<T>(std::forward<Param>(t_param)...));
+    }
+
+    bool has_blocking_events() const;
+
+    /// The blocking event currently being shown
+    Game_Event &current() const;
+
+    void update(const Game_State &t_game);
+
+  private:
+    struct Entry
+    {
+      int priority;
+      uint64_t sequence;
+      Event_Ptr event;
+    };
+
+    static bool runs_after(const Entry &t_lhs, const Entry &t_rhs);
+
+    bool promote();
+
+    // declared first so that it outlives every event it allocated
+    std::unique_ptr<Event_Pool> m_pool;
+
+    Event_Ptr m_current;
+    std::vector<Entry> m_pending;
+    std::vector<Event_Ptr> m_concurrent;
+    uint64_t m_sequence = 0;
+  };
+}
+
+#endif
+
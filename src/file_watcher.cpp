@@ -0,0 +1,133 @@
+#include "file_watcher.hpp"
+#include "log.hpp"
+#include "resource_manager.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace spiced {
+#ifdef __linux__
+  namespace {
+    std::string parent_directory(const std::string &t_path)
+    {
+      const auto slash = t_path.rfind('/');
+
+      if (slash == std::string::npos) {
+        return ".";
+      } else if (slash == 0) {
+        return "/";
+      } else {
+        return t_path.substr(0, slash);
+      }
+    }
+
+    std::string join_path(const std::string &t_directory, const std::string &t_name)
+    {
+      if (t_directory == ".") {
+        return t_name;
+      } else if (!t_directory.empty() && t_directory.back() == '/') {
+        return t_directory + t_name;
+      } else {
+        return t_directory + '/' + t_name;
+      }
+    }
+  }
+#endif
+
+  File_Watcher::File_Watcher()
+  {
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+    {
+      SPICED_LOG(Resources, Warning, "Unable to initialize inotify, hot reloading is disabled: " << std::strerror(errno));
+    }
+#endif
+  }
+
+  File_Watcher::~File_Watcher()
+  {
+#ifdef __linux__
+    if (m_fd >= 0)
+    {
+      close(m_fd);
+    }
+#endif
+  }
+
+  void File_Watcher::watch(const std::string &t_path)
+  {
+    const auto path = Resource_Manager::normalize(t_path);
+
+    if (!m_files.insert(path).second || m_fd < 0) {
+      return;
+    }
+
+#ifdef __linux__
+    const auto directory = parent_directory(path);
+
+    const auto already_watched = std::any_of(m_directories.begin(), m_directories.end(),
+        [&directory](const std::pair<const int, std::string> &t_dir) { return t_dir.second == directory; });
+
+    if (!already_watched)
+    {
+      // only finished writes and renames, a file that was just created may still be empty or half written
+      const auto wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd < 0)
+      {
+        SPICED_LOG(Resources, Warning, "Unable to watch " << directory << ": " << std::strerror(errno));
+      } else {
+        m_directories[wd] = directory;
+      }
+    }
+#endif
+  }
+
+  std::vector<std::string> File_Watcher::poll()
+  {
+    std::vector<std::string> changed;
+
+#ifdef __linux__
+    if (m_fd < 0) {
+      return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+
+    for (;;)
+    {
+      const auto len = read(m_fd, buffer, sizeof(buffer));
+      if (len <= 0) {
+        // EAGAIN, nothing left to read
+        break;
+      }
+
+      for (ssize_t offset = 0; offset < len; )
+      {
+        const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        const auto directory = m_directories.find(event->wd);
+        if (directory == m_directories.end() || event->len == 0) {
+          continue;
+        }
+
+        const auto path = Resource_Manager::normalize(join_path(directory->second, event->name));
+        if (m_files.count(path) && std::find(changed.begin(), changed.end(), path) == changed.end())
+        {
+          changed.push_back(path);
+        }
+      }
+    }
+#endif
+
+    return changed;
+  }
+}
+
@@ -0,0 +1,40 @@
+#ifndef GAME_ENGINE_FILE_WATCHER_HPP
+#define GAME_ENGINE_FILE_WATCHER_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  /// Reports files that were rewritten on disk, for hot reloading maps and scripts.
+  ///
+  /// Uses inotify on Linux, watching the parent directory of each file so that editors which
+  /// save by writing a new file and renaming it over the old one are picked up as well.
+  /// On other platforms nothing is ever reported.
+  class File_Watcher
+  {
+  public:
+    File_Watcher();
+    File_Watcher(const File_Watcher &) = delete;
+    File_Watcher &operator=(const File_Watcher &) = delete;
+    ~File_Watcher();
+
+    /// Starts watching t_path, watching the same file twice has no effect
+    void watch(const std::string &t_path);
+
+    /// Returns the watched files changed since the last call, each reported once. Never blocks.
+    std::vector<std::string> poll();
+
+  private:
+    int m_fd = -1;
+
+    /// watch descriptor -> watched directory
+    std::map<int, std::string> m_directories;
+    std::set<std::string> m_files;
+  };
+}
+
+#endif
+
@@ -0,0 +1,87 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace spiced {
+  const size_t Frame_Arena::default_capacity;
+
+  namespace {
+    size_t align_up(const size_t t_value, const size_t t_alignment)
+    {
+      return (t_value + t_alignment - 1) / t_alignment * t_alignment;
+    }
+  }
+
+  Frame_Arena::Frame_Arena(const size_t t_capacity)
+    : m_block(new char[t_capacity]),
+      m_capacity(t_capacity)
+  {
+  }
+
+  void *Frame_Arena::allocate(const size_t t_bytes, const size_t t_alignment)
+  {
+    const auto base = reinterpret_cast<uintptr_t>(m_block.get());
+    const auto offset = align_up(base + m_used, t_alignment) - base;
+
+    if (offset + t_bytes <= m_capacity)
+    {
+      m_used = offset + t_bytes;
+      return m_block.get() + offset;
+    }
+
+    // kept until the next reset, when the block grows to make room for this frame's usage
+    m_overflow.emplace_back(new char[t_bytes + t_alignment]);
+    m_overflow_bytes += t_bytes;
+    ++m_overflows;
+
+    const auto overflow = reinterpret_cast<uintptr_t>(m_overflow.back().get());
+    return reinterpret_cast<void *>(align_up(overflow, t_alignment));
+  }
+
+  void Frame_Arena::deallocate(void *t_ptr, const size_t t_bytes)
+  {
+    // only the latest allocation can be given back early, which is what a growing vector does
+    const auto ptr = static_cast<char *>(t_ptr);
+    if (ptr >= m_block.get() && ptr + t_bytes == m_block.get() + m_used)
+    {
+      m_used = size_t(ptr - m_block.get());
+    }
+  }
+
+  void Frame_Arena::reset()
+  {
+    m_high_water_mark = std::max(m_high_water_mark, used());
+
+    if (!m_overflow.empty())
+    {
+      m_overflow.clear();
+      m_capacity = std::max(m_capacity * 2, m_high_water_mark);
+      m_block.reset(new char[m_capacity]);
+    }
+
+    m_used = 0;
+    m_overflow_bytes = 0;
+  }
+
+  size_t Frame_Arena::capacity() const
+  {
+    return m_capacity;
+  }
+
+  size_t Frame_Arena::used() const
+  {
+    return m_used + m_overflow_bytes;
+  }
+
+  size_t Frame_Arena::high_water_mark() const
+  {
+    return std::max(m_high_water_mark, used());
+  }
+
+  size_t Frame_Arena::overflows() const
+  {
+    return m_overflows;
+  }
+}
+
@@ -0,0 +1,109 @@
+#ifndef GAME_ENGINE_FRAME_ARENA_HPP
+#define GAME_ENGINE_FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace spiced
+{
+  /// Bump allocator for the temporaries of one frame. Allocating moves a pointer, freeing does
+  /// nothing except for the most recent allocation, and reset() hands everything back at once.
+  ///
+  /// Allocations that don't fit the block fall back to the heap. The next reset() grows the block
+  /// to the frame's high water mark, so a steady state frame runs in a single block.
+  ///
+  /// Not thread safe: owned by the Game and used by the simulation thread only.
+  class Frame_Arena
+  {
+  public:
+    static const size_t default_capacity = 64 * 1024;
+
+    explicit Frame_Arena(const size_t t_capacity = default_capacity);
+    Frame_Arena(const Frame_Arena &) = delete;
+    Frame_Arena &operator=(const Frame_Arena &) = delete;
+
+    void *allocate(const size_t t_bytes, const size_t t_alignment);
+    void deallocate(void *t_ptr, const size_t t_bytes);
+
+    /// Releases every allocation made since the last reset, nothing allocated from the arena may be used afterwards
+    void reset();
+
+    size_t capacity() const;
+
+    /// Bytes handed out since the last reset, overflow included
+    size_t used() const;
+
+    /// Most bytes used by a single frame so far
+    size_t high_water_mark() const;
+
+    /// Allocations that did not fit the block and went to the heap, over all frames
+    size_t overflows() const;
+
+  private:
+    std::unique_ptr<char[]> m_block;
+    size_t m_capacity;
+    size_t m_used = 0;
+
+    std::vector<std::unique_ptr<char[]>> m_overflow;
+    size_t m_overflow_bytes = 0;
+
+    size_t m_high_water_mark = 0;
+    size_t m_overflows = 0;
+  };
+
+  /// Standard allocator interface over a Frame_Arena, for containers that don't outlive the frame
+  template<typename T>
+  class Arena_Allocator
+  {
+  public:
+    typedef T value_type;
+
+    explicit Arena_Allocator(Frame_Arena &t_arena) noexcept
+      : m_arena(&t_arena)
+    {
+    }
+
+    template<typename U>
+    Arena_Allocator(const Arena_Allocator<U> &t_other) noexcept
+      : m_arena(&t_other.arena())
+    {
+    }
+
+    T *allocate(const size_t t_count)
+    {
+      return static_cast<T *>(m_arena->allocate(t_count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *t_ptr, const size_t t_count) noexcept
+    {
+      m_arena->deallocate(t_ptr, t_count * sizeof(T));
+    }
+
+    Frame_Arena &arena() const
+    {
+      return *m_arena;
+    }
+
+  private:
+    Frame_Arena *m_arena;
+  };
+
+  template<typename T, typename U>
+  bool operator==(const Arena_Allocator<T> &t_lhs, const Arena_Allocator<U> &t_rhs)
+  {
+    return &t_lhs.arena() == &t_rhs.arena();
+  }
+
+  template<typename T, typename U>
+  bool operator!=(const Arena_Allocator<T> &t_lhs, const Arena_Allocator<U> &t_rhs)
+  {
+    return !(t_lhs == t_rhs);
+  }
+
+  template<typename T>
+  using Frame_Vector = std::vector<T, Arena_Allocator<T>>;
+}
+
+#endif
+
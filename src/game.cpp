@@ -1,9 +1,15 @@
 
 #include "game.hpp"
+#include "allocation_counter.hpp"
+#include "dialogue_graph.hpp"
 #include "game_event.hpp"
+#include "log.hpp"
 #include "map.hpp"
+#include "render_snapshot.hpp"
+#include "text_geometry.hpp"
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <functional>
 #include <deque>
 #include <memory>
@@ -11,30 +17,83 @@
 #include <cmath>
 
 namespace spiced {
+  const char *Game::ui_font_path = "resources/FreeMonoBold.ttf";
+  const int Game::ui_font_size = 17;
+  const float Game::memory_overlay_interval = 0.5f;
+
+  namespace {
+    std::string kib(const size_t t_bytes)
+    {
+      return std::to_string((t_bytes + 1023) / 1024) + " KiB";
+    }
+
+    int cargo(const Game &t_game, const Shop &t_shop)
+    {
+      int count = 0;
+      for (const auto &good : t_shop.goods) {
+        count += t_game.get_value(good.item);
+      }
+      return count;
+    }
+
+    bool purchase(Game &t_game, const int t_price)
+    {
+      const auto money = t_game.get_value("money");
+      if (money >= t_price) {
+        t_game.set_value("money", money - t_price);
+        return true;
+      } else {
+        t_game.show_message_box("You don't have enough cash");
+        return false;
+      }
+    }
+  }
+
   Game::Game()
-    : m_map(m_maps.end()),
+    : Game(std::make_shared<Resource_Manager>(std::make_shared<Job_System>()))
+  {
+  }
+
+  Game::Game(std::shared_ptr<Resource_Manager> t_resources)
+    : m_resources(std::move(t_resources)),
+    m_map(m_maps.end()),
     m_rotate(0),
-    m_zoom(1)
+    m_zoom(1),
+    m_frame_arena(new Frame_Arena()),
+    m_movement(new Movement_System(m_resources->jobs())),
+    m_saver(new Save_Writer(m_resources->jobs()))
   {
   }
 
 
   const sf::Texture &Game::get_texture(const std::string &t_filename) const
   {
-    auto texture_itr = m_textures.find(t_filename);
-    if (texture_itr != m_textures.end())
-    {
-      return texture_itr->second;
-    }
-    else {
-      sf::Texture texture;
-      if (!texture.loadFromFile(t_filename))
-      {
-        throw std::runtime_error("Unable to load texture: " + t_filename);
-      }
-      auto itr = m_textures.emplace(t_filename, std::move(texture));
-      return itr.first->second;
-    }
+    return m_resources->pinned_texture(t_filename);
+  }
+
+  Texture_Handle Game::get_texture_handle(const std::string &t_filename) const
+  {
+    return m_resources->texture(t_filename);
+  }
+
+  void Game::prefetch_texture(const std::string &t_filename)
+  {
+    m_resources->prefetch(t_filename);
+  }
+
+  Resource_Manager &Game::resources() const
+  {
+    return *m_resources;
+  }
+
+  Job_System &Game::jobs() const
+  {
+    return m_resources->jobs();
+  }
+
+  Frame_Arena &Game::frame_arena() const
+  {
+    return *m_frame_arena;
   }
 
   void Game::teleport_to(const float x, const float y)
@@ -73,54 +132,61 @@ namespace spiced {
 
   const sf::Font &Game::get_font(const std::string &t_filename) const
   {
-    auto font_itr = m_fonts.find(t_filename);
-    if (font_itr != m_fonts.end())
-    {
-      return font_itr->second;
-    }
-    else {
-      sf::Font font;
-      if (!font.loadFromFile(t_filename))
-      {
-        throw std::runtime_error("Unable to load font: " + t_filename);
-      }
-      auto itr = m_fonts.emplace(t_filename, std::move(font));
-      return itr.first->second;
-    }
+    return m_resources->pinned_font(t_filename);
+  }
+
+  Font_Handle Game::get_font_handle(const std::string &t_filename) const
+  {
+    return m_resources->font(t_filename);
   }
 
   void Game::add_queued_action(const std::function<void(const Game_State &)> &t_action)
   {
-    m_game_events.emplace_back(new Queued_Action(t_action));
+    m_game_events.add<Queued_Action>(0, t_action);
+  }
+
+  void Game::add_priority_action(const std::function<void(const Game_State &)> &t_action, const int t_priority)
+  {
+    m_game_events.add<Queued_Action>(t_priority, t_action);
+  }
+
+  void Game::add_concurrent_action(const std::function<void(const Game_State &)> &t_action)
+  {
+    m_game_events.add_concurrent<Queued_Action>(t_action);
   }
 
-  void Game::show_message_box(const sf::String &t_msg, const sf::Texture *t_texture)
+  void Game::add_timed_action(const float t_delay, const std::function<void(const Game_State &)> &t_action)
   {
-    m_game_events.emplace_back(new Message_Box(t_msg, get_font("resources/FreeMonoBold.ttf"), 17, sf::Color(255, 255, 255, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, Location::Bottom, t_texture));
+    m_game_events.add_concurrent<Delayed_Action>(t_delay, t_action);
+  }
+
+  void Game::show_message_box(const sf::String &t_msg, Texture_Handle t_texture)
+  {
+    const auto portrait = t_texture ? std::make_shared<const Texture_Handle>(std::move(t_texture)) : Async_Texture_Handle();
+    m_game_events.add<Message_Box>(0, t_msg, get_font_handle(ui_font_path), ui_font_size, sf::Color(255, 255, 255, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, Location::Bottom, portrait);
   }
 
   void Game::show_conversation(const Simulation_State &t_state, Object &t_obj, const Conversation &t_conversation)
   {
+    // the portrait is needed as soon as an answer is picked, load it while the menu is up
+    if (!t_obj.get_portrait().empty()) {
+      prefetch_texture(t_obj.get_portrait());
+    }
+
+    const auto &graph = t_conversation.graph;
+    const auto &nodes = graph->nodes();
+    const Game_State game(t_state, *this);
+
     std::vector<Object_Action> actions;
-    for (const auto &q : t_conversation.questions)
+    for (size_t i = 0; i < nodes.size(); ++i)
     {
-      if (!q.is_available || q.is_available(Game_State(t_state, *this), t_obj))
+      if (graph->is_available(nodes[i], game, t_obj))
       {
-        actions.emplace_back(q.question,
-          [q, t_state, &t_obj, t_conversation](const Game_State &t_game, Object &obj)
+        // the graph is shared, not copied, into each option
+        actions.emplace_back(graph->string(nodes[i].question),
+          [graph, i](const Game_State &t_game, Object &obj)
           {
-            for (const auto &answer : q.answers) {
-              const std::string portrait = obj.get_portrait();
-              const sf::Texture *texture = nullptr;
-              if (!portrait.empty()) {
-                texture = &t_game.game().get_texture(portrait);
-              }
-              t_game.game().show_message_box(answer.speaker + ":\n\n" + answer.answer, texture);
-            }
-            if (q.action) {
-              using namespace std::placeholders;
-              t_game.game().add_queued_action(std::bind(q.action, _1, std::ref(obj)));
-            }
+            t_game.game().show_dialogue_node(graph, i, obj);
           }
         );
       }
@@ -135,71 +201,275 @@ namespace spiced {
     }
 
 
-    m_game_events.emplace_back(new Object_Interaction_Menu(t_obj, get_font("resources/FreeMonoBold.ttf"), 17, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, actions, Location::Bottom));
+    m_game_events.add<Object_Interaction_Menu>(0, *this, t_obj, get_font_handle(ui_font_path), ui_font_size, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, actions, Location::Bottom);
+  }
+
+  void Game::show_dialogue_node(const std::shared_ptr<const Dialogue_Graph> &t_graph, const size_t t_node, Object &t_obj)
+  {
+    const auto &node = t_graph->nodes()[t_node];
+
+    // shows a placeholder rather than stalling the frame if the prefetched portrait isn't there yet
+    Async_Texture_Handle texture;
+    if (!t_obj.get_portrait().empty()) {
+      texture = m_resources->texture_async(t_obj.get_portrait());
+    }
+
+    const auto font = get_font_handle(ui_font_path);
+    for (auto line = node.first_line; line < node.end_line; ++line)
+    {
+      m_game_events.add<Message_Box>(0, t_graph->message_text(line, font, ui_font_size, sf::Color(255, 255, 255, 255)),
+          sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, Location::Bottom, texture);
+    }
+
+    if (node.action != Dialogue_Graph::none)
+    {
+      auto graph = t_graph;
+      add_queued_action(object_action(t_obj, [graph, t_node](const Game_State &t_game, Object &t_o) {
+            graph->run_action(graph->nodes()[t_node], t_game, t_o);
+          }));
+    }
+  }
+
+  std::function<void(const Game_State &)> Game::object_action(const Object &t_obj, std::function<void(const Game_State &, Object &)> t_action) const
+  {
+    const auto map_name = has_current_map() ? m_map->first : std::string();
+    const auto obj_name = t_obj.name();
+
+    return [map_name, obj_name, t_action](const Game_State &t_game) {
+        auto &maps = t_game.game().m_maps;
+        const auto map = maps.find(map_name);
+        if (map != maps.end())
+        {
+          auto &objects = map->second.objects();
+          const auto obj = std::find_if(objects.begin(), objects.end(), [&obj_name](const Object &t_o) { return t_o.name() == obj_name; });
+          if (obj != objects.end())
+          {
+            t_action(t_game, *obj);
+            return;
+          }
+        }
+
+        SPICED_LOG(General, Warning, "Dropped an action on " << obj_name << ", it is no longer on map " << map_name);
+      };
+  }
+
+  void Game::show_shop(const Simulation_State &t_state, const std::string &t_shop)
+  {
+    open_shop(t_state, m_content.shop(t_shop));
+  }
+
+  void Game::open_shop(const Simulation_State &t_state, const std::shared_ptr<const Shop> &t_shop)
+  {
+    if (!t_shop->refuse_if.empty() && m_content.condition(t_shop->refuse_if)(Game_State(t_state, *this))) {
+      show_message_box(t_shop->refusal);
+    } else {
+      show_shop_menu(t_state, t_shop, 0);
+    }
+  }
+
+  void Game::show_shop_menu(const Simulation_State &t_state, const std::shared_ptr<const Shop> &t_shop, const size_t t_selection)
+  {
+    const auto &goods = t_shop->goods;
+    const auto &upgrades = t_shop->upgrades;
+
+    std::vector<Game_Action> actions;
+    actions.reserve(goods.size() * 2 + upgrades.size() + 1);
+
+    // every action reopens the menu on itself, so the player can keep trading
+    for (size_t i = 0; i < goods.size(); ++i)
+    {
+      actions.emplace_back("Sell " + goods[i].label + " $" + std::to_string(goods[i].price) + " (have: " + std::to_string(get_value(goods[i].item)) + ")",
+        [t_shop, i](const Game_State &t_game) {
+          auto &game = t_game.game();
+          const auto &good = t_shop->goods[i];
+          const auto count = game.get_value(good.item);
+          if (count > 0) {
+            game.set_value(good.item, count - 1);
+            game.set_value("money", game.get_value("money") + good.price);
+          } else {
+            game.show_message_box("You don't have any " + good.item + " to sell.");
+          }
+          game.show_shop_menu(t_game.state(), t_shop, i);
+        });
+    }
+
+    for (size_t i = 0; i < goods.size(); ++i)
+    {
+      const auto selection = goods.size() + i;
+      actions.emplace_back("Buy " + goods[i].label + " $" + std::to_string(goods[i].price) + " (have: " + std::to_string(get_value(goods[i].item)) + ")",
+        [t_shop, i, selection](const Game_State &t_game) {
+          auto &game = t_game.game();
+          const auto &good = t_shop->goods[i];
+          if (cargo(game, *t_shop) >= t_shop->cargo_limit) {
+            game.show_message_box("Your truck is full.");
+          } else if (purchase(game, good.price)) {
+            game.set_value(good.item, game.get_value(good.item) + 1);
+          }
+          game.show_shop_menu(t_game.state(), t_shop, selection);
+        });
+    }
+
+    for (size_t i = 0; i < upgrades.size(); ++i)
+    {
+      const auto selection = goods.size() * 2 + i;
+      actions.emplace_back("Buy " + upgrades[i].label + " ($" + std::to_string(upgrades[i].price) + ")",
+        [t_shop, i, selection](const Game_State &t_game) {
+          auto &game = t_game.game();
+          const auto &upgrade = t_shop->upgrades[i];
+          if (game.get_flag(upgrade.flag)) {
+            game.show_message_box("You already own " + upgrade.label + ".");
+          } else if (purchase(game, upgrade.price)) {
+            game.set_flag(upgrade.flag, true);
+          }
+          game.show_shop_menu(t_game.state(), t_shop, selection);
+        });
+    }
+
+    actions.emplace_back("Done ($" + std::to_string(get_value("money")) + " avail) / ("
+        + std::to_string(cargo(*this, *t_shop)) + "/" + std::to_string(t_shop->cargo_limit) + " cargo)",
+      [](const Game_State &) {});
+
+    show_selection_menu(t_state, actions, t_selection);
+  }
+
+  void Game::add_condition(const std::string &t_name, const std::function<bool(const Game_State &)> &t_condition)
+  {
+    m_content.add_condition(t_name, t_condition);
+  }
+
+  void Game::load_content(const std::string &t_file_path)
+  {
+    m_content.load(t_file_path);
+  }
+
+  const Conversation &Game::get_conversation(const std::string &t_name) const
+  {
+    return *m_content.conversation(t_name);
+  }
+
+  void Game::set_character(Tile_Map &t_map, const std::string &t_object, const std::string &t_character) const
+  {
+    // shared by the generator and every action it makes, opening the menu copies no text
+    const auto character = std::make_shared<const Character>(m_content.character(t_character));
+
+    t_map.set_action_generator(t_object,
+      [character](const Game_State &, Object &) {
+        std::vector<Object_Action> actions;
+
+        if (!character->look.empty()) {
+          actions.emplace_back("Look", [character](const Game_State &t_game, Object &) {
+              t_game.game().show_message_box(character->look);
+            });
+        }
+
+        if (character->conversation) {
+          actions.emplace_back("Talk To", [character](const Game_State &t_game, Object &t_obj) {
+              t_game.game().show_conversation(t_game.state(), t_obj, *character->conversation);
+            });
+        }
+
+        if (character->shop) {
+          actions.emplace_back("Shop", [character](const Game_State &t_game, Object &) {
+              t_game.game().open_shop(t_game.state(), character->shop);
+            });
+        }
+
+        return actions;
+      });
   }
 
   void Game::show_object_interaction_menu(const Simulation_State &t_state, Object &t_obj)
   {
-    m_game_events.emplace_back(new Object_Interaction_Menu(t_obj, get_font("resources/FreeMonoBold.ttf"), 17, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, t_obj.get_actions(Game_State(t_state, *this)), Location::Right));
+    m_game_events.add<Object_Interaction_Menu>(0, *this, t_obj, get_font_handle(ui_font_path), ui_font_size, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, t_obj.get_actions(Game_State(t_state, *this)), Location::Right);
   }
 
   void Game::show_selection_menu(const Simulation_State &, const std::vector<Game_Action> &t_selections, const size_t t_selection)
   {
-    m_game_events.emplace_back(new Selection_Menu(get_font("resources/FreeMonoBold.ttf"), 17, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, t_selections, t_selection, Location::Right));
+    m_game_events.add<Selection_Menu>(0, get_font_handle(ui_font_path), ui_font_size, sf::Color(255, 255, 255, 255), sf::Color(0, 200, 200, 255), sf::Color(0, 0, 0, 128), sf::Color(255, 255, 255, 200), 3, t_selections, t_selection, Location::Right);
   }
 
   bool Game::has_pending_events() const
   {
-    return !m_game_events.empty();
+    return m_game_events.has_blocking_events();
   }
 
   Game_Event &Game::get_current_event() const
   {
-    if (m_game_events.empty())
-    {
-      throw std::runtime_error("No pending event!");
-    }
-
-    return *m_game_events.front();
+    return m_game_events.current();
   }
 
   void Game::update(const Simulation_State &t_state)
   {
-    float simulation_time = t_state.simulation_time;
+    static Allocation_Zone update_zone("update");
+    static Allocation_Zone map_zone("map");
+    static Allocation_Zone events_zone("events");
 
-    if (has_pending_events())
-    {
-      if (m_game_events.front()->is_done())
-      {
-        m_game_events.pop_front();
-      }
-      else {
-        simulation_time = 0; // pause simulation during game event
-      }
-    }
+    Allocation_Scope update_scope(update_zone);
+
+    m_frame_arena->reset();
+    m_resources->update();
+
+    // pause simulation during game event
+    const float simulation_time = has_pending_events() ? 0 : t_state.simulation_time;
 
     const Game_State game_state(Simulation_State(t_state.game_time, simulation_time), *this);
 
     if (m_map != m_maps.end())
     {
+      Allocation_Scope map_scope(map_zone);
+
       auto &map = m_map->second;
       auto distance = Game::get_input_direction_vector() * 45.0f * simulation_time;
 
-      for (auto &collision : map.get_collisions(m_avatar, distance))
+      // only handle one collision
+      if (const auto collision = map.first_collision(m_avatar, distance))
       {
-        collision.get().do_collision(game_state, m_avatar);
-        break; // only handle one collision
+        collision->do_collision(game_state, m_avatar);
       }
 
       distance = map.adjust_move(m_avatar, distance);
       map.do_move(game_state, m_avatar, distance);
-      map.update(game_state);
       m_avatar.move(distance);
+      m_movement->update(map, m_avatar.getGlobalBounds(), simulation_time);
+      map.update(game_state);
+
+      const auto bounds = m_avatar.getGlobalBounds();
+      map.stream_around(jobs(), sf::Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2));
+    }
+
+    {
+      Allocation_Scope events_scope(events_zone);
+      m_game_events.update(game_state);
+    }
+
+    if (!show_memory_overlay()) {
+      m_memory_overlay.reset();
+    } else if (!m_memory_overlay || t_state.game_time - m_memory_overlay_time >= memory_overlay_interval) {
+      m_memory_overlay_time = t_state.game_time;
+
+      auto text = std::make_shared<Text_Geometry>(get_font_handle(ui_font_path), ui_font_size);
+      text->add_line(memory_report(), sf::Vector2f(0, 0), sf::Color(255, 255, 255, 255));
+      m_memory_overlay = std::make_shared<Text_Panel>(Location::Left, sf::Color(0, 0, 0, 160), sf::Color(255, 255, 255, 200), 1,
+          std::move(text), nullptr);
     }
 
-    if (!m_game_events.empty())
+    if (m_autosave_interval > 0 && t_state.game_time - m_last_autosave >= m_autosave_interval)
     {
-      m_game_events.front()->update(game_state);
+      m_last_autosave = t_state.game_time;
+      save_game(m_autosave_path);
+    }
+  }
+
+  bool Game::streamed_chunks_ready() const
+  {
+    // the window replaces the map's objects, which menus and dialogue opened on one of them are about
+    return m_map != m_maps.end() && m_map->second.window_ready() && !has_pending_events();
+  }
+
+  void Game::attach_streamed_chunks()
+  {
+    if (streamed_chunks_ready()) {
+      m_map->second.attach_window(*this, m_avatar);
     }
   }
 
@@ -243,6 +513,70 @@ namespace spiced {
     }
   }
 
+  void Game::set_bake_layers(const bool t_bake)
+  {
+    m_bake_layers = t_bake;
+  }
+
+  bool Game::bake_layers() const
+  {
+    return m_bake_layers;
+  }
+
+  bool Game::show_memory_overlay() const {
+    return sf::Keyboard::isKeyPressed(sf::Keyboard::F3);
+  }
+
+  std::string Game::memory_report() const
+  {
+    std::string report;
+
+    const auto stats = m_resources->stats();
+    report += "resources: " + kib(stats.total_bytes()) + " of " + kib(stats.budget)
+      + ", " + std::to_string(stats.textures) + " textures, " + std::to_string(stats.fonts) + " fonts\n";
+
+    // the largest few, the full list is available from Resource_Manager::usage()
+    const auto usage = m_resources->usage();
+    for (size_t i = 0; i < usage.size() && i < 5; ++i)
+    {
+      report += "  " + kib(usage[i].bytes) + "  " + usage[i].path
+        + (usage[i].pinned ? " (pinned)\n" : " (" + std::to_string(usage[i].handles) + " handles)\n");
+    }
+
+    report += "movement buffers: " + kib(m_movement->memory_bytes()) + '\n';
+    report += "frame arena: " + kib(m_frame_arena->used()) + " used, " + kib(m_frame_arena->high_water_mark()) + " peak, "
+      + kib(m_frame_arena->capacity()) + " block, " + std::to_string(m_frame_arena->overflows()) + " overflows\n";
+
+    for (const auto &map : m_maps)
+    {
+      const auto memory = map.second.memory_usage();
+      const bool current = m_map != m_maps.end() && &m_map->second == &map.second;
+
+      report += "map " + map.first + ": " + kib(memory.total()) + (current ? " (current)\n" : "\n");
+      report += "  layers " + kib(memory.layer_bytes())
+        + ", tilesets " + kib(memory.tileset_bytes)
+        + ", properties " + kib(memory.property_bytes)
+        + ", passability " + kib(memory.passability_bytes) + '\n';
+      report += "  objects " + kib(memory.object_bytes)
+        + ", object tilesets " + kib(memory.object_tileset_bytes) + '\n';
+      if (map.second.is_streamed()) {
+        report += "  chunks " + kib(memory.chunk_bytes) + '\n';
+      }
+
+      if (current)
+      {
+        for (size_t layer = 0; layer < memory.layers.size(); ++layer)
+        {
+          const auto &layer_memory = memory.layers[layer];
+          report += "  layer " + std::to_string(layer) + ": vertices " + kib(layer_memory.vertex_bytes)
+            + ", tiles " + kib(layer_memory.tile_bytes) + ", cells " + kib(layer_memory.cell_bytes) + '\n';
+        }
+      }
+    }
+
+    return report;
+  }
+
   bool Game::show_invisible() const {
     if (sf::Keyboard::isKeyPressed(sf::Keyboard::V)) {
       return true;
@@ -263,6 +597,33 @@ namespace spiced {
     target.draw(m_avatar, states);
   }
 
+  void Game::capture(Render_Snapshot &t_snapshot) const
+  {
+    if (m_map != m_maps.end())
+    {
+      t_snapshot.map_name = m_map->first;
+      t_snapshot.map = &m_map->second;
+      t_snapshot.map_revision = m_map->second.revision();
+      t_snapshot.map_dimensions = m_map->second.dimensions_in_pixels();
+      m_map->second.capture_objects(t_snapshot.objects);
+    }
+    else {
+      t_snapshot.map_name.clear();
+      t_snapshot.map = nullptr;
+      t_snapshot.map_revision = 0;
+      t_snapshot.objects.clear();
+    }
+
+    t_snapshot.avatar = m_avatar;
+    t_snapshot.view_center = get_avatar_position();
+    t_snapshot.zoom = m_zoom;
+    t_snapshot.rotate = m_rotate;
+    t_snapshot.show_mini_map = show_mini_map();
+    t_snapshot.bake_layers = m_bake_layers;
+    t_snapshot.event = has_pending_events() ? get_current_event().snapshot() : nullptr;
+    t_snapshot.overlay = m_memory_overlay;
+  }
+
 
   sf::Vector2f Game::get_avatar_position() const
   {
@@ -271,14 +632,174 @@ namespace spiced {
 
   void Game::enter_map(const std::string &t_name)
   {
+    if (m_map != m_maps.end() && m_map->first != t_name)
+    {
+      auto &learned = m_learned_exits[m_map->first];
+      if (std::find(learned.begin(), learned.end(), t_name) == learned.end()) {
+        learned.push_back(t_name);
+      }
+    }
+
     m_map = m_maps.find(t_name);
 
     if (m_map != m_maps.end())
     {
       m_map->second.enter(*this);
+      prefetch_neighbours();
     }
   }
 
+  std::vector<std::string> Game::neighbour_maps(const std::string &t_name) const
+  {
+    std::vector<std::string> neighbours;
+
+    const auto map = m_maps.find(t_name);
+    if (map != m_maps.end()) {
+      neighbours = map->second.exits();
+    }
+
+    const auto learned = m_learned_exits.find(t_name);
+    if (learned != m_learned_exits.end())
+    {
+      for (const auto &name : learned->second)
+      {
+        if (std::find(neighbours.begin(), neighbours.end(), name) == neighbours.end()) {
+          neighbours.push_back(name);
+        }
+      }
+    }
+
+    return neighbours;
+  }
+
+  void Game::prefetch_neighbours()
+  {
+    // maps are resident once added, their tilesets are held by the maps themselves,
+    // but portraits are only loaded when a conversation shows them
+    for (const auto &portrait : m_map->second.portraits())
+    {
+      m_resources->prefetch(portrait);
+    }
+
+    // queued after the current map's, the background jobs run in about the order they were queued
+    for (const auto &name : neighbour_maps(m_map->first))
+    {
+      const auto neighbour = m_maps.find(name);
+      if (neighbour == m_maps.end()) {
+        continue;
+      }
+
+      for (const auto &portrait : neighbour->second.portraits())
+      {
+        m_resources->prefetch(portrait);
+      }
+    }
+  }
+
+  void Game::restore_state(const Game &t_previous)
+  {
+    restore_state(t_previous.save_state());
+
+    m_autosave_path = t_previous.m_autosave_path;
+    m_autosave_interval = t_previous.m_autosave_interval;
+    m_last_autosave = t_previous.m_last_autosave;
+  }
+
+  Save_State Game::save_state() const
+  {
+    Save_State state;
+    state.flags = m_flags;
+    state.values = m_values;
+
+    if (has_current_map()) {
+      state.current_map = m_map->first;
+    }
+
+    // in the world, a streamed map's window may be elsewhere by the time it is restored
+    state.avatar_position = m_avatar.getPosition();
+    if (has_current_map()) {
+      state.avatar_position += m_map->second.world_offset();
+    }
+    state.zoom = m_zoom;
+    state.rotate = m_rotate;
+
+    for (const auto &map : m_maps)
+    {
+      map.second.save_objects(state.objects[map.first]);
+    }
+
+    return state;
+  }
+
+  void Game::restore_state(const Save_State &t_state)
+  {
+    m_flags = t_state.flags;
+    m_values = t_state.values;
+    m_zoom = t_state.zoom;
+    m_rotate = t_state.rotate;
+
+    // the map's enter actions already ran when the game was saved
+    m_map = m_maps.find(t_state.current_map);
+    m_avatar.setPosition(m_map != m_maps.end() ? t_state.avatar_position - m_map->second.world_offset() : t_state.avatar_position);
+
+    for (const auto &objects : t_state.objects)
+    {
+      const auto map = m_maps.find(objects.first);
+      if (map != m_maps.end())
+      {
+        map->second.restore_objects(objects.second);
+      }
+    }
+
+    if (m_map != m_maps.end()) {
+      prefetch_neighbours();
+    }
+  }
+
+  void Game::save_game(const std::string &t_path)
+  {
+    m_saver->write(t_path, save_state());
+  }
+
+  void Game::load_game(const std::string &t_path)
+  {
+    m_saver->flush();
+    restore_state(read_save_file(t_path));
+  }
+
+  void Game::set_autosave(const std::string &t_path, const float t_interval)
+  {
+    m_autosave_path = t_path;
+    m_autosave_interval = t_interval;
+  }
+
+  bool Game::reload_map_file(const std::string &t_file_path)
+  {
+    const auto path = Resource_Manager::normalize(t_file_path);
+    bool reloaded = false;
+
+    for (auto &map : m_maps)
+    {
+      if (Resource_Manager::normalize(map.second.file_path()) == path)
+      {
+        map.second.reload(*this);
+        reloaded = true;
+      }
+    }
+
+    return reloaded;
+  }
+
+  std::vector<std::string> Game::map_files() const
+  {
+    std::vector<std::string> files;
+    for (const auto &map : m_maps)
+    {
+      files.push_back(map.second.file_path());
+    }
+    return files;
+  }
+
   bool Game::has_current_map() const
   {
     return m_map != m_maps.end();
@@ -297,6 +818,9 @@ namespace spiced {
 
   void Game::start()
   {
+    // fill the ui font's glyph atlas up front so that the first message box does not stutter
+    prewarm_glyphs(get_font(ui_font_path), ui_font_size);
+
     for (auto &action : m_start_actions)
     {
       action(*this);
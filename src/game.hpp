@@ -1,19 +1,29 @@
 #ifndef GAME_ENGINE_GAME_HPP
 #define GAME_ENGINE_GAME_HPP
 
+#include "content_library.hpp"
+#include "event_scheduler.hpp"
+#include "frame_arena.hpp"
+#include "movement.hpp"
+#include "resource_manager.hpp"
+#include "save_game.hpp"
+
 #include <SFML/Graphics.hpp>
 #include <functional>
 #include <deque>
 #include <memory>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace spiced {
   class Tile_Map;
   class Object;
   class Game_Event;
+  struct Render_Snapshot;
   struct Game_Action;
   struct Conversation;
+  class Dialogue_Graph;
 
 
 
@@ -58,13 +68,32 @@ namespace spiced {
   {
   public:
     Game();
+
+    /// Shares t_resources with other games, used to rebuild a game without reloading its assets
+    explicit Game(std::shared_ptr<Resource_Manager> t_resources);
+
     Game(const Game &) = delete;
     Game(Game &&) = default;
 
 
+    /// The returned reference stays valid for the lifetime of the game, the texture is never evicted
     const sf::Texture &get_texture(const std::string &t_filename) const;
     const sf::Font &get_font(const std::string &t_filename) const;
 
+    Texture_Handle get_texture_handle(const std::string &t_filename) const;
+    Font_Handle get_font_handle(const std::string &t_filename) const;
+
+    /// Starts loading a texture in the background so that a later get_texture* does not block
+    void prefetch_texture(const std::string &t_filename);
+
+    Resource_Manager &resources() const;
+
+    /// The engine's worker threads, shared with the Resource_Manager
+    Job_System &jobs() const;
+
+    /// Scratch memory for the current update, everything allocated from it is released when the next update starts
+    Frame_Arena &frame_arena() const;
+
     void teleport_to(const float x, const float y);
     void teleport_to_tile(const int x, const int y);
 
@@ -76,30 +105,81 @@ namespace spiced {
 
     void add_queued_action(const std::function<void(const Game_State &)> &t_action);
 
-    void show_message_box(const sf::String &t_msg, const sf::Texture *t_texture = nullptr);
+    /// Queues a blocking action ahead of every pending event with a lower priority
+    void add_priority_action(const std::function<void(const Game_State &)> &t_action, const int t_priority);
+
+    /// Runs t_action on the next update without pausing the simulation
+    void add_concurrent_action(const std::function<void(const Game_State &)> &t_action);
+
+    /// Runs t_action once t_delay seconds of game time have passed, without pausing the simulation
+    void add_timed_action(const float t_delay, const std::function<void(const Game_State &)> &t_action);
+
+    void show_message_box(const sf::String &t_msg, Texture_Handle t_texture = Texture_Handle());
 
     void show_selection_menu(const Simulation_State &t_state, const std::vector<Game_Action> &t_selections, const size_t t_selection = 0);
     void show_object_interaction_menu(const Simulation_State &t_state, Object &t_obj);
     void show_conversation(const Simulation_State &t_state, Object &t_obj, const Conversation &t_conversation);
 
+    /// Binds t_action to t_obj of the current map by name, the object is looked up again when the action runs.
+    /// Events stay open across map reloads and streamed windows, which replace the objects they were opened on.
+    std::function<void(const Game_State &)> object_action(const Object &t_obj, std::function<void(const Game_State &, Object &)> t_action) const;
+
+    /// Opens the menu of a shop from the loaded content, unless its refusal condition holds
+    void show_shop(const Simulation_State &t_state, const std::string &t_shop);
+
+    /// Registers a script condition that content files can refer to by name
+    void add_condition(const std::string &t_name, const std::function<bool(const Game_State &)> &t_condition);
+
+    /// Loads conversations, shops and characters, see Content_Library for the format
+    void load_content(const std::string &t_file_path);
+
+    const Conversation &get_conversation(const std::string &t_name) const;
+
+    /// Gives object t_object of t_map the look, talk and shop actions of a loaded character
+    void set_character(Tile_Map &t_map, const std::string &t_object, const std::string &t_character) const;
+
     bool has_pending_events() const;
 
     Game_Event &get_current_event() const;
 
     void update(const Simulation_State &t_state);
 
+    /// True once the current map, if it is streamed, loaded the chunks around the avatar.
+    /// Stays false while blocking events are open, the chunks are swapped in after them.
+    bool streamed_chunks_ready() const;
+
+    /// Swaps the loaded chunks into the current map, see Tile_Map::attach_window.
+    /// The renderer must not be drawing meanwhile.
+    void attach_streamed_chunks();
+
     static sf::Vector2f get_input_direction_vector();
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 
+    /// Copies the current frame's visible state into t_snapshot for the render thread
+    void capture(Render_Snapshot &t_snapshot) const;
+
     sf::Vector2f get_avatar_position() const;
 
+    /// Runs the map's enter actions, then starts loading what the map and the maps reachable from it will need
     void enter_map(const std::string &t_name);
 
+    /// Maps reachable from t_name: the exits it declares, and every map entered from it so far
+    std::vector<std::string> neighbour_maps(const std::string &t_name) const;
+
     bool has_current_map() const;
 
     const Tile_Map &get_current_map() const;
 
+    /// Takes over the saved state and the autosave settings of t_previous.
+    /// Used after the game scripts were reloaded, t_previous being the game built by the old scripts.
+    void restore_state(const Game &t_previous);
+
+    /// Reloads every map that was loaded from t_file_path, returns false if there is none
+    bool reload_map_file(const std::string &t_file_path);
+
+    std::vector<std::string> map_files() const;
+
     void start();
 
     void set_flag(const std::string &t_name, bool t_value);
@@ -114,26 +194,77 @@ namespace spiced {
     float rotate();
     float zoom();
 
+    /// Copies the state that save files persist
+    Save_State save_state() const;
+    void restore_state(const Save_State &t_state);
+
+    /// Captures the state now and writes it in the background
+    void save_game(const std::string &t_path);
+
+    /// Waits for pending saves, then restores the state stored in t_path
+    void load_game(const std::string &t_path);
+
+    /// Saves to t_path every t_interval seconds of game time, an interval <= 0 disables autosave
+    void set_autosave(const std::string &t_path, const float t_interval);
+
     bool show_mini_map() const;
     bool show_invisible() const;
 
+    /// Memory used per map, layer of the current map, resource and subsystem, in text form
+    std::string memory_report() const;
+
+    /// The memory report is shown as an overlay while this is true
+    bool show_memory_overlay() const;
+
+    /// Static tile layers are drawn from baked textures unless disabled, on by default
+    void set_bake_layers(const bool t_bake);
+    bool bake_layers() const;
+
   private:
+    static const char *ui_font_path;
+    static const int ui_font_size;
+    static const float memory_overlay_interval;
+
+    /// Queues background loads of the portraits on the current map, then of those on its neighbours
+    void prefetch_neighbours();
+
+    /// Shows the answers of one conversation node, then queues its action
+    void show_dialogue_node(const std::shared_ptr<const Dialogue_Graph> &t_graph, const size_t t_node, Object &t_obj);
 
-    mutable std::map<std::string, sf::Texture> m_textures;
-    mutable std::map<std::string, sf::Font> m_fonts;
+    void open_shop(const Simulation_State &t_state, const std::shared_ptr<const Shop> &t_shop);
+    void show_shop_menu(const Simulation_State &t_state, const std::shared_ptr<const Shop> &t_shop, const size_t t_selection);
 
-    std::deque<std::unique_ptr<Game_Event>> m_game_events;
+    std::shared_ptr<Resource_Manager> m_resources;
+
+    Event_Scheduler m_game_events;
     std::map<std::string, Tile_Map> m_maps;
 
     sf::Sprite m_avatar;
     std::map<std::string, Tile_Map>::iterator m_map;
+
+    /// Map transitions seen while playing, by the name of the map left
+    std::map<std::string, std::vector<std::string>> m_learned_exits;
     std::vector<std::function<void(Game &)>> m_start_actions;
 
+    Content_Library m_content;
+
     std::map<std::string, bool> m_flags;
     std::map<std::string, int> m_values;
 
     float m_rotate;
     float m_zoom;
+
+    std::unique_ptr<Frame_Arena> m_frame_arena;
+    std::unique_ptr<Movement_System> m_movement;
+    std::unique_ptr<Save_Writer> m_saver;
+    std::string m_autosave_path;
+    float m_autosave_interval = 0;
+    float m_last_autosave = 0;
+    bool m_bake_layers = true;
+
+    /// Rebuilt every memory_overlay_interval seconds while shown
+    std::shared_ptr<const sf::Drawable> m_memory_overlay;
+    float m_memory_overlay_time = 0;
   };
 
 
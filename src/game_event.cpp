@@ -2,6 +2,7 @@
 #include "game_event.hpp"
 #include "game.hpp"
 #include "map.hpp"
+#include "dialogue_graph.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
@@ -12,8 +13,35 @@
 #include <memory>
 #include <cassert>
 #include <cmath>
+#include <limits>
 
 namespace spiced {
+  namespace {
+    std::shared_ptr<const sf::Sprite> portrait_sprite(const Texture_Handle &t_texture)
+    {
+      if (!t_texture) return nullptr;
+
+      // the sprite shares ownership of its texture for as long as anyone draws it
+      struct Portrait
+      {
+        Texture_Handle texture;
+        sf::Sprite sprite;
+      };
+
+      auto p = std::make_shared<Portrait>();
+      p->texture = t_texture;
+      p->sprite.setTexture(*t_texture, true);
+      /// \todo un-hardcode this
+      p->sprite.setScale(2,2);
+      return std::shared_ptr<const sf::Sprite>(p, &p->sprite);
+    }
+  }
+
+  Conversation::Conversation(const std::vector<Question> &t_questions)
+    : graph(std::make_shared<Dialogue_Graph>(t_questions))
+  {
+  }
+
   Queued_Action::Queued_Action(std::function<void(const Game_State &)> t_action)
     : m_action(std::move(t_action))
   { }
@@ -29,22 +57,150 @@ namespace spiced {
     return m_done;
   }
 
+  std::shared_ptr<const sf::Drawable> Queued_Action::snapshot() const
+  {
+    return nullptr;
+  }
+
+
+  Delayed_Action::Delayed_Action(const float t_delay, std::function<void(const Game_State &)> t_action)
+    : m_delay(t_delay), m_action(std::move(t_action))
+  { }
+
+  void Delayed_Action::update(const Game_State &t_game)
+  {
+    if (m_start_time < 0) m_start_time = t_game.state().game_time;
+
+    if (!m_done && t_game.state().game_time - m_start_time >= m_delay)
+    {
+      m_done = true;
+      m_action(t_game);
+    }
+  }
+
+  bool Delayed_Action::is_done() const
+  {
+    return m_done;
+  }
 
+  std::shared_ptr<const sf::Drawable> Delayed_Action::snapshot() const
+  {
+    return nullptr;
+  }
 
-  Message_Box::Message_Box(sf::String t_string, sf::Font t_font, int t_font_size,
+
+
+  Text_Panel::Text_Panel(Location t_location, sf::Color t_fill_color, sf::Color t_outline_color, float t_outline_thickness,
+      std::shared_ptr<const Text_Geometry> t_text, std::shared_ptr<const sf::Sprite> t_portrait)
+    : m_location(std::move(t_location)),
+      m_fill_color(std::move(t_fill_color)), m_outline_color(std::move(t_outline_color)),
+      m_outline_thickness(t_outline_thickness),
+      m_text(std::move(t_text)),
+      m_portrait(std::move(t_portrait)),
+      m_highlight_line(std::numeric_limits<size_t>::max())
+  {
+  }
+
+  std::shared_ptr<const Text_Panel> Text_Panel::highlight(const size_t t_line, const sf::Color &t_color) const
+  {
+    auto panel = std::make_shared<Text_Panel>(m_location, m_fill_color, m_outline_color, m_outline_thickness, m_text, m_portrait);
+
+    if (m_text && t_line < m_text->lines.size())
+    {
+      const auto &line = m_text->lines[t_line];
+      panel->m_highlight_line = t_line;
+      panel->m_highlight.assign(m_text->vertices.begin() + line.first, m_text->vertices.begin() + line.second);
+      for (auto &vertex : panel->m_highlight)
+      {
+        vertex.color = t_color;
+      }
+    }
+
+    return panel;
+  }
+
+  std::shared_ptr<const Text_Panel> Text_Panel::with_portrait(std::shared_ptr<const sf::Sprite> t_portrait) const
+  {
+    auto panel = std::make_shared<Text_Panel>(*this);
+    panel->m_portrait = std::move(t_portrait);
+    return panel;
+  }
+
+  void Text_Panel::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    const auto view_size = target.getView().getSize();
+    const auto size = m_location.get_size(view_size);
+    states.transform.translate(m_location.get_position(view_size));
+
+    // box and outline, the same geometry sf::RectangleShape would produce, without its allocations
+    const auto t = m_outline_thickness;
+    const auto quad = [](sf::Vertex *t_v, const float t_left, const float t_top, const float t_right, const float t_bottom, const sf::Color &t_color) {
+      t_v[0] = sf::Vertex(sf::Vector2f(t_left, t_top), t_color);
+      t_v[1] = sf::Vertex(sf::Vector2f(t_right, t_top), t_color);
+      t_v[2] = sf::Vertex(sf::Vector2f(t_right, t_bottom), t_color);
+      t_v[3] = sf::Vertex(sf::Vector2f(t_left, t_bottom), t_color);
+    };
+
+    sf::Vertex frame[20];
+    quad(frame, 0, 0, size.x, size.y, m_fill_color);
+    quad(frame + 4, -t, -t, size.x + t, 0, m_outline_color);
+    quad(frame + 8, -t, size.y, size.x + t, size.y + t, m_outline_color);
+    quad(frame + 12, -t, 0, 0, size.y, m_outline_color);
+    quad(frame + 16, size.x, 0, size.x + t, size.y, m_outline_color);
+
+    auto frame_states = states;
+    frame_states.texture = nullptr;
+    target.draw(frame, 20, sf::Quads, frame_states);
+
+    if (m_text && !m_text->vertices.empty())
+    {
+      auto text_states = states;
+      text_states.texture = m_text->texture;
+
+      const auto &vertices = m_text->vertices;
+
+      if (m_highlight_line < m_text->lines.size())
+      {
+        const auto &line = m_text->lines[m_highlight_line];
+        target.draw(&vertices[0], line.first, sf::Quads, text_states);
+        if (!m_highlight.empty()) {
+          target.draw(&m_highlight[0], m_highlight.size(), sf::Quads, text_states);
+        }
+        target.draw(&vertices[0] + line.second, vertices.size() - line.second, sf::Quads, text_states);
+      }
+      else {
+        target.draw(&vertices[0], vertices.size(), sf::Quads, text_states);
+      }
+    }
+
+    if (m_portrait) {
+      target.draw(*m_portrait);
+    }
+  }
+
+
+
+  Message_Box::Message_Box(const sf::String &t_string, Font_Handle t_font, int t_font_size,
     sf::Color t_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness, Location t_loc,
-    const sf::Texture *t_texture)
+    Async_Texture_Handle t_texture)
+    : Message_Box(
+        [&]() -> std::shared_ptr<const Text_Geometry> {
+          auto text = std::make_shared<Text_Geometry>(std::move(t_font), t_font_size);
+          text->add_line(t_string, sf::Vector2f(0, 0), t_font_color);
+          return text;
+        }(),
+        std::move(t_fill_color), std::move(t_outline_color), t_outlineThickness, std::move(t_loc), std::move(t_texture))
+  {
+  }
+
+  Message_Box::Message_Box(std::shared_ptr<const Text_Geometry> t_text,
+    sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness, Location t_loc, Async_Texture_Handle t_texture)
     : Game_Event(),
-      m_string(std::move(t_string)), m_font(std::move(t_font)), m_font_color(std::move(t_font_color)),
-      m_fill_color(std::move(t_fill_color)), m_outline_color(std::move(t_outline_color)),
-      m_outline_thickness(t_outlineThickness),
-      m_text(t_string, m_font, t_font_size),
-      m_location(std::move(t_loc)),
-      m_portrait(t_texture?new sf::Sprite(*t_texture):nullptr)
+      m_portrait(std::move(t_texture)),
+      m_shown_portrait(m_portrait ? *m_portrait : nullptr)
   {
-    /// \todo un-hardcode this
-    if (m_portrait) m_portrait->setScale(2,2);
-    m_text.setColor(m_font_color);
+    m_view = std::make_shared<Text_Panel>(std::move(t_loc), std::move(t_fill_color), std::move(t_outline_color), t_outlineThickness,
+        std::move(t_text), portrait_sprite(m_shown_portrait));
   }
 
 
@@ -52,6 +208,13 @@ namespace spiced {
   {
     if (m_start_time == 0) m_start_time = t_game.state().game_time;
 
+    // the portrait finished loading, snapshots already taken keep the placeholder
+    if (m_portrait && *m_portrait != m_shown_portrait)
+    {
+      m_shown_portrait = *m_portrait;
+      m_view = m_view->with_portrait(portrait_sprite(m_shown_portrait));
+    }
+
     if (t_game.state().game_time - m_start_time >= .5 && sf::Keyboard::isKeyPressed(sf::Keyboard::Return))
     {
       m_is_done = true;
@@ -63,55 +226,46 @@ namespace spiced {
     return m_is_done;
   }
 
-  void Message_Box::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  std::shared_ptr<const sf::Drawable> Message_Box::snapshot() const
   {
-    const auto size = m_location.get_size(target.getView().getSize());
-
-    auto transform = getTransform();
-    transform.translate(m_location.get_position(target.getView().getSize()));
-    // apply the transform
-    states.transform *= transform;
-
-    sf::RectangleShape rect(size);
-    rect.setFillColor(m_fill_color);
-    rect.setOutlineColor(m_outline_color);
-    rect.setOutlineThickness(m_outline_thickness);
+    return m_view;
+  }
 
-    target.draw(rect, states);
-    target.draw(m_text, states);
-    if (m_portrait) {
-      target.draw(*m_portrait);
-    }
+  void Message_Box::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    states.transform *= getTransform();
+    target.draw(*m_view, states);
   }
 
 
 
-  Selection_Menu::Selection_Menu(sf::Font t_font, int t_font_size,
+  Selection_Menu::Selection_Menu(Font_Handle t_font, int t_font_size,
     sf::Color t_font_color, sf::Color t_selected_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness,
     std::vector<Game_Action> t_actions, const size_t t_selection, Location t_location)
     : Game_Event(),
-    m_font(std::move(t_font)), m_font_color(std::move(t_font_color)),
+    m_font_color(std::move(t_font_color)),
     m_selected_color(std::move(t_selected_font_color)),
     m_selected_cur_color(m_selected_color),
-    m_fill_color(std::move(t_fill_color)), m_outline_color(std::move(t_outline_color)),
-    m_outline_thickness(t_outlineThickness), m_actions(std::move(t_actions)),
-    m_current_item(t_selection),
-    m_location(std::move(t_location))
+    m_actions(std::move(t_actions)),
+    m_current_item(t_selection)
   {
+    auto text = std::make_shared<Text_Geometry>(std::move(t_font), t_font_size);
+
     auto pos = 0.0f;
     for (const auto &action : m_actions)
     {
-      m_texts.push_back([t_font_size, t_font_color, &action, &pos, this]()
-          {
-            sf::Text txt(action.description, m_font, t_font_size);
-            txt.setColor(t_font_color);
-            txt.setPosition(15, pos);
-            pos += t_font_size*1.1f;
-            return txt;
-          }()
-        );
+      text->add_line(action.description, sf::Vector2f(15, pos), m_font_color);
+      pos += t_font_size*1.1f;
     }
 
+    m_panel = std::make_shared<Text_Panel>(std::move(t_location), std::move(t_fill_color), std::move(t_outline_color), t_outlineThickness,
+        std::move(text), nullptr);
+    update_view();
+  }
+
+  void Selection_Menu::update_view()
+  {
+    m_view = m_panel->highlight(m_current_item, m_selected_cur_color);
   }
 
   void Selection_Menu::update(const Game_State &t_game)
@@ -124,6 +278,9 @@ namespace spiced {
       m_is_done = true;
     }
 
+    const auto last_item = m_current_item;
+    const auto last_color = m_selected_cur_color;
+
     if (std::remainder(t_game.state().game_time, .5f) > 0)
     {
       m_selected_cur_color = m_selected_color;
@@ -164,6 +321,12 @@ namespace spiced {
 
     m_current_item = new_item;
     m_last_direction = direction;
+
+    // only rebuild the highlighted line when something visible changed
+    if (m_current_item != last_item || m_selected_cur_color != last_color)
+    {
+      update_view();
+    }
   }
 
   bool Selection_Menu::is_done() const
@@ -171,51 +334,27 @@ namespace spiced {
     return m_is_done;
   }
 
-  void Selection_Menu::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  std::shared_ptr<const sf::Drawable> Selection_Menu::snapshot() const
   {
-    const auto size = m_location.get_size(target.getView().getSize());
-    auto transform = getTransform();
-    transform.translate(m_location.get_position(target.getView().getSize()));
-
-    // apply the transform
-    states.transform *= transform;
-
-    sf::RectangleShape rect(size);
-    rect.setFillColor(m_fill_color);
-    rect.setOutlineColor(m_outline_color);
-    rect.setOutlineThickness(m_outline_thickness);
-
-    target.draw(rect, states);
-
-
-    auto item = 0u;
-    for (auto txt : m_texts)
-    {
-      if (m_current_item == item)
-      {
-        txt.setColor(m_selected_cur_color);
-      }
-      else {
-        txt.setColor(m_font_color);
-      }
-      target.draw(txt, states);
-      ++item;
-    }
+    return m_view;
+  }
 
+  void Selection_Menu::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    states.transform *= getTransform();
+    target.draw(*m_view, states);
   }
 
 
-  Object_Interaction_Menu::Object_Interaction_Menu(Object &t_obj, sf::Font t_font, int t_font_size,
+  Object_Interaction_Menu::Object_Interaction_Menu(const Game &t_game, const Object &t_obj, Font_Handle t_font, int t_font_size,
     sf::Color t_font_color, sf::Color t_selected_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness,
     const std::vector<Object_Action> &t_actions, Location t_location)
     : Selection_Menu(std::move(t_font), t_font_size, std::move(t_font_color), std::move(t_selected_font_color), std::move(t_fill_color), std::move(t_outline_color),
       t_outlineThickness,
-      [](const std::vector<Object_Action> &t_act, Object &t_o) {
+      [&t_game](const std::vector<Object_Action> &t_act, const Object &t_o) {
         std::vector<Game_Action> res;
         for (auto &act : t_act) {
-          auto func = act.action;
-          using namespace std::placeholders;
-          res.emplace_back(act.description, std::bind(act.action, _1, std::ref(t_o)));
+          res.emplace_back(act.description, t_game.object_action(t_o, act.action));
         }
 
         return res;
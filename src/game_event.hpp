@@ -1,6 +1,8 @@
 #ifndef GAME_ENGINE_GAME_EVENT_HPP
 #define GAME_ENGINE_GAME_EVENT_HPP
 
+#include "text_geometry.hpp"
+
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <functional>
@@ -14,6 +16,7 @@ namespace spiced
   struct Object_Action;
   struct Game_Action;
   class Game_State;
+  class Dialogue_Graph;
 
   struct Answer
   {
@@ -42,11 +45,18 @@ namespace spiced
 
     Question(std::string t_question,
       std::vector<Answer> t_answers,
-      std::function<bool(const Game_State &)> t_is_available = [](const Game_State &){return true;},
+      std::function<bool(const Game_State &)> t_is_available = {},
       std::function<void(const Game_State &)> t_action = {})
       : question(std::move(t_question)),
         answers(std::move(t_answers)),
-        is_available([t_is_available](const Game_State &t_game, Object &){ return t_is_available(t_game); }),
+        is_available(
+            [t_is_available]() -> std::function<bool(const Game_State &, Object &)> {
+              if (t_is_available) {
+                return [t_is_available](const Game_State &t_game, Object &){ return t_is_available(t_game); };
+              } else {
+                return std::function<bool(const Game_State &, Object &)>();
+              }
+            }()),
         action(
             [t_action]() -> std::function<void(const Game_State &, Object &)> {
               if (t_action) {
@@ -68,14 +78,12 @@ namespace spiced
 
   };
 
+  /// Compiles its questions into a Dialogue_Graph once. Copies share the graph.
   struct Conversation
   {
-    Conversation(std::vector<Question> t_questions)
-      : questions(std::move(t_questions))
-    {
-    }
+    Conversation(const std::vector<Question> &t_questions);
 
-    std::vector<Question> questions;
+    std::shared_ptr<const Dialogue_Graph> graph;
   };
 
 
@@ -88,6 +96,10 @@ namespace spiced
 
     virtual void update(const Game_State &t_game) = 0;
 
+    /// Returns an immutable copy of this event's visual state for the render thread,
+    /// or nullptr if the event has nothing to draw
+    virtual std::shared_ptr<const sf::Drawable> snapshot() const = 0;
+
   };
 
   class Queued_Action : public Game_Event
@@ -99,11 +111,36 @@ namespace spiced
 
     virtual bool is_done() const;
 
+    virtual std::shared_ptr<const sf::Drawable> snapshot() const;
+
+    virtual void draw(sf::RenderTarget& /*target*/, sf::RenderStates /*states*/) const
+    { /*nothing to do*/
+    }
+
+  private:
+    bool m_done = false;
+    std::function<void(const Game_State &)> m_action;
+  };
+
+  /// Runs an action once t_delay seconds of game time have passed since the event first updated
+  class Delayed_Action : public Game_Event
+  {
+  public:
+    Delayed_Action(const float t_delay, std::function<void(const Game_State &)> t_action);
+
+    virtual void update(const Game_State &);
+
+    virtual bool is_done() const;
+
+    virtual std::shared_ptr<const sf::Drawable> snapshot() const;
+
     virtual void draw(sf::RenderTarget& /*target*/, sf::RenderStates /*states*/) const
     { /*nothing to do*/
     }
 
   private:
+    float m_delay;
+    float m_start_time = -1;
     bool m_done = false;
     std::function<void(const Game_State &)> m_action;
   };
@@ -152,11 +189,47 @@ namespace spiced
   };
 
 
+  /// Immutable visual of a text event: a framed box with prebuilt text, optionally with one
+  /// line drawn in a highlight color. Shared between the event and the render snapshots.
+  class Text_Panel : public sf::Drawable
+  {
+  public:
+    Text_Panel(Location t_location, sf::Color t_fill_color, sf::Color t_outline_color, float t_outline_thickness,
+      std::shared_ptr<const Text_Geometry> t_text, std::shared_ptr<const sf::Sprite> t_portrait);
+
+    /// Returns a copy of this panel which draws line t_line of the text in t_color
+    std::shared_ptr<const Text_Panel> highlight(const size_t t_line, const sf::Color &t_color) const;
+
+    /// Returns a copy of this panel which shows t_portrait instead
+    std::shared_ptr<const Text_Panel> with_portrait(std::shared_ptr<const sf::Sprite> t_portrait) const;
+
+  protected:
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+  private:
+    Location m_location;
+    sf::Color m_fill_color;
+    sf::Color m_outline_color;
+    float m_outline_thickness;
+    std::shared_ptr<const Text_Geometry> m_text;
+    std::shared_ptr<const sf::Sprite> m_portrait;
+
+    size_t m_highlight_line;
+    std::vector<sf::Vertex> m_highlight;
+  };
+
+
+  /// A text box, optionally with a portrait that may still be loading: it shows the
+  /// placeholder at first and switches to the texture on the update after it arrived
   class Message_Box : public Game_Event
   {
   public:
-    Message_Box(sf::String t_string, sf::Font t_font, int t_font_size,
-      sf::Color t_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness, Location t_location, const sf::Texture *t_texture);
+    Message_Box(const sf::String &t_string, Font_Handle t_font, int t_font_size,
+      sf::Color t_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness, Location t_location, Async_Texture_Handle t_texture);
+
+    /// Shows text that was laid out beforehand, such as a Dialogue_Graph line
+    Message_Box(std::shared_ptr<const Text_Geometry> t_text,
+      sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness, Location t_location, Async_Texture_Handle t_texture);
 
     virtual ~Message_Box() = default;
 
@@ -164,19 +237,16 @@ namespace spiced
 
     virtual bool is_done() const;
 
+    virtual std::shared_ptr<const sf::Drawable> snapshot() const;
+
   protected:
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
 
   private:
-    sf::String m_string;
-    sf::Font m_font;
-    sf::Color m_font_color;
-    sf::Color m_fill_color;
-    sf::Color m_outline_color;
-    float m_outline_thickness;
-    sf::Text m_text;
-    Location m_location;
-    std::unique_ptr<sf::Sprite> m_portrait;
+    std::shared_ptr<const Text_Panel> m_view;
+
+    Async_Texture_Handle m_portrait;
+    Texture_Handle m_shown_portrait;
 
     float m_start_time = 0;
     bool m_is_done = false;
@@ -185,7 +255,7 @@ namespace spiced
   class Selection_Menu : public Game_Event
   {
   public:
-    Selection_Menu(sf::Font t_font, int t_font_size,
+    Selection_Menu(Font_Handle t_font, int t_font_size,
       sf::Color t_font_color, sf::Color t_selected_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness,
       std::vector<Game_Action> t_actions,
       const size_t t_selection, Location t_location);
@@ -196,22 +266,24 @@ namespace spiced
 
     virtual bool is_done() const override;
 
+    virtual std::shared_ptr<const sf::Drawable> snapshot() const override;
+
   protected:
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 
   private:
-    sf::Font m_font;
+    void update_view();
+
     sf::Color m_font_color;
     sf::Color m_selected_color;
     sf::Color m_selected_cur_color;
-    sf::Color m_fill_color;
-    sf::Color m_outline_color;
-    float m_outline_thickness;
 
     std::vector<Game_Action> m_actions;
-    std::vector<sf::Text> m_texts;
     size_t m_current_item = 0;
-    Location m_location;
+
+    // text is laid out once, only the highlighted line changes
+    std::shared_ptr<const Text_Panel> m_panel;
+    std::shared_ptr<const Text_Panel> m_view;
 
     int m_last_direction = 0;
     float m_start_time = 0;
@@ -223,7 +295,8 @@ namespace spiced
   class Object_Interaction_Menu : public Selection_Menu
   {
   public:
-    Object_Interaction_Menu(Object &t_obj, sf::Font t_font, int t_font_size,
+    /// The actions find t_obj through Game::object_action each time one is picked
+    Object_Interaction_Menu(const Game &t_game, const Object &t_obj, Font_Handle t_font, int t_font_size,
       sf::Color t_font_color, sf::Color t_selected_font_color, sf::Color t_fill_color, sf::Color t_outline_color, float t_outlineThickness,
       const std::vector<Object_Action> &t_actions, Location t_location);
   };
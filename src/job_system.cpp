@@ -0,0 +1,363 @@
+#include "job_system.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+
+namespace spiced {
+  namespace {
+    // set on worker threads only
+    thread_local const Job_System *current_system = nullptr;
+    thread_local size_t current_queue = 0;
+  }
+
+  struct Job_Counter::State
+  {
+    std::atomic<size_t> pending;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::exception_ptr error;
+
+    /// Tasks waiting for pending to reach zero, Job_System::Task is private so they are kept type erased
+    std::vector<std::function<void ()>> continuations;
+
+    State()
+      : pending(0)
+    {
+    }
+  };
+
+  Job_Counter::Job_Counter()
+    : m_state(std::make_shared<State>())
+  {
+  }
+
+  bool Job_Counter::done() const
+  {
+    return m_state->pending.load() == 0;
+  }
+
+
+  Job_System::Job_System(const unsigned int t_workers)
+    : m_queued(0)
+  {
+    // queue 0 is shared by every thread outside of the pool
+    for (unsigned int i = 0; i <= t_workers; ++i)
+    {
+      m_queues.emplace_back(new Queue());
+    }
+
+    for (unsigned int i = 0; i < t_workers; ++i)
+    {
+      m_workers.emplace_back(&Job_System::run_worker, this, size_t(i) + 1);
+    }
+  }
+
+  Job_System::~Job_System()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_sleep_mutex);
+      m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+      worker.join();
+    }
+
+    // without workers, the queued jobs still have to run
+    Task task;
+    while (take(0, task))
+    {
+      execute(task);
+    }
+  }
+
+  unsigned int Job_System::default_workers()
+  {
+    const auto threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 1;
+  }
+
+  unsigned int Job_System::worker_count() const
+  {
+    return static_cast<unsigned int>(m_workers.size());
+  }
+
+  size_t Job_System::own_queue() const
+  {
+    return current_system == this ? current_queue : 0;
+  }
+
+  void Job_System::run(Job t_job)
+  {
+    push(Task{std::move(t_job), nullptr});
+  }
+
+  void Job_System::run(Job t_job, const Job_Counter &t_counter)
+  {
+    ++t_counter.m_state->pending;
+    push(Task{std::move(t_job), t_counter.m_state});
+  }
+
+  void Job_System::run_after(const Job_Counter &t_dependency, Job t_job, const Job_Counter &t_counter)
+  {
+    ++t_counter.m_state->pending;
+
+    auto task = std::make_shared<Task>(Task{std::move(t_job), t_counter.m_state});
+
+    {
+      auto &dependency = *t_dependency.m_state;
+      std::lock_guard<std::mutex> lock(dependency.mutex);
+      if (dependency.pending.load() != 0)
+      {
+        dependency.continuations.push_back([this, task]() { push(std::move(*task)); });
+        return;
+      }
+    }
+
+    push(std::move(*task));
+  }
+
+  void Job_System::push(Task t_task)
+  {
+    // counted before it is visible, so that takers never see the count drop below zero
+    ++m_queued;
+
+    auto &queue = *m_queues[own_queue()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(t_task));
+    }
+
+    {
+      // pairs with the predicate check of sleeping workers, so the wake up can't be lost
+      std::lock_guard<std::mutex> lock(m_sleep_mutex);
+    }
+    m_wake.notify_one();
+  }
+
+  bool Job_System::take(const size_t t_queue, Task &t_task)
+  {
+    if (m_queued.load() == 0) {
+      return false;
+    }
+
+    // newest first from our own deque, it is most likely still in cache
+    {
+      auto &queue = *m_queues[t_queue];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty())
+      {
+        t_task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --m_queued;
+        return true;
+      }
+    }
+
+    // oldest first from everybody else's, those tend to be the biggest pieces of work
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+      auto &queue = *m_queues[(t_queue + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty())
+      {
+        t_task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --m_queued;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool Job_System::take_counted(const size_t t_queue, const Job_Counter::State &t_counter, Task &t_task)
+  {
+    if (m_queued.load() == 0) {
+      return false;
+    }
+
+    const auto counted = [&t_counter](const Task &t_queued) { return t_queued.counter.get() == &t_counter; };
+
+    // same order as take(): newest first from our own deque, oldest first from the others
+    {
+      auto &queue = *m_queues[t_queue];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      const auto task = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), counted);
+      if (task != queue.tasks.rend())
+      {
+        t_task = std::move(*task);
+        queue.tasks.erase(std::next(task).base());
+        --m_queued;
+        return true;
+      }
+    }
+
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+      auto &queue = *m_queues[(t_queue + i) % m_queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      const auto task = std::find_if(queue.tasks.begin(), queue.tasks.end(), counted);
+      if (task != queue.tasks.end())
+      {
+        t_task = std::move(*task);
+        queue.tasks.erase(task);
+        --m_queued;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Job_System::execute(Task &t_task)
+  {
+    std::exception_ptr error;
+    try {
+      t_task.job();
+    } catch (const std::exception &e) {
+      if (!t_task.counter) {
+        SPICED_LOG(Jobs, Error, "Background job failed: " << e.what());
+      }
+      error = std::current_exception();
+    } catch (...) {
+      if (!t_task.counter) {
+        SPICED_LOG(Jobs, Error, "Background job failed");
+      }
+      error = std::current_exception();
+    }
+
+    // release whatever the job captured before anybody waiting on it wakes up
+    t_task.job = nullptr;
+
+    if (!t_task.counter) {
+      return;
+    }
+
+    auto counter = std::move(t_task.counter);
+    std::vector<std::function<void ()>> continuations;
+    {
+      std::lock_guard<std::mutex> lock(counter->mutex);
+      if (error && !counter->error) {
+        counter->error = error;
+      }
+
+      if (--counter->pending == 0)
+      {
+        continuations.swap(counter->continuations);
+        counter->condition.notify_all();
+      }
+    }
+
+    for (auto &continuation : continuations)
+    {
+      continuation();
+    }
+  }
+
+  void Job_System::wait(const Job_Counter &t_counter)
+  {
+    auto &state = *t_counter.m_state;
+    const auto queue = own_queue();
+
+    while (state.pending.load() != 0)
+    {
+      // unrelated jobs, like texture decodes or saves, stay with the workers instead of stalling the waiter
+      Task task;
+      if (take_counted(queue, state, task))
+      {
+        execute(task);
+      }
+      else {
+        // the last jobs are running elsewhere, wake up now and then in case one of them queues more work
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.condition.wait_for(lock, std::chrono::milliseconds(1), [&state]() { return state.pending.load() == 0; });
+      }
+    }
+
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      std::swap(error, state.error);
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void Job_System::parallel_for(const size_t t_count, const size_t t_grain, const std::function<void (size_t, size_t)> &t_body)
+  {
+    const auto grain = std::max<size_t>(1, t_grain);
+
+    if (t_count <= grain || m_workers.empty())
+    {
+      if (t_count != 0) {
+        t_body(0, t_count);
+      }
+      return;
+    }
+
+    Job_Counter counter;
+    for (size_t begin = 0; begin < t_count; begin += grain)
+    {
+      const auto end = std::min(t_count, begin + grain);
+      run([&t_body, begin, end]() { t_body(begin, end); }, counter);
+    }
+
+    wait(counter);
+  }
+
+  void Job_System::run_on_main(Job t_job)
+  {
+    std::lock_guard<std::mutex> lock(m_main_mutex);
+    m_main_jobs.push_back(std::move(t_job));
+  }
+
+  void Job_System::run_main_jobs()
+  {
+    std::vector<Job> jobs;
+    {
+      std::lock_guard<std::mutex> lock(m_main_mutex);
+      jobs.swap(m_main_jobs);
+    }
+
+    for (auto &job : jobs)
+    {
+      try {
+        job();
+      } catch (const std::exception &e) {
+        SPICED_LOG(Jobs, Error, "Main thread job failed: " << e.what());
+      }
+    }
+  }
+
+  void Job_System::run_worker(const size_t t_queue)
+  {
+    current_system = this;
+    current_queue = t_queue;
+
+    for (;;)
+    {
+      Task task;
+      if (take(t_queue, task))
+      {
+        execute(task);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_sleep_mutex);
+      m_wake.wait(lock, [this]() { return m_queued.load() != 0 || m_stopping; });
+
+      if (m_stopping && m_queued.load() == 0) {
+        return;
+      }
+    }
+  }
+}
+
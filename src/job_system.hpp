@@ -0,0 +1,125 @@
+#ifndef GAME_ENGINE_JOB_SYSTEM_HPP
+#define GAME_ENGINE_JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spiced
+{
+  class Job_System;
+
+  /// Counts the jobs run with it that have not finished yet. Copies share the same count.
+  class Job_Counter
+  {
+  public:
+    Job_Counter();
+
+    bool done() const;
+
+  private:
+    friend class Job_System;
+    struct State;
+
+    std::shared_ptr<State> m_state;
+  };
+
+  /// The engine's worker threads. Every subsystem schedules its background and parallel work
+  /// here instead of starting threads of its own.
+  ///
+  /// Each worker has its own deque: jobs queued by a worker go to the back of its deque and it
+  /// takes them from there, newest first, while idle workers steal from the front of other
+  /// deques, oldest first. Jobs queued by threads outside of the pool share one extra deque.
+  /// A thread waiting for a Job_Counter runs the queued jobs counted by it meanwhile, and only
+  /// those, so waiting never picks up unrelated long work. Waiting inside a job can't deadlock the
+  /// pool unless the awaited jobs were queued with run_after and depend on jobs nobody is free to run.
+  ///
+  /// Jobs must not touch SFML graphics or call into ChaiScript, which is built without thread
+  /// support. Work like that is handed back with run_on_main().
+  class Job_System
+  {
+  public:
+    typedef std::function<void ()> Job;
+
+    explicit Job_System(const unsigned int t_workers = default_workers());
+    Job_System(const Job_System &) = delete;
+    Job_System &operator=(const Job_System &) = delete;
+
+    /// Finishes every queued job, then joins the workers
+    ~Job_System();
+
+    /// One worker per hardware thread, minus the main thread
+    static unsigned int default_workers();
+
+    unsigned int worker_count() const;
+
+    /// Queues t_job. An exception thrown by it is logged as an error.
+    void run(Job t_job);
+
+    /// Queues t_job, counted by t_counter until it finished. An exception thrown by it is rethrown by wait().
+    void run(Job t_job, const Job_Counter &t_counter);
+
+    /// Queues t_job once every job counted by t_dependency has finished, counted by t_counter right away
+    void run_after(const Job_Counter &t_dependency, Job t_job, const Job_Counter &t_counter);
+
+    /// Runs the queued jobs counted by t_counter on the calling thread until it is done, then rethrows
+    /// the first exception thrown by one of the jobs it counted
+    void wait(const Job_Counter &t_counter);
+
+    /// Calls t_body(begin, end) for consecutive ranges of at most t_grain indices covering
+    /// [0, t_count), spread over the workers and the calling thread. Returns once all are done.
+    void parallel_for(const size_t t_count, const size_t t_grain, const std::function<void (size_t, size_t)> &t_body);
+
+    /// Queues t_job for the thread that calls run_main_jobs(), for work that has to happen there (GL, scripts)
+    void run_on_main(Job t_job);
+
+    /// Runs the jobs queued with run_on_main, called once per frame by the main thread
+    void run_main_jobs();
+
+  private:
+    struct Task
+    {
+      Job job;
+      std::shared_ptr<Job_Counter::State> counter;
+    };
+
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    /// Index of the calling thread's deque, the shared one for threads outside of the pool
+    size_t own_queue() const;
+
+    void push(Task t_task);
+    bool take(const size_t t_queue, Task &t_task);
+
+    /// Like take(), but only a task counted by t_counter
+    bool take_counted(const size_t t_queue, const Job_Counter::State &t_counter, Task &t_task);
+    void execute(Task &t_task);
+    void run_worker(const size_t t_queue);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<size_t> m_queued;
+
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+
+    std::mutex m_main_mutex;
+    std::vector<Job> m_main_jobs;
+
+    std::vector<std::thread> m_workers;
+  };
+}
+
+#endif
+
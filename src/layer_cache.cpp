@@ -0,0 +1,158 @@
+#include "layer_cache.hpp"
+#include "map.hpp"
+#include "render_snapshot.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace spiced {
+  const unsigned int Layer_Cache::chunk_size;
+  const size_t Layer_Cache::max_chunks;
+
+  void Layer_Cache::invalidate()
+  {
+    m_map = nullptr;
+    m_runs.clear();
+    m_chunks.clear();
+  }
+
+  void Layer_Cache::reset(const Tile_Map &t_map, const uint64_t t_revision)
+  {
+    invalidate();
+
+    for (size_t layer = 0; layer < t_map.layer_count(); ++layer)
+    {
+      const auto is_static = !t_map.layer_is_animated(layer);
+      if (m_runs.empty() || m_runs.back().is_static != is_static) {
+        m_runs.push_back(Run{layer, layer + 1, is_static});
+      } else {
+        m_runs.back().end_layer = layer + 1;
+      }
+    }
+
+    m_chunk_size = std::min(chunk_size, sf::Texture::getMaximumSize());
+    m_map = &t_map;
+    m_revision = t_revision;
+  }
+
+  sf::FloatRect Layer_Cache::visible_area(const sf::RenderTarget &t_target, const sf::RenderStates &t_states) const
+  {
+    // the view may be rotated, so bound all four corners of the viewport, in map coordinates
+    const auto viewport = t_target.getViewport(t_target.getView());
+    const sf::Vector2i corners[] = {
+      sf::Vector2i(viewport.left, viewport.top),
+      sf::Vector2i(viewport.left + viewport.width, viewport.top),
+      sf::Vector2i(viewport.left, viewport.top + viewport.height),
+      sf::Vector2i(viewport.left + viewport.width, viewport.top + viewport.height)
+    };
+
+    const auto to_map = t_states.transform.getInverse();
+    auto min = to_map.transformPoint(t_target.mapPixelToCoords(corners[0]));
+    auto max = min;
+    for (const auto &corner : corners)
+    {
+      const auto point = to_map.transformPoint(t_target.mapPixelToCoords(corner));
+      min = sf::Vector2f(std::min(min.x, point.x), std::min(min.y, point.y));
+      max = sf::Vector2f(std::max(max.x, point.x), std::max(max.y, point.y));
+    }
+
+    return sf::FloatRect(min, max - min);
+  }
+
+  Layer_Cache::Chunk &Layer_Cache::chunk(const size_t t_run, const sf::Vector2u &t_chunk)
+  {
+    auto &chunk = m_chunks[std::make_tuple(t_run, t_chunk.y, t_chunk.x)];
+    if (chunk.texture) {
+      return chunk;
+    }
+
+    std::unique_ptr<sf::RenderTexture> texture(new sf::RenderTexture());
+    if (!texture->create(m_chunk_size, m_chunk_size))
+    {
+      m_chunks.erase(std::make_tuple(t_run, t_chunk.y, t_chunk.x));
+      throw std::runtime_error("Unable to create layer cache texture");
+    }
+
+    const auto size = float(m_chunk_size);
+    const auto origin = sf::Vector2f(t_chunk.x * size, t_chunk.y * size);
+
+    texture->setView(sf::View(sf::FloatRect(origin, sf::Vector2f(size, size))));
+    texture->clear(sf::Color::Transparent);
+    m_map->draw_layers(*texture, sf::RenderStates(), m_runs[t_run].first_layer, m_runs[t_run].end_layer);
+    texture->display();
+
+    chunk.texture = std::move(texture);
+    chunk.sprite = sf::Sprite(chunk.texture->getTexture());
+    chunk.sprite.setPosition(origin);
+    return chunk;
+  }
+
+  void Layer_Cache::evict()
+  {
+    while (m_chunks.size() > max_chunks)
+    {
+      auto oldest = m_chunks.begin();
+      for (auto itr = m_chunks.begin(); itr != m_chunks.end(); ++itr)
+      {
+        if (itr->second.last_drawn < oldest->second.last_drawn) {
+          oldest = itr;
+        }
+      }
+
+      // everything left is on screen
+      if (oldest->second.last_drawn == m_frame) {
+        return;
+      }
+
+      m_chunks.erase(oldest);
+    }
+  }
+
+  void Layer_Cache::draw(sf::RenderTarget &t_target, const sf::RenderStates &t_states, const Render_Snapshot &t_snapshot)
+  {
+    const auto &map = *t_snapshot.map;
+
+    if (m_map != &map || m_revision != t_snapshot.map_revision) {
+      reset(map, t_snapshot.map_revision);
+    }
+
+    ++m_frame;
+
+    const auto area = visible_area(t_target, t_states);
+    const auto size = float(m_chunk_size);
+    const auto chunks_x = int(std::ceil(t_snapshot.map_dimensions.x / size));
+    const auto chunks_y = int(std::ceil(t_snapshot.map_dimensions.y / size));
+    const auto first_x = std::max(0, int(std::floor(area.left / size)));
+    const auto first_y = std::max(0, int(std::floor(area.top / size)));
+    const auto end_x = std::min(chunks_x, int(std::ceil((area.left + area.width) / size)));
+    const auto end_y = std::min(chunks_y, int(std::ceil((area.top + area.height) / size)));
+
+    // baked layers are already blended, their colors carry the alpha
+    auto chunk_states = t_states;
+    chunk_states.blendMode = sf::BlendMode(sf::BlendMode::One, sf::BlendMode::OneMinusSrcAlpha);
+
+    for (size_t run = 0; run < m_runs.size(); ++run)
+    {
+      if (!m_runs[run].is_static)
+      {
+        map.draw_layers(t_target, t_states, m_runs[run].first_layer, m_runs[run].end_layer);
+        continue;
+      }
+
+      for (int y = first_y; y < end_y; ++y)
+      {
+        for (int x = first_x; x < end_x; ++x)
+        {
+          auto &baked = chunk(run, sf::Vector2u(unsigned(x), unsigned(y)));
+          baked.last_drawn = m_frame;
+          t_target.draw(baked.sprite, chunk_states);
+        }
+      }
+    }
+
+    evict();
+  }
+}
+
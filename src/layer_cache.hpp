@@ -0,0 +1,72 @@
+#ifndef GAME_ENGINE_LAYER_CACHE_HPP
+#define GAME_ENGINE_LAYER_CACHE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace spiced
+{
+  class Tile_Map;
+  struct Render_Snapshot;
+
+  /// Draws the tile layers of the current map with the static ones baked into render textures.
+  ///
+  /// Consecutive static layers form a run, which is composited into square chunks the first time
+  /// a chunk comes into view. Afterwards a run costs one textured quad per visible chunk, no matter
+  /// how many layers and tiles it holds. Layers with animated tiles are drawn from their vertices
+  /// every frame, in between the runs, so the layer order is kept. Reloading the map drops all chunks.
+  ///
+  /// Owned by the render thread, which is the only thread allowed to touch its GL resources.
+  class Layer_Cache
+  {
+  public:
+    /// Edge length of a chunk in pixels
+    static const unsigned int chunk_size = 512;
+
+    /// Chunks not drawn for the longest time are released beyond this many, bounding video memory
+    static const size_t max_chunks = 64;
+
+    /// Draws the layers of t_snapshot's map, t_states must already hold the map's transform
+    void draw(sf::RenderTarget &t_target, const sf::RenderStates &t_states, const Render_Snapshot &t_snapshot);
+
+    /// Drops all chunks, needed when the maps were replaced and a new map may reuse an old address
+    void invalidate();
+
+  private:
+    struct Run
+    {
+      size_t first_layer;
+      size_t end_layer;
+      bool is_static;
+    };
+
+    struct Chunk
+    {
+      std::unique_ptr<sf::RenderTexture> texture;
+      sf::Sprite sprite;
+      uint64_t last_drawn = 0;
+    };
+
+    void reset(const Tile_Map &t_map, const uint64_t t_revision);
+    sf::FloatRect visible_area(const sf::RenderTarget &t_target, const sf::RenderStates &t_states) const;
+    Chunk &chunk(const size_t t_run, const sf::Vector2u &t_chunk);
+    void evict();
+
+    const Tile_Map *m_map = nullptr;
+    uint64_t m_revision = 0;
+    unsigned int m_chunk_size = chunk_size;
+    uint64_t m_frame = 0;
+
+    std::vector<Run> m_runs;
+
+    /// keyed by run, chunk row and chunk column
+    std::map<std::tuple<size_t, unsigned int, unsigned int>, Chunk> m_chunks;
+  };
+}
+
+#endif
+
@@ -0,0 +1,317 @@
+#include "log.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+namespace spiced {
+  const size_t Log::category_count;
+  const size_t Log::capacity;
+
+  std::atomic<int> Log::s_levels[Log::category_count] = {
+    {int(Log_Level::Info)}, {int(Log_Level::Info)}, {int(Log_Level::Info)}, {int(Log_Level::Info)},
+    {int(Log_Level::Info)}, {int(Log_Level::Info)}, {int(Log_Level::Info)}
+  };
+
+  namespace {
+    const char *level_names[] = { "debug", "info", "warning", "error", "off" };
+    const char *category_names[] = { "general", "map", "resources", "jobs", "script", "save", "frame" };
+
+    struct Entry
+    {
+      Log_Category category;
+      Log_Level level;
+      float time;
+      std::string message;
+    };
+
+    /// Bounded multi producer queue after Dmitry Vyukov's design. Each cell's sequence tells
+    /// whether it is free for the producer at that position or holds an entry for the consumer.
+    class Ring
+    {
+    public:
+      Ring()
+      {
+        for (size_t i = 0; i < Log::capacity; ++i) {
+          m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+      }
+
+      bool push(Entry &&t_entry)
+      {
+        auto pos = m_enqueue.load(std::memory_order_relaxed);
+        for (;;)
+        {
+          auto &cell = m_cells[pos & (Log::capacity - 1)];
+          const auto sequence = cell.sequence.load(std::memory_order_acquire);
+          const auto diff = intptr_t(sequence) - intptr_t(pos);
+
+          if (diff == 0) {
+            if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              cell.entry = std::move(t_entry);
+              cell.sequence.store(pos + 1, std::memory_order_release);
+              return true;
+            }
+          } else if (diff < 0) {
+            // full, the consumer has not freed this cell yet
+            return false;
+          } else {
+            pos = m_enqueue.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      /// Single consumer only
+      bool pop(Entry &t_entry)
+      {
+        const auto pos = m_dequeue.load(std::memory_order_relaxed);
+        auto &cell = m_cells[pos & (Log::capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+          return false;
+        }
+
+        t_entry = std::move(cell.entry);
+        cell.sequence.store(pos + Log::capacity, std::memory_order_release);
+        m_dequeue.store(pos + 1, std::memory_order_relaxed);
+        return true;
+      }
+
+      size_t enqueued() const
+      {
+        return m_enqueue.load(std::memory_order_acquire);
+      }
+
+    private:
+      struct Cell
+      {
+        std::atomic<size_t> sequence;
+        Entry entry;
+      };
+
+      Cell m_cells[Log::capacity];
+      std::atomic<size_t> m_enqueue{0};
+      std::atomic<size_t> m_dequeue{0};
+    };
+
+    struct Rate
+    {
+      std::atomic<int64_t> second{-1};
+      std::atomic<unsigned> count{0};
+    };
+
+    Ring &ring()
+    {
+      static Ring r;
+      return r;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    Rate rates[Log::category_count];
+    std::atomic<unsigned> rate_limit(100);
+    std::atomic<uint64_t> dropped_messages(0);
+
+    std::atomic<bool> writer_running(false);
+
+    /// Log::write calls that may still push to the queue, the writer waits them out before its last drain
+    std::atomic<unsigned> active_producers(0);
+
+    /// Entries written by the writer thread, compared against the queue position by flush()
+    std::atomic<size_t> written(0);
+
+    std::mutex direct_mutex;
+
+    void output(const Entry &t_entry)
+    {
+      char prefix[64];
+      std::snprintf(prefix, sizeof(prefix), "[%.3f] %s %s: ", double(t_entry.time),
+          level_names[size_t(t_entry.level)], category_names[size_t(t_entry.category)]);
+
+      auto &stream = t_entry.level >= Log_Level::Warning ? std::cerr : std::cout;
+      stream << prefix << t_entry.message << '\n';
+    }
+
+    bool rate_limited(const Log_Category t_category, const Log_Level t_level)
+    {
+      const auto limit = rate_limit.load(std::memory_order_relaxed);
+      if (limit == 0 || t_level == Log_Level::Error) {
+        return false;
+      }
+
+      const auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start_time).count();
+      auto &rate = rates[size_t(t_category)];
+
+      // the first message of a new second restarts the count, racing writers at the boundary just skew it
+      auto second = rate.second.load(std::memory_order_relaxed);
+      if (second != now && rate.second.compare_exchange_strong(second, now, std::memory_order_relaxed)) {
+        rate.count.store(0, std::memory_order_relaxed);
+      }
+
+      return rate.count.fetch_add(1, std::memory_order_relaxed) >= limit;
+    }
+
+    template<size_t N>
+    size_t find_name(const char *(&t_names)[N], const std::string &t_name, const char *t_kind)
+    {
+      for (size_t i = 0; i < N; ++i) {
+        if (t_name == t_names[i]) {
+          return i;
+        }
+      }
+      throw std::runtime_error("Unknown log " + std::string(t_kind) + ": '" + t_name + "'");
+    }
+  }
+
+  void Log::write(const Log_Category t_category, const Log_Level t_level, std::string t_message)
+  {
+    if (rate_limited(t_category, t_level)) {
+      dropped_messages.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    Entry entry{t_category, t_level,
+      std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::steady_clock::now() - start_time).count(),
+      std::move(t_message)};
+
+    // sequentially consistent with the writer's shutdown: either this sees it stopped, or it sees this producer
+    active_producers.fetch_add(1);
+    if (!writer_running.load()) {
+      active_producers.fetch_sub(1);
+      std::lock_guard<std::mutex> lock(direct_mutex);
+      output(entry);
+    } else {
+      if (!ring().push(std::move(entry))) {
+        dropped_messages.fetch_add(1, std::memory_order_relaxed);
+      }
+      active_producers.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void Log::set_level(const Log_Level t_level)
+  {
+    for (auto &level : s_levels) {
+      level.store(int(t_level), std::memory_order_relaxed);
+    }
+  }
+
+  void Log::set_level(const Log_Category t_category, const Log_Level t_level)
+  {
+    s_levels[size_t(t_category)].store(int(t_level), std::memory_order_relaxed);
+  }
+
+  void Log::configure(const std::string &t_spec)
+  {
+    size_t begin = 0;
+    while (begin <= t_spec.size())
+    {
+      auto end = t_spec.find(',', begin);
+      if (end == std::string::npos) {
+        end = t_spec.size();
+      }
+
+      const auto item = t_spec.substr(begin, end - begin);
+      const auto equals = item.find('=');
+
+      if (equals == std::string::npos) {
+        if (!item.empty()) {
+          set_level(Log_Level(find_name(level_names, item, "level")));
+        }
+      } else {
+        set_level(Log_Category(find_name(category_names, item.substr(0, equals), "category")),
+            Log_Level(find_name(level_names, item.substr(equals + 1), "level")));
+      }
+
+      begin = end + 1;
+    }
+  }
+
+  void Log::set_rate_limit(const unsigned t_per_second)
+  {
+    rate_limit.store(t_per_second, std::memory_order_relaxed);
+  }
+
+  uint64_t Log::dropped()
+  {
+    return dropped_messages.load(std::memory_order_relaxed);
+  }
+
+
+  Log_Writer::Log_Writer()
+    : m_stop(false)
+  {
+    // the queue only has one consumer
+    if (writer_running.exchange(true)) {
+      throw std::logic_error("Only one Log_Writer may exist at a time");
+    }
+
+    written.store(ring().enqueued(), std::memory_order_relaxed);
+    m_thread = std::thread(&Log_Writer::run, this);
+  }
+
+  Log_Writer::~Log_Writer()
+  {
+    m_stop = true;
+    m_thread.join();
+    writer_running.store(false);
+
+    // producers that saw the writer running may still be pushing
+    while (active_producers.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+
+    // messages pushed while the thread was finishing
+    Entry entry;
+    while (ring().pop(entry)) {
+      output(entry);
+    }
+    std::cout.flush();
+  }
+
+  void Log_Writer::flush()
+  {
+    const auto target = ring().enqueued();
+    while (written.load(std::memory_order_acquire) < target) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  void Log_Writer::run()
+  {
+    uint64_t reported_drops = 0;
+    Entry entry;
+
+    for (;;)
+    {
+      // read before draining, so nothing queued before the stop request is left behind
+      const bool stop = m_stop;
+
+      bool wrote = false;
+      while (ring().pop(entry))
+      {
+        output(entry);
+        written.fetch_add(1, std::memory_order_release);
+        wrote = true;
+      }
+
+      const auto drops = Log::dropped();
+      if (drops != reported_drops)
+      {
+        std::cerr << "[log] " << (drops - reported_drops) << " messages dropped\n";
+        reported_drops = drops;
+      }
+
+      if (wrote) {
+        std::cout.flush();
+      }
+
+      if (stop) {
+        return;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
@@ -0,0 +1,106 @@
+#ifndef GAME_ENGINE_LOG_HPP
+#define GAME_ENGINE_LOG_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace spiced
+{
+  enum class Log_Level
+  {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+  };
+
+  enum class Log_Category
+  {
+    General,
+    Map,
+    Resources,
+    Jobs,
+    Script,
+    Save,
+    Frame
+  };
+
+  /// Leveled logging with a level per category and a per category rate limit.
+  ///
+  /// Messages go through a fixed size lock-free queue to the thread of a Log_Writer, so logging
+  /// never waits on terminal I/O. A message that doesn't fit the queue or exceeds its category's
+  /// rate limit is dropped and counted instead of blocking. While no Log_Writer exists, messages
+  /// are written by the calling thread.
+  ///
+  /// Use SPICED_LOG, which only formats a message when its level is enabled.
+  class Log
+  {
+  public:
+    static const size_t category_count = 7;
+
+    /// Messages the queue holds, a power of two
+    static const size_t capacity = 1024;
+
+    static bool enabled(const Log_Category t_category, const Log_Level t_level)
+    {
+      return int(t_level) >= s_levels[size_t(t_category)].load(std::memory_order_relaxed);
+    }
+
+    static void write(const Log_Category t_category, const Log_Level t_level, std::string t_message);
+
+    /// Sets the level of every category
+    static void set_level(const Log_Level t_level);
+    static void set_level(const Log_Category t_category, const Log_Level t_level);
+
+    /// Applies a comma separated list of levels, a bare level sets every category:
+    /// "warning,map=debug,frame=off". Throws std::runtime_error on an unknown name.
+    static void configure(const std::string &t_spec);
+
+    /// Messages per second each category may log, 0 for no limit. Errors are never limited.
+    static void set_rate_limit(const unsigned t_per_second);
+
+    /// Messages dropped so far because the queue was full or a rate limit was hit
+    static uint64_t dropped();
+
+  private:
+    static std::atomic<int> s_levels[category_count];
+  };
+
+  /// Owns the thread that writes queued log messages, info and debug to std::cout and the rest to std::cerr.
+  /// Only one may exist at a time. Messages still queued are written before it is destroyed.
+  class Log_Writer
+  {
+  public:
+    Log_Writer();
+    Log_Writer(const Log_Writer &) = delete;
+    Log_Writer &operator=(const Log_Writer &) = delete;
+    ~Log_Writer();
+
+    /// Waits until every message logged before the call has been written
+    void flush();
+
+  private:
+    void run();
+
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+  };
+}
+
+/// Logs a message built with operator<< if level is enabled for category, otherwise costs one atomic load:
+///
+///     SPICED_LOG(Map, Debug, "Placing object: " << name);
+#define SPICED_LOG(category, level, message) \
+  do { \
+    if (::spiced::Log::enabled(::spiced::Log_Category::category, ::spiced::Log_Level::level)) { \
+      std::ostringstream spiced_log_message; \
+      spiced_log_message << message; \
+      ::spiced::Log::write(::spiced::Log_Category::category, ::spiced::Log_Level::level, spiced_log_message.str()); \
+    } \
+  } while (false)
+
+#endif
@@ -1,52 +1,121 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
-#include <iostream>
+#include <cstdlib>
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
 
+#include "allocation_counter.hpp"
+#include "file_watcher.hpp"
 #include "game.hpp"
 #include "game_event.hpp"
+#include "job_system.hpp"
+#include "log.hpp"
 #include "map.hpp"
+#include "render_snapshot.hpp"
+#include "render_thread.hpp"
 #include "chaiscript_creator.hpp"
 #include "ChaiScript/include/chaiscript/chaiscript.hpp"
 
 void show_error(const std::string &t_what)
 {
-  std::cout << "An unhandled error has occured:\n" << t_what << std::endl;
+  SPICED_LOG(General, Error, "An unhandled error has occured:\n" << t_what);
 
 #ifdef _WIN32
   MessageBox(nullptr, t_what.c_str(), nullptr, MB_ICONERROR | MB_OK);
 #endif
 }
 
-spiced::Game build_chai_game(chaiscript::ChaiScript &chai)
+static const char *game_script = "spiced.chai";
+
+std::unique_ptr<spiced::Game> build_chai_game(chaiscript::ChaiScript &chai, std::shared_ptr<spiced::Resource_Manager> resources)
 {
-  spiced::Game game;
-  chai.boxed_cast<std::function<void (spiced::Game &)>>(chai.eval_file("spiced.chai"))(game);
+  std::unique_ptr<spiced::Game> game(new spiced::Game(std::move(resources)));
+  chai.boxed_cast<std::function<void (spiced::Game &)>>(chai.eval_file(game_script))(*game);
   return game;
 }
 
+void watch_game_files(spiced::File_Watcher &watcher, const spiced::Game &game)
+{
+  watcher.watch(game_script);
+  for (const auto &file : game.map_files())
+  {
+    watcher.watch(file);
+  }
+}
+
+/// Applies changes to the game's files while it is running.
+/// A changed map file is reloaded in place. A changed script is evaluated from scratch in a new
+/// engine, since functions cannot be redefined in a live one, and the resulting game takes over
+/// the state of the running one. Loaded resources are shared between the two and kept.
+void hot_reload(const std::vector<std::string> &changed, spiced::File_Watcher &watcher, const std::shared_ptr<spiced::Resource_Manager> &resources,
+    std::unique_ptr<chaiscript::ChaiScript> &chai, std::unique_ptr<spiced::Game> &game)
+{
+  const bool script_changed = std::find(changed.begin(), changed.end(), spiced::Resource_Manager::normalize(game_script)) != changed.end();
+
+  try {
+    if (script_changed)
+    {
+      SPICED_LOG(Script, Info, "Reloading " << game_script);
+      auto new_chai = spiced::create_chaiscript();
+      auto new_game = build_chai_game(*new_chai, resources);
+      new_game->restore_state(*game);
+
+      // the old game holds functions from the old engine, so it has to go first
+      game = std::move(new_game);
+      chai = std::move(new_chai);
+      watch_game_files(watcher, *game);
+    }
+    else {
+      for (const auto &file : changed)
+      {
+        SPICED_LOG(Script, Info, "Reloading " << file);
+        game->reload_map_file(file);
+      }
+    }
+  } catch (const chaiscript::exception::eval_error &ee) {
+    SPICED_LOG(Script, Error, "Hot reload failed, keeping the running game:\n" << ee.pretty_print());
+  } catch (const std::exception &e) {
+    SPICED_LOG(Script, Error, "Hot reload failed, keeping the running game: " << e.what());
+  }
+}
+
 
 int main()
 {
+  // everything logged from here on is written by a background thread, see Log for SPICED_LOG's format
+  spiced::Log_Writer log_writer;
+
   try {
+    if (const auto spec = std::getenv("SPICED_LOG")) {
+      spiced::Log::configure(spec);
+    }
+
     // create the window
     sf::RenderWindow window(sf::VideoMode(800, 600), "Tilemap");
 
     window.setVerticalSyncEnabled(true);
     auto chaiscript = spiced::create_chaiscript();
 
-    auto game = build_chai_game(*chaiscript);
+    const auto jobs = std::make_shared<spiced::Job_System>();
+    const auto resources = std::make_shared<spiced::Resource_Manager>(jobs);
+    auto game = build_chai_game(*chaiscript, resources);
+
+    spiced::File_Watcher watcher;
+    watch_game_files(watcher, *game);
 
     auto start_time = std::chrono::steady_clock::now();
 
     auto last_frame = std::chrono::steady_clock::now();
     uint64_t frame_count = 0;
 
-    sf::View fixed = window.getView();
+    game->start();
 
-    game.start();
+    spiced::Render_Snapshot snapshot;
+    spiced::Render_Thread renderer(window);
 
     // run the main loop
     while (window.isOpen())
@@ -60,7 +129,11 @@ int main()
       {
         const auto avgfps = frame_count / game_time;
         const auto curfps = 1 / time_elapsed;
-        std::cout << curfps << "fps avg fps: " << avgfps << '\n';
+        SPICED_LOG(Frame, Info, curfps << "fps avg fps: " << avgfps);
+
+        if (spiced::Allocation_Counter::enabled()) {
+          SPICED_LOG(Frame, Info, spiced::Allocation_Counter::report());
+        }
       }
 
       last_frame = cur_frame;
@@ -69,6 +142,7 @@ int main()
       while (window.pollEvent(event))
       {
         if(event.type == sf::Event::Closed) {
+          renderer.stop();
           window.close();
         }
 
@@ -76,44 +150,38 @@ int main()
         {
           // update the view to the new size of the window
           window.setSize(sf::Vector2u(event.size.width, event.size.height));
-          fixed = sf::View(sf::FloatRect(0,0, float(event.size.width), float(event.size.height)));
         }
       }
 
-      game.update(spiced::Simulation_State(game_time, time_elapsed));
-
-      const auto window_size = window.getSize();
-      sf::View mainView(game.get_avatar_position(), sf::Vector2f(window_size));
-      mainView.zoom(game.zoom());
-      mainView.rotate(game.rotate());
-      window.setView(mainView);
-
-      window.clear();
-
-      // main frame
-      window.draw(game);
+      if (!window.isOpen()) {
+        break;
+      }
 
+      const auto changed_files = watcher.poll();
+      if (!changed_files.empty())
+      {
+        // frames already captured may point into maps that are about to be replaced
+        spiced::Render_Thread::Pause pause(renderer);
+        hot_reload(changed_files, watcher, resources, chaiscript, game);
+      }
 
-      if (game.show_mini_map() && game.has_current_map())
+      if (game->streamed_chunks_ready())
       {
-        // mini view
-        const auto dimensions = sf::Vector2f(game.get_current_map().dimensions_in_pixels());
-        sf::View miniView(sf::FloatRect(sf::Vector2f(0,0), dimensions));
-        miniView.setViewport(sf::FloatRect(0.75f, 0, 0.25f, (.25f * window_size.x) * (dimensions.y / dimensions.x) / window_size.y ));
-        window.setView(miniView);
-        window.draw(game);
+        // the map's layers are replaced and its contents moved, just like on a reload
+        spiced::Render_Thread::Pause pause(renderer);
+        game->attach_streamed_chunks();
       }
 
+      // work the job system handed back to this thread
+      jobs->run_main_jobs();
 
-      // fixed overlays
-      window.setView(fixed);
+      game->update(spiced::Simulation_State(game_time, time_elapsed));
 
-      if (game.has_pending_events())
-      {
-        window.draw(game.get_current_event());
-      }
+      // drawing happens on the render thread while we simulate the next frame
+      game->capture(snapshot);
+      renderer.publish(snapshot);
 
-      window.display();
+      spiced::Allocation_Counter::end_frame();
     }
   }
   catch (const chaiscript::exception::eval_error &ee) {
@@ -1,18 +1,112 @@
 #include "map.hpp"
+#include "collision.hpp"
+#include "frame_arena.hpp"
 #include "game.hpp"
-#include "SimpleJSON/json.hpp"
+#include "job_system.hpp"
+#include "log.hpp"
+#include "map_file.hpp"
+#include "pathfinding.hpp"
+#include "save_game.hpp"
 
 #include <SFML/Graphics.hpp>
+#include <atomic>
 #include <functional>
 #include <cassert>
 #include <cmath>
-#include <fstream>
-#include <sstream>
+#include <limits>
 #include <numeric>
 
-#include <iostream>
 
 namespace spiced {
+  namespace {
+    /// Tile ids that no tileset covers
+    const uint16_t no_tileset = std::numeric_limits<uint16_t>::max();
+
+    /// Below this many cells, summed over all layers, tile meshes are built on the loading thread only
+    const size_t min_parallel_mesh_tiles = 1 << 16;
+
+    template<typename T>
+    size_t vector_bytes(const std::vector<T> &t_vector)
+    {
+      return t_vector.capacity() * sizeof(T);
+    }
+
+    /// Strings short enough for the small string buffer don't allocate, an empty string's capacity is that buffer's size
+    size_t string_bytes(const std::string &t_string)
+    {
+      return t_string.capacity() > std::string().capacity() ? t_string.capacity() + 1 : 0;
+    }
+
+    /// Nodes of a std::map hold three links and a color next to the value
+    template<typename Key, typename Value>
+    size_t map_node_bytes(const std::map<Key, Value> &t_map)
+    {
+      return t_map.size() * (sizeof(typename std::map<Key, Value>::value_type) + 4 * sizeof(void *));
+    }
+
+    /// Division rounding towards negative infinity, chunks left of and above the origin have negative coordinates
+    int floor_div(const int t_value, const int t_divisor)
+    {
+      return t_value / t_divisor - (t_value % t_divisor != 0 && (t_value < 0) != (t_divisor < 0) ? 1 : 0);
+    }
+
+    std::pair<int, int> chunk_key(const sf::Vector2i &t_chunk)
+    {
+      return std::make_pair(t_chunk.x, t_chunk.y);
+    }
+
+    /// Chunk containing t_position, a position in the world
+    sf::Vector2i world_chunk(const sf::Vector2f &t_position, const sf::Vector2u &t_tile_size, const sf::Vector2u &t_chunk_size)
+    {
+      const auto tile_x = int(std::floor(t_position.x / float(t_tile_size.x)));
+      const auto tile_y = int(std::floor(t_position.y / float(t_tile_size.y)));
+      return sf::Vector2i(floor_div(tile_x, int(t_chunk_size.x)), floor_div(tile_y, int(t_chunk_size.y)));
+    }
+
+    bool in_window(const sf::Vector2i &t_chunk, const sf::Vector2i &t_first_chunk, const int t_span)
+    {
+      return t_chunk.x >= t_first_chunk.x && t_chunk.x < t_first_chunk.x + t_span
+        && t_chunk.y >= t_first_chunk.y && t_chunk.y < t_first_chunk.y + t_span;
+    }
+
+    /// An object of the map file, placed at its position in the world moved back by t_offset
+    Object file_object(const Map_File::Object &t_obj, const std::vector<Tileset> &t_tilesets, const sf::Vector2f &t_offset)
+    {
+      const auto gid = t_obj.gid;
+      const auto tileset = std::find_if(t_tilesets.begin(), t_tilesets.end(),
+        [gid](const Tileset &t_tileset) {
+        return gid >= t_tileset.min_gid() && gid <= t_tileset.max_gid();
+      });
+      assert(tileset != t_tilesets.end());
+
+      Object obj(t_obj.name, *tileset, gid, t_obj.visible, nullptr, nullptr);
+      obj.set_position(t_obj.x - t_offset.x, t_obj.y - t_offset.y);
+      return obj;
+    }
+  }
+
+  struct Tile_Map::Window_Build
+  {
+    explicit Window_Build(Job_System &t_jobs)
+      : jobs(t_jobs)
+    {
+    }
+
+    Job_System &jobs;
+    Job_Counter done;
+
+    sf::Vector2i first_chunk;
+    int span = 0;
+
+    std::vector<Layer> layers;
+    Layer_Build meshes;
+
+    /// Chunks that were not resident and had to be read from disk
+    std::vector<std::pair<sf::Vector2i, std::shared_ptr<const Chunk_Index::Tiles>>> read;
+  };
+
+  const int Tile_Map::default_stream_radius;
+
   Object::Object(std::string t_name, Tileset t_tileset,
     const int t_tile_id,
     const bool t_visible,
@@ -25,7 +119,7 @@ namespace spiced {
       m_collision_action(std::move(t_collision_action)),
       m_action_generator(std::move(t_action_generator))
   {
-    setTexture(m_tileset.texture.get());
+    setTexture(*m_tileset.texture);
     setTextureRect(m_tileset.get_rect(m_tile_id, 0));
   }
 
@@ -34,11 +128,21 @@ namespace spiced {
     m_portrait = t_portrait;
   }
 
-  std::string Object::get_portrait() const
+  const std::string &Object::get_portrait() const
   {
     return m_portrait;
   }
 
+  size_t Object::memory_bytes() const
+  {
+    return string_bytes(m_name) + string_bytes(m_portrait) + vector_bytes(m_motion.route);
+  }
+
+  size_t Object::tileset_memory_bytes() const
+  {
+    return m_tileset.memory_bytes();
+  }
+
   void Object::update(const Game_State &t_game)
   {
     setTextureRect(m_tileset.get_rect(m_tile_id, t_game.state().game_time));
@@ -69,6 +173,42 @@ namespace spiced {
   }
 
 
+  void Object::inherit_behavior(const Object &t_previous)
+  {
+    set_behavior(t_previous.behavior());
+  }
+
+  Object_Behavior Object::behavior() const
+  {
+    Object_Behavior behavior;
+    behavior.portrait = m_portrait;
+    behavior.collision_action = m_collision_action;
+    behavior.action_generator = m_action_generator;
+    behavior.motion = m_motion;
+    return behavior;
+  }
+
+  void Object::set_behavior(const Object_Behavior &t_behavior)
+  {
+    m_portrait = t_behavior.portrait;
+    m_collision_action = t_behavior.collision_action;
+    m_action_generator = t_behavior.action_generator;
+    // the object starts over from its position in the file, so only the movement settings carry over
+    m_motion = t_behavior.motion;
+    m_motion.route.clear();
+    m_motion.next_waypoint = 0;
+  }
+
+  Motion &Object::motion()
+  {
+    return m_motion;
+  }
+
+  const Motion &Object::motion() const
+  {
+    return m_motion;
+  }
+
   void Object::do_collision(const Game_State &t_game, sf::Sprite &t_collided_with)
   {
     if (m_collision_action)
@@ -77,12 +217,23 @@ namespace spiced {
     }
   }
 
+  namespace {
+    // starts at 1, so that 0 can mark bounds that were never gathered
+    std::atomic<uint64_t> object_placements(1);
+  }
+
   void Object::set_position(const float x, const float y)
   {
     setPosition(x, y);
+    object_placements.fetch_add(1, std::memory_order_relaxed);
   }
 
-  std::string Object::name() const
+  uint64_t Object::placement_generation()
+  {
+    return object_placements.load(std::memory_order_relaxed);
+  }
+
+  const std::string &Object::name() const
   {
     return m_name;
   }
@@ -254,11 +405,6 @@ namespace spiced {
   }
 
 
-  Tile_Data::Tile_Data(int t_x, int t_y, Tile_Properties t_props, sf::FloatRect t_bounds)
-    : x(t_x), y(t_y), properties(std::move(t_props)), bounds(std::move(t_bounds))
-  {
-  }
-
   std::map<int, Tile_Properties> Tile_Map::to_map(std::vector<Tile_Defaults> &&t_vec)
   {
     std::map<int, Tile_Properties> retmap;
@@ -270,160 +416,262 @@ namespace spiced {
   }
 
 
+  Script_Parser::Script_Parser()
+    : m_collision_actions(std::make_shared<std::map<std::string, Collision_Action>>())
+  {
+  }
+
+  Script_Parser::Collision_Action Script_Parser::collision_action(const std::string &t_source) const
+  {
+    auto itr = m_collision_actions->find(t_source);
+    if (itr == m_collision_actions->end()) {
+      itr = m_collision_actions->emplace(t_source, collision_action_parser(t_source)).first;
+    }
+    return itr->second;
+  }
+
+  size_t Script_Parser::compiled_collision_actions() const
+  {
+    return m_collision_actions->size();
+  }
+
   Tile_Map::Tile_Map(Game &t_game, const std::string &t_file_path, std::vector<Tile_Defaults> t_map_defaults, const Script_Parser &t_script_parser)
-    : m_map_defaults(to_map(std::move(t_map_defaults)))
+    : m_file_path(t_file_path),
+      m_script_defaults(to_map(std::move(t_map_defaults))),
+      m_script_parser(t_script_parser)
   {
-    std::ifstream ifs(t_file_path);
-    std::stringstream buff;
-    buff << ifs.rdbuf();
-    auto json = json::JSON::Load(buff.str());
+    load_file(t_game, false);
+  }
 
-    const auto tilesize = sf::Vector2u(json.at("tilewidth").ToInt(), json.at("tileheight").ToInt());
-    const auto map_width = json.at("width").ToInt();
-    const auto map_height = json.at("height").ToInt();
+  Tile_Map::~Tile_Map()
+  {
+    cancel_window();
+  }
 
-    const auto parent_path = [&]() {
-      const auto slash = t_file_path.rfind('/');
+  void Tile_Map::reload(Game &t_game)
+  {
+    load_file(t_game, true);
+    ++m_revision;
+  }
 
-      if (slash == std::string::npos) {
-        return std::string();
-      } else {
-        return t_file_path.substr(0, slash + 1);
-      }
-    }();
+  void Tile_Map::load_file(Game &t_game, const bool t_incremental)
+  {
+    const auto &t_file_path = m_file_path;
+    const auto &t_script_parser = m_script_parser;
+    auto map_defaults = m_script_defaults;
 
-    std::cout << "Path: " << t_file_path << " parent path: " << parent_path << '\n';
-    std::map<int, std::map<std::string, std::string>> tile_properties;
+    // a window still loading reads the tilesets that are about to be replaced
+    cancel_window();
 
-    for (const auto &tileset : json.at("tilesets").ArrayRange())
-    {
-      const auto first_gid = tileset.at("firstgid").ToInt();
+    auto file = read_map_file(t_game.jobs(), t_file_path);
 
+    const auto tilesize = file.tile_size;
+    const auto map_width = file.width;
+    const auto map_height = file.height;
 
-      if (tileset.hasKey("tileproperties")) {
-        for (const auto &tile : tileset.at("tileproperties").ObjectRange()) {
-          auto id = std::stoi(tile.first) + first_gid;
+    std::map<int, std::map<std::string, std::string>> tile_properties;
 
-          //std::map<std::string, std::string> props;
-          for (const auto &property : tile.second.ObjectRange()) {
-            const std::string &prop_name = property.first;
-            const std::string value = property.second.ToString();
-            if (prop_name == "passable" && value == "false") {
-              m_map_defaults[id].passable = false;
-            } if (prop_name == "visible" && value == "false") {
-              m_map_defaults[id].visible = false;
-            } if (prop_name == "collision_action") {
-              m_map_defaults[id].collision_action = t_script_parser.collision_action_parser(value);
-            } else {
-              std::cerr << "Unhandled tile property: " << prop_name << ": " << value << '\n';
-            }
-            //props.emplace(property.first, property.second.ToString());
+    std::vector<Tileset> tilesets;
+    for (const auto &tileset : file.tilesets)
+    {
+      const auto first_gid = tileset.first_gid;
+
+      for (const auto &tile : tileset.tile_properties) {
+        const auto id = tile.first + first_gid;
+
+        for (const auto &property : tile.second) {
+          const std::string &prop_name = property.first;
+          const std::string &value = property.second;
+          if (prop_name == "passable" && value == "false") {
+            map_defaults[id].passable = false;
+          } if (prop_name == "visible" && value == "false") {
+            map_defaults[id].visible = false;
+          } if (prop_name == "collision_action") {
+            map_defaults[id].collision_action = t_script_parser.collision_action(value);
+          } else {
+            SPICED_LOG(Map, Warning, "Unhandled tile property: " << prop_name << ": " << value);
           }
-          //tile_properties.emplace(id, std::move(props));
         }
+        tile_properties.emplace(id, tile.second);
       }
 
       std::map<int, Animation> animations;
-      if (tileset.hasKey("tiles")) {
-        for (const auto &tile : tileset.at("tiles").ObjectRange()) {
-          auto id = std::stoi(tile.first) + first_gid;
-
-          if (tile.second.hasKey("animation")) {
-            Animation anim;
-            for (const auto &frame : tile.second.at("animation").ArrayRange()) {
-              const auto duration = frame.at("duration").ToInt();
-              const auto tileid = frame.at("tileid").ToInt() + first_gid;
-              anim.emplace_back(tileid, duration);
-            }
-
-            animations.emplace(std::make_pair(id, anim));
-          }
+      for (const auto &tile : tileset.animations) {
+        Animation anim;
+        for (const auto &frame : tile.second) {
+          anim.emplace_back(frame.tile_id + first_gid, frame.duration);
         }
+        animations.emplace(tile.first + first_gid, std::move(anim));
       }
 
-      m_tilesets.emplace_back(t_game.get_texture(parent_path + tileset.at("image").ToString()),
+      tilesets.emplace_back(t_game.get_texture_handle(tileset.image),
         first_gid,
-        tileset.at("tilewidth").ToInt(), tileset.at("tileheight").ToInt(),
+        tileset.tile_width, tileset.tile_height,
         std::move(animations));
-
     }
 
     std::vector<Layer> layers;
+    std::vector<std::string> exits;
+
+    for (auto &layer : file.layers) {
+      bool visible = layer.visible;
+
+      for (const auto &property : layer.properties) {
+        if (property.first == "visible" && property.second == "false") {
+          visible = false;
+        }
+        else {
+          SPICED_LOG(Map, Warning, "Unhandled layer property: " << property.first << ": " << property.second);
+        }
+      }
 
-    for (const auto &layer : json.at("layers").ArrayRange()) {
+      layers.emplace_back(std::move(layer.data), visible);
+    }
 
+    // properties are resolved once, streamed maps keep the objects as they are until their chunk is loaded
+    for (auto &obj : file.objects) {
+      const auto gid = obj.gid;
 
-      if (layer.at("type").ToString() == "tilelayer") {
-        bool visible = layer.at("visible").ToBool();
+      const auto tileset = std::find_if(tilesets.begin(), tilesets.end(),
+        [gid](const Tileset &t_tileset) {
+        return gid >= t_tileset.min_gid() && gid <= t_tileset.max_gid();
+      });
+      assert(tileset != tilesets.end());
 
-        if (layer.hasKey("properties")) {
-          for (const auto &property : layer.at("properties").ObjectRange()) {
-            const std::string &prop_name = property.first;
-            const std::string value = property.second.ToString();
-            if (prop_name == "visible" && value == "false") {
-              visible = false;
-            }
-            else {
-              std::cerr << "Unhandled layer property: " << prop_name << ": " << value << '\n';
-            }
-            //props.emplace(property.first, property.second.ToString());
-          }
+      for (const auto &property : obj.properties) {
+        if (property.first == "visible" && property.second == "false") {
+          obj.visible = false;
         }
-
-        std::vector<int> data;
-        for (const auto &val : layer.at("data").ArrayRange()) {
-          data.push_back(val.ToInt());
+        else if (property.first == "exit") {
+          exits.push_back(property.second);
+        }
+        else {
+          SPICED_LOG(Map, Warning, "Unhandled object property: " << property.first << ": " << property.second);
         }
-        layers.emplace_back(std::move(data), visible);
       }
-      else if (layer.at("type").ToString() == "objectgroup") {
-        for (const auto &obj : layer.at("objects").ArrayRange()) {
-          const auto gid = obj.at("gid").ToInt();
-          const auto name = obj.at("name").ToString();
 
-          const auto tileset = std::find_if(m_tilesets.begin(), m_tilesets.end(),
-            [gid](const Tileset &t_tileset) {
-            return gid >= t_tileset.min_gid() && gid <= t_tileset.max_gid();
-          });
-          assert(tileset != m_tilesets.end());
+      // Tiled places tile objects by their bottom left corner
+      obj.y -= float(tileset->tile_height);
 
-          bool visible = obj.at("visible").ToBool();
+      SPICED_LOG(Map, Debug, "Placing object: " << obj.name << "(" << obj.x << ", " << obj.y << ")");
+    }
 
-          for (const auto &property : obj.at("properties").ObjectRange()) {
-            const std::string &prop_name = property.first;
-            const std::string value = property.second.ToString();
-            if (prop_name == "visible" && value == "false") {
-              visible = false;
-            }
-            else {
-              std::cerr << "Unhandled object property: " << prop_name << ": " << value << '\n';
+    // only the tile layers can be rebuilt in isolation, anything else that changed needs a full rebuild
+    const bool same_layout = t_incremental && !file.chunks && !m_chunk_index
+      && tilesize == m_tile_size
+      && sf::Vector2u(map_width, map_height) == m_map_size
+      && layers.size() == m_layer_data.size()
+      && tile_properties == m_tile_properties
+      && tilesets.size() == m_tilesets.size()
+      && std::equal(tilesets.begin(), tilesets.end(), m_tilesets.begin(),
+          [](const Tileset &t_lhs, const Tileset &t_rhs) {
+            return t_lhs.texture == t_rhs.texture && t_lhs.first_gid == t_rhs.first_gid
+              && t_lhs.tile_width == t_rhs.tile_width && t_lhs.tile_height == t_rhs.tile_height;
+          });
+
+    // a streamed map reads its window before anything changes, so a file that can't be read leaves the map as it was
+    std::map<std::pair<int, int>, std::shared_ptr<const Chunk_Index::Tiles>> window_chunks;
+    if (file.chunks)
+    {
+      const auto span = 2 * m_stream_radius + 1;
+      const auto &index = *file.chunks;
+      const auto first_chunk = m_window_chunk;
+      std::vector<std::shared_ptr<const Chunk_Index::Tiles>> chunks(size_t(span) * size_t(span));
+      t_game.jobs().parallel_for(chunks.size(), 1, [&](const size_t t_begin, const size_t t_end) {
+          for (auto i = t_begin; i < t_end; ++i)
+          {
+            const auto chunk = first_chunk + sf::Vector2i(int(i) % span, int(i) / span);
+            if (index.contains(chunk)) {
+              chunks[i] = std::make_shared<const Chunk_Index::Tiles>(index.read(chunk));
             }
-            //props.emplace(property.first, property.second.ToString());
           }
+        });
 
-          const auto get_float = [&](const std::string &t_name) {
-            auto v = obj.at(t_name);
-            if (v.JSONType() == json::JSON::Class::Floating) {
-              return float(v.ToFloat());
-            }
-            else {
-              return float(v.ToInt());
-            }
-          };
+      for (size_t i = 0; i < chunks.size(); ++i)
+      {
+        if (chunks[i]) {
+          window_chunks.emplace(chunk_key(first_chunk + sf::Vector2i(int(i) % span, int(i) / span)), std::move(chunks[i]));
+        }
+      }
+    }
+
+    m_tilesets = std::move(tilesets);
+    m_tile_properties = std::move(tile_properties);
+    index_tilesets();
+    build_property_sets(std::move(map_defaults));
+
+    if (file.chunks)
+    {
+      // every object comes back from the new file, with the behavior kept under its name
+      for (size_t i = 0; i < m_file_objects; ++i)
+      {
+        detach_object(m_objects[i]);
+      }
+      m_objects.erase(m_objects.begin(), m_objects.begin() + m_file_objects);
+      m_file_objects = 0;
+      m_attached_objects.clear();
+
+      m_chunk_index = std::move(file.chunks);
+      m_resident_chunks = std::move(window_chunks);
+      m_streamed_objects = std::move(file.objects);
+      m_chunk_objects.clear();
+      for (size_t i = 0; i < m_streamed_objects.size(); ++i)
+      {
+        const auto &obj = m_streamed_objects[i];
+        m_chunk_objects[chunk_key(world_chunk(sf::Vector2f(obj.x, obj.y), tilesize, m_chunk_index->chunk_size()))].push_back(i);
+      }
 
-          const auto x = get_float("x");
-          const auto y = get_float("y") - tileset->tile_height;
+      // the window loads again where it was, from the chunks read above
+      m_tile_size = tilesize;
+      m_layer_data = std::move(layers);
+      m_window_span = 0;
+      start_window(t_game.jobs(), m_window_chunk);
 
-          std::cout << "Placing object: " << name << "(" << x << ", " << y << ")\n";
+      std::vector<sf::Vector2i> loaded;
+      std::vector<sf::Vector2i> unloaded;
+      swap_window(*finish_window(), loaded, unloaded);
+    }
+    else
+    {
+      if (m_chunk_index)
+      {
+        m_chunk_index.reset();
+        m_window_chunk = sf::Vector2i();
+        m_window_span = 0;
+        m_resident_chunks.clear();
+        m_streamed_objects.clear();
+        m_chunk_objects.clear();
+        m_attached_objects.clear();
+        m_detached_behaviors.clear();
+      }
 
-          Object gameobj(name, *tileset, gid, visible, {}, {});
-          gameobj.set_position(x, y);
-          add_object(gameobj);
+      if (same_layout)
+      {
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+          if (!(layers[i] == m_layer_data[i]))
+          {
+            SPICED_LOG(Map, Info, "Rebuilding layer " << i << " of " << t_file_path);
+            rebuild_layer(i, layers[i]);
+            m_layer_data[i] = std::move(layers[i]);
+          }
         }
+        m_tile_passability = build_tile_passability(m_cell_property_sets, m_layer_data.size(), m_map_size);
+      }
+      else {
+        load(t_game.jobs(), tilesize, layers, map_width, map_height);
+      }
+
+      std::vector<Object> objects;
+      for (const auto &obj : file.objects)
+      {
+        objects.push_back(file_object(obj, m_tilesets, sf::Vector2f(0, 0)));
       }
+      replace_file_objects(std::move(objects));
     }
 
-    load(tilesize, layers, map_width, map_height);
+    m_file_exits = std::move(exits);
+    m_pathfinder.reset();
   }
 
   void Tile_Map::add_enter_action(const std::function<void(Game &)> t_action)
@@ -445,201 +693,823 @@ namespace spiced {
   }
 
 
-  void Tile_Map::load(sf::Vector2u t_tile_size, const std::vector<Layer> &layers, const unsigned int width, const unsigned int height)
+  void Tile_Map::load(Job_System &t_jobs, sf::Vector2u t_tile_size, const std::vector<Layer> &layers, const unsigned int width, const unsigned int height)
   {
     m_map_size = sf::Vector2u(width, height);
     m_tile_size = t_tile_size;
 
-    for (const auto &layer : layers)
-    {
-      for (const auto &tileset : m_tilesets)
-      {
-        const auto min_tile = tileset.min_gid();
-        const auto max_tile = tileset.max_gid();
-
-        sf::VertexArray vertices(sf::Quads);
-
-        // populate the vertex array, with one quad per tile
-        for (unsigned int i = 0; i < width; ++i)
-        {
-          for (unsigned int j = 0; j < height; ++j)
-          {
-            // get the current tile number
-            const auto tileNumber = layer.data[i + j * width];
+    use_layers(build_layers(t_jobs, layers, m_map_size));
+    m_layer_data = layers;
+  }
 
-            if (tileNumber >= min_tile && tileNumber <= max_tile)
-            {
-              auto tilePropsFunc = [tileNumber, this]() {
-                auto defaults_itr = m_map_defaults.find(tileNumber);
-                if (defaults_itr != m_map_defaults.end()) {
-                  return defaults_itr->second;
-                }
-                else {
-                  return Tile_Properties();
-                }
-              };
-
-              m_tile_data.emplace_back(i, j, tilePropsFunc(),
-                sf::FloatRect(float(i * t_tile_size.x), float(j * t_tile_size.y), float(t_tile_size.x), float(t_tile_size.y)));
-
-              const auto tilesetvertices = tileset.vertices(tileNumber, i, j);
-              for (size_t index = 0; index < tilesetvertices.getVertexCount(); ++index)
-              {
-                vertices.append(tilesetvertices[index]);
-                if (!layer.visible) {
-                  vertices[vertices.getVertexCount() - 1].color = sf::Color(255, 255, 255, 0);
-                }
-              }
+  Tile_Map::Layer_Build Tile_Map::build_layers(Job_System &t_jobs, const std::vector<Layer> &t_layers, const sf::Vector2u &t_size) const
+  {
+    const auto cells = size_t(t_size.x) * t_size.y;
 
-            }
-          }
-        }
+    Layer_Build build;
+    build.vertices.assign(t_layers.size() * m_tilesets.size(), sf::VertexArray(sf::Quads));
+    build.cells.assign(cells * t_layers.size(), 0);
 
-        m_layers.push_back(vertices);
+    // layers are independent of each other, big maps build them in parallel
+    std::vector<char> animated(t_layers.size(), false);
+    const auto build_range = [&](const size_t t_begin, const size_t t_end) {
+      for (auto i = t_begin; i < t_end; ++i)
+      {
+        animated[i] = build_layer(t_layers[i], t_size, build.vertices.data() + i * m_tilesets.size(), build.cells.data() + i * cells);
       }
+    };
+
+    if (cells * t_layers.size() < min_parallel_mesh_tiles) {
+      build_range(0, t_layers.size());
+    } else {
+      t_jobs.parallel_for(t_layers.size(), 1, build_range);
     }
+
+    build.animated.assign(animated.begin(), animated.end());
+    build.passability = build_tile_passability(build.cells, t_layers.size(), t_size);
+    return build;
   }
 
-  void Tile_Map::add_object(const Object &t_o)
+  void Tile_Map::use_layers(Layer_Build t_build)
   {
-    m_objects.push_back(t_o);
+    m_layers = std::move(t_build.vertices);
+    m_cell_property_sets = std::move(t_build.cells);
+    m_animated_layers = std::move(t_build.animated);
+    m_tile_passability = std::move(t_build.passability);
   }
 
-  sf::FloatRect Tile_Map::get_bounding_box(const sf::Sprite &t_s, const sf::Vector2f &t_distance)
+  bool Tile_Map::is_streamed() const
   {
-    auto bounding_box = sf::Transform().translate(t_distance).transformRect(t_s.getGlobalBounds());
-    bounding_box = sf::FloatRect(bounding_box.left + .05f, bounding_box.top + .05f, bounding_box.width - .10f, bounding_box.height - .10f);
-    return bounding_box;
+    return bool(m_chunk_index);
   }
 
-  bool Tile_Map::test_move(const sf::Sprite &t_s, const sf::Vector2f &distance) const
+  sf::Vector2i Tile_Map::window_origin() const
   {
-    auto bounding_box = get_bounding_box(t_s, distance);
-
-    for (const auto &data : m_tile_data)
-    {
-      if (!data.properties.passable && data.bounds.intersects(bounding_box))
-      {
-        return false;
-      }
+    if (!m_chunk_index) {
+      return sf::Vector2i(0, 0);
     }
 
-    for (const auto &object : m_objects)
-    {
-      if (object.getGlobalBounds().intersects(bounding_box))
-      {
-        return false;
-      }
-    }
+    const auto chunk_size = m_chunk_index->chunk_size();
+    return sf::Vector2i(m_window_chunk.x * int(chunk_size.x), m_window_chunk.y * int(chunk_size.y));
+  }
 
-    return true;
+  sf::Vector2f Tile_Map::world_offset() const
+  {
+    const auto origin = window_origin();
+    return sf::Vector2f(float(origin.x) * float(m_tile_size.x), float(origin.y) * float(m_tile_size.y));
   }
 
-  void Tile_Map::set_collision_action(const std::string &t_obj_name,
-    std::function<void(const Game_State &, Object &, sf::Sprite &)> t_collision_action)
+  sf::Vector2i Tile_Map::chunk_at(const sf::Vector2f &t_position) const
   {
-    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
-    if (obj == m_objects.end()) throw std::logic_error("Attempt to set collision action on non-existent object: " + t_obj_name);
-    obj->set_collision_action(t_collision_action);
+    return world_chunk(t_position + world_offset(), m_tile_size, m_chunk_index->chunk_size());
   }
 
+  void Tile_Map::set_stream_radius(const int t_radius)
+  {
+    if (t_radius < 0) {
+      throw std::logic_error("Attempt to set a negative stream radius on map: " + m_file_path);
+    }
+    m_stream_radius = t_radius;
+  }
 
-  void Tile_Map::set_portrait(const std::string &t_obj_name, const std::string &t_portrait_path)
+  void Tile_Map::add_chunk_load_action(std::function<void(Game &, const int, const int)> t_action)
   {
-    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
-    if (obj == m_objects.end()) throw std::logic_error("Attempt to set portrait path on non-existent object: " + t_obj_name);
-    obj->set_portrait(t_portrait_path);
+    m_chunk_load_actions.push_back(std::move(t_action));
   }
 
-  void Tile_Map::set_action_generator(const std::string &t_obj_name,
-    std::function<std::vector<Object_Action>(const Game_State &, Object &)> t_action_generator)
+  void Tile_Map::add_chunk_unload_action(std::function<void(Game &, const int, const int)> t_action)
   {
-    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
-    if (obj == m_objects.end()) throw std::logic_error("Attempt to set collision action on non-existent object: " + t_obj_name);
-    obj->set_action_generator(t_action_generator);
+    m_chunk_unload_actions.push_back(std::move(t_action));
   }
 
-  std::vector<std::reference_wrapper<Object>> Tile_Map::get_collisions(const sf::Sprite &t_s, const sf::Vector2f &t_distance)
+  void Tile_Map::stream_around(Job_System &t_jobs, const sf::Vector2f &t_position)
   {
-    std::vector<std::reference_wrapper<Object>> retval;
-    auto bounding_box = get_bounding_box(t_s, t_distance);
+    if (!m_chunk_index || m_window_build) {
+      return;
+    }
 
-    for (auto &object : m_objects)
+    const auto first_chunk = chunk_at(t_position) - sf::Vector2i(m_stream_radius, m_stream_radius);
+    if (first_chunk != m_window_chunk || 2 * m_stream_radius + 1 != m_window_span)
     {
-      if (object.getGlobalBounds().intersects(bounding_box))
-      {
-        retval.push_back(std::ref(object));
-      }
+      start_window(t_jobs, first_chunk);
     }
+  }
 
-    return retval;
+  bool Tile_Map::window_ready() const
+  {
+    return m_window_build && m_window_build->done.done();
   }
 
-  sf::Vector2f Tile_Map::adjust_move(const sf::Sprite &t_s, const sf::Vector2f &distance) const
+  void Tile_Map::start_window(Job_System &t_jobs, const sf::Vector2i &t_first_chunk)
   {
-    if (test_move(t_s, distance)) {
-      return distance;
+    auto build = std::make_shared<Window_Build>(t_jobs);
+    build->first_chunk = t_first_chunk;
+    build->span = 2 * m_stream_radius + 1;
+
+    // resident chunks are handed over as they are, the worker only reads the others
+    const auto span = build->span;
+    std::vector<std::shared_ptr<const Chunk_Index::Tiles>> chunks(size_t(span) * size_t(span));
+    for (int y = 0; y < span; ++y)
+    {
+      for (int x = 0; x < span; ++x)
+      {
+        const auto resident = m_resident_chunks.find(chunk_key(t_first_chunk + sf::Vector2i(x, y)));
+        if (resident != m_resident_chunks.end()) {
+          chunks[size_t(y * span + x)] = resident->second;
+        }
+      }
     }
 
-    const auto xOnly = sf::Vector2f(distance.x, 0);
-    if (test_move(t_s, xOnly)) {
-      return xOnly;
+    std::vector<bool> visible;
+    for (const auto &layer : m_layer_data)
+    {
+      visible.push_back(layer.visible);
+    }
+
+    // only reads the index, the chunks and, through build_layers, state that stays put until the map is reloaded
+    const auto index = m_chunk_index;
+    t_jobs.run([this, build, span, chunks, visible, index]() mutable {
+        const auto chunk_size = index->chunk_size();
+        const auto size = sf::Vector2u(chunk_size.x * unsigned(span), chunk_size.y * unsigned(span));
+
+        for (const auto layer_visible : visible)
+        {
+          build->layers.emplace_back(std::vector<int>(size_t(size.x) * size.y, 0), layer_visible);
+        }
+
+        for (int y = 0; y < span; ++y)
+        {
+          for (int x = 0; x < span; ++x)
+          {
+            auto &tiles = chunks[size_t(y * span + x)];
+            const auto chunk = build->first_chunk + sf::Vector2i(x, y);
+
+            if (!tiles && index->contains(chunk))
+            {
+              tiles = std::make_shared<const Chunk_Index::Tiles>(index->read(chunk));
+              build->read.emplace_back(chunk, tiles);
+            }
+
+            if (!tiles) {
+              continue;
+            }
+
+            for (size_t layer = 0; layer < build->layers.size() && layer < tiles->size(); ++layer)
+            {
+              const auto &source = (*tiles)[layer];
+              auto &data = build->layers[layer].data;
+              for (unsigned int row = 0; row < chunk_size.y; ++row)
+              {
+                const auto first = source.begin() + std::ptrdiff_t(row * chunk_size.x);
+                std::copy(first, first + std::ptrdiff_t(chunk_size.x),
+                    data.begin() + std::ptrdiff_t((unsigned(y) * chunk_size.y + row) * size.x + unsigned(x) * chunk_size.x));
+              }
+            }
+          }
+        }
+
+        build->meshes = build_layers(build->jobs, build->layers, size);
+      }, build->done);
+
+    m_window_build = std::move(build);
+  }
+
+  void Tile_Map::cancel_window()
+  {
+    const auto build = std::move(m_window_build);
+    if (build)
+    {
+      try {
+        build->jobs.wait(build->done);
+      } catch (const std::exception &e) {
+        SPICED_LOG(Map, Warning, "Dropped window of " << m_file_path << " that failed to load: " << e.what());
+      }
     }
+  }
 
-    const auto yOnly = sf::Vector2f(0, distance.y);
-    if (test_move(t_s, yOnly)) {
-      return yOnly;
+  void Tile_Map::detach_object(const Object &t_obj)
+  {
+    if (t_obj.name().empty()) {
+      return;
     }
 
-    return sf::Vector2f(0, 0);
+    // kept in world tiles while the window moves on
+    auto behavior = t_obj.behavior();
+    behavior.motion.wander_origin += window_origin();
+    m_detached_behaviors[t_obj.name()] = std::move(behavior);
   }
 
-  void Tile_Map::do_move(const Game_State &t_game, sf::Sprite &t_s, const sf::Vector2f &distance)
+  Object_Behavior *Tile_Map::detached_behavior(const std::string &t_obj_name)
   {
-    const auto time = t_game.state().simulation_time;
-    auto bounds = t_s.getGlobalBounds();
+    const auto streamed = std::any_of(m_streamed_objects.begin(), m_streamed_objects.end(),
+        [&](const Map_File::Object &t_obj) { return t_obj.name == t_obj_name; });
+    return streamed ? &m_detached_behaviors[t_obj_name] : nullptr;
+  }
 
-    auto center = sf::Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2);
-    auto endCenter = center + distance;
+  void Tile_Map::attach_window(Game &t_game, sf::Sprite &t_avatar)
+  {
+    std::shared_ptr<Window_Build> build;
+    try {
+      build = finish_window();
+    } catch (const std::exception &e) {
+      // e.g. the file was saved over while playing, stream_around tries again until the reload picks it up
+      SPICED_LOG(Map, Error, "Keeping the current window of " << m_file_path << ", the next one failed to load: " << e.what());
+      return;
+    }
 
-    auto movementBounds = sf::FloatRect(std::min(center.x, endCenter.x) - 1, std::min(center.y, endCenter.y) - 1, distance.x + 2, distance.y + 2);
+    std::vector<sf::Vector2i> loaded;
+    std::vector<sf::Vector2i> unloaded;
+    t_avatar.move(swap_window(*build, loaded, unloaded));
 
-    auto segment = Line_Segment(center, endCenter);
+    SPICED_LOG(Map, Debug, "Moved the window of " << m_file_path << " to chunk " << m_window_chunk.x << ", " << m_window_chunk.y
+        << ": " << loaded.size() << " chunks loaded, " << unloaded.size() << " unloaded, " << m_resident_chunks.size() << " resident");
 
-    std::vector<std::tuple<std::reference_wrapper<Tile_Data>, Line_Segment, float>> segments;
-    for (auto &data : m_tile_data)
+    for (const auto &chunk : unloaded)
     {
-      if (data.bounds.intersects(movementBounds))
+      for (auto &action : m_chunk_unload_actions)
       {
-        // this is a potential box that we've passed through
-        if (auto passedSegment = segment.clipTo(data.bounds))
-        {
-          // it's a valid segment
-          segments.push_back(std::make_tuple(std::ref(data), passedSegment, passedSegment.distance_to_p1(center)));
-        }
+        action(t_game, chunk.x, chunk.y);
       }
     }
 
-    std::sort(segments.begin(), segments.end(),
-      [](const std::tuple<std::reference_wrapper<Tile_Data>, Line_Segment, float> &t_lhs,
-         const std::tuple<std::reference_wrapper<Tile_Data>, Line_Segment, float> &t_rhs)
+    for (const auto &chunk : loaded)
+    {
+      for (auto &action : m_chunk_load_actions)
       {
-        return std::get<2>(t_lhs) < std::get<2>(t_rhs);
+        action(t_game, chunk.x, chunk.y);
       }
-    );
+    }
+  }
 
-    auto total_length = segment.length();
+  std::shared_ptr<Tile_Map::Window_Build> Tile_Map::finish_window()
+  {
+    const auto build = std::move(m_window_build);
+    build->jobs.wait(build->done);
+    return build;
+  }
 
+  sf::Vector2f Tile_Map::swap_window(Window_Build &t_build, std::vector<sf::Vector2i> &t_loaded, std::vector<sf::Vector2i> &t_unloaded)
+  {
+    const auto chunk_size = sf::Vector2i(m_chunk_index->chunk_size());
+    const auto first_chunk = t_build.first_chunk;
+    const auto span = t_build.span;
 
-    auto total = 0.0;
-    // segments should now contain a sorted list of tiles that this movement passes through
-    for (auto &cur_segment : segments)
+    for (int y = 0; y < m_window_span; ++y)
     {
-      auto length = std::get<1>(cur_segment).length();
-      auto percent = total_length == 0 ? 1 : (length / total_length);
+      for (int x = 0; x < m_window_span; ++x)
+      {
+        const auto chunk = m_window_chunk + sf::Vector2i(x, y);
+        if (!in_window(chunk, first_chunk, span)) {
+          t_unloaded.push_back(chunk);
+        }
+      }
+    }
+
+    for (int y = 0; y < span; ++y)
+    {
+      for (int x = 0; x < span; ++x)
+      {
+        const auto chunk = first_chunk + sf::Vector2i(x, y);
+        if (!in_window(chunk, m_window_chunk, m_window_span)) {
+          t_loaded.push_back(chunk);
+        }
+      }
+    }
+
+    // everything keeps its place in the world, so on the map it moves the other way than the window
+    const auto tile_shift = sf::Vector2i((m_window_chunk.x - first_chunk.x) * chunk_size.x, (m_window_chunk.y - first_chunk.y) * chunk_size.y);
+    const auto shift = sf::Vector2f(float(tile_shift.x) * float(m_tile_size.x), float(tile_shift.y) * float(m_tile_size.y));
+
+    const auto move_object = [&](Object &t_obj) {
+      const auto position = t_obj.getPosition() + shift;
+      t_obj.set_position(position.x, position.y);
+
+      auto &motion = t_obj.motion();
+      for (auto &waypoint : motion.route)
+      {
+        waypoint += shift;
+      }
+      motion.wander_origin += tile_shift;
+    };
+
+    // file objects stay as long as the chunk they belong to does, wherever they walked off to
+    std::vector<Object> objects;
+    std::vector<size_t> attached;
+    for (size_t i = 0; i < m_file_objects; ++i)
+    {
+      const auto &source = m_streamed_objects[m_attached_objects[i]];
+      if (in_window(world_chunk(sf::Vector2f(source.x, source.y), m_tile_size, m_chunk_index->chunk_size()), first_chunk, span))
+      {
+        move_object(m_objects[i]);
+        objects.push_back(std::move(m_objects[i]));
+        attached.push_back(m_attached_objects[i]);
+      } else {
+        detach_object(m_objects[i]);
+      }
+    }
+
+    m_window_chunk = first_chunk;
+    m_window_span = span;
+
+    const auto offset = world_offset();
+    const auto origin = window_origin();
+    for (const auto &chunk : t_loaded)
+    {
+      const auto chunk_objects = m_chunk_objects.find(chunk_key(chunk));
+      if (chunk_objects == m_chunk_objects.end()) {
+        continue;
+      }
+
+      for (const auto source : chunk_objects->second)
+      {
+        auto obj = file_object(m_streamed_objects[source], m_tilesets, offset);
+
+        const auto behavior = m_detached_behaviors.find(obj.name());
+        if (behavior != m_detached_behaviors.end())
+        {
+          behavior->second.motion.wander_origin -= origin;
+          obj.set_behavior(behavior->second);
+          m_detached_behaviors.erase(behavior);
+        }
+
+        objects.push_back(std::move(obj));
+        attached.push_back(source);
+      }
+    }
+
+    // objects added by script are not part of any chunk and stay
+    for (size_t i = m_file_objects; i < m_objects.size(); ++i)
+    {
+      move_object(m_objects[i]);
+      objects.push_back(std::move(m_objects[i]));
+    }
+
+    m_objects = std::move(objects);
+    m_file_objects = attached.size();
+    m_attached_objects = std::move(attached);
+
+    // one ring of chunks around the window stays resident, walking back and forth over its edge doesn't read them again
+    for (auto &chunk : t_build.read)
+    {
+      m_resident_chunks[chunk_key(chunk.first)] = std::move(chunk.second);
+    }
+
+    for (auto chunk = m_resident_chunks.begin(); chunk != m_resident_chunks.end();)
+    {
+      if (in_window(sf::Vector2i(chunk->first.first, chunk->first.second), first_chunk - sf::Vector2i(1, 1), span + 2)) {
+        ++chunk;
+      } else {
+        chunk = m_resident_chunks.erase(chunk);
+      }
+    }
+
+    m_map_size = sf::Vector2u(unsigned(span * chunk_size.x), unsigned(span * chunk_size.y));
+    m_layer_data = std::move(t_build.layers);
+    use_layers(std::move(t_build.meshes));
+
+    m_pathfinder.reset();
+    m_object_bounds_generation = 0;
+    ++m_revision;
+
+    return shift;
+  }
+
+  void Tile_Map::index_tilesets()
+  {
+    int max_gid = 0;
+    for (const auto &tileset : m_tilesets)
+    {
+      max_gid = std::max(max_gid, tileset.max_gid());
+    }
+
+    m_tile_tilesets.assign(size_t(max_gid) + 1, no_tileset);
+    for (size_t i = 0; i < m_tilesets.size(); ++i)
+    {
+      std::fill(m_tile_tilesets.begin() + m_tilesets[i].min_gid(), m_tile_tilesets.begin() + m_tilesets[i].max_gid() + 1, uint16_t(i));
+    }
+  }
+
+  void Tile_Map::build_property_sets(std::map<int, Tile_Properties> t_defaults)
+  {
+    int max_gid = 0;
+    for (const auto &tileset : m_tilesets)
+    {
+      max_gid = std::max(max_gid, tileset.max_gid());
+    }
+
+    m_property_sets.assign(1, Tile_Properties());
+    m_tile_property_sets.assign(size_t(max_gid) + 1, 0);
+
+    // properties without actions only differ in their flags, tiles with equal flags share a set
+    const uint16_t unassigned = std::numeric_limits<uint16_t>::max();
+    uint16_t flag_sets[2][2] = { { unassigned, unassigned }, { unassigned, 0 } };
+
+    for (auto &defaults : t_defaults)
+    {
+      const auto gid = defaults.first;
+      auto &props = defaults.second;
+
+      const auto used = std::any_of(m_tilesets.begin(), m_tilesets.end(),
+          [gid](const Tileset &t_tileset) { return gid >= t_tileset.min_gid() && gid <= t_tileset.max_gid(); });
+      if (!used) {
+        continue;
+      }
+
+      const auto has_actions = bool(props.movement_action) || bool(props.collision_action);
+      auto &shared = flag_sets[props.passable][props.visible];
+
+      if (!has_actions && shared != unassigned) {
+        m_tile_property_sets[size_t(gid)] = shared;
+        continue;
+      }
+
+      if (m_property_sets.size() >= unassigned) {
+        throw std::runtime_error("Too many distinct tile properties in map: " + m_file_path);
+      }
+
+      const auto set = uint16_t(m_property_sets.size());
+      m_property_sets.push_back(std::move(props));
+      m_tile_property_sets[size_t(gid)] = set;
+
+      if (!has_actions) {
+        shared = set;
+      }
+    }
+  }
+
+  bool Tile_Map::build_layer(const Layer &layer, const sf::Vector2u &t_size, sf::VertexArray *t_vertices, uint16_t *t_cells) const
+  {
+    const auto width = t_size.x;
+    const auto height = t_size.y;
+    const auto max_gid = int(m_tile_tilesets.size()) - 1;
+    const auto tileset_of = [&](const int t_gid) {
+      return t_gid >= 0 && t_gid <= max_gid ? m_tile_tilesets[size_t(t_gid)] : no_tileset;
+    };
+
+    // count first, so every vertex array is allocated exactly once
+    std::vector<size_t> quads(m_tilesets.size(), 0);
+    bool animated = false;
+
+    for (unsigned int cell = 0; cell < width * height; ++cell)
+    {
+      const auto tileNumber = layer.data[cell];
+      const auto tileset = tileset_of(tileNumber);
+
+      if (tileset != no_tileset)
+      {
+        ++quads[tileset];
+        t_cells[cell] = m_tile_property_sets[size_t(tileNumber)];
+        animated = animated || m_tilesets[tileset].anim.count(tileNumber) != 0;
+      }
+    }
+
+    std::vector<sf::Vertex *> next_quad(m_tilesets.size(), nullptr);
+    for (size_t tileset = 0; tileset < m_tilesets.size(); ++tileset)
+    {
+      t_vertices[tileset].resize(quads[tileset] * 4);
+      if (quads[tileset] != 0) {
+        next_quad[tileset] = &t_vertices[tileset][0];
+      }
+    }
+
+    // one quad per tile, column by column, tiles bigger than the grid overlap in the same order as before
+    for (unsigned int i = 0; i < width; ++i)
+    {
+      for (unsigned int j = 0; j < height; ++j)
+      {
+        const auto tileNumber = layer.data[i + j * width];
+        const auto tileset = tileset_of(tileNumber);
+
+        if (tileset != no_tileset)
+        {
+          auto *quad = next_quad[tileset];
+          next_quad[tileset] += 4;
+          m_tilesets[tileset].write_quad(quad, tileNumber, int(i), int(j));
+
+          if (!layer.visible) {
+            for (int corner = 0; corner < 4; ++corner)
+            {
+              quad[corner].color = sf::Color(255, 255, 255, 0);
+            }
+          }
+        }
+      }
+    }
+
+    return animated;
+  }
+
+  void Tile_Map::rebuild_layer(const size_t t_layer, const Layer &t_data)
+  {
+    const auto cells = size_t(m_map_size.x) * m_map_size.y;
+    const auto first_cell = m_cell_property_sets.begin() + std::ptrdiff_t(t_layer * cells);
+    std::fill(first_cell, first_cell + std::ptrdiff_t(cells), uint16_t(0));
+
+    m_animated_layers[t_layer] = build_layer(t_data, m_map_size, m_layers.data() + t_layer * m_tilesets.size(), m_cell_property_sets.data() + t_layer * cells);
+  }
+
+  Passability_Grid Tile_Map::build_tile_passability(const std::vector<uint16_t> &t_cells, const size_t t_layers, const sf::Vector2u &t_size) const
+  {
+    const auto width = t_size.x;
+    const auto cells = size_t(width) * t_size.y;
+
+    Passability_Grid grid(width, t_size.y);
+    for (size_t layer = 0; layer < t_layers; ++layer)
+    {
+      const auto *layer_cells = t_cells.data() + layer * cells;
+      for (size_t cell = 0; cell < cells; ++cell)
+      {
+        if (!m_property_sets[layer_cells[cell]].passable) {
+          grid.set_passable(int(cell % width), int(cell / width), false);
+        }
+      }
+    }
+
+    return grid;
+  }
+
+  const Aabb_Batch &Tile_Map::object_bounds() const
+  {
+    const auto generation = Object::placement_generation();
+    if (m_object_bounds_generation != generation)
+    {
+      m_object_bounds.clear();
+      m_object_bounds.reserve(m_objects.size());
+      for (const auto &object : m_objects)
+      {
+        m_object_bounds.push_back(object.getGlobalBounds());
+      }
+      m_object_bounds_generation = generation;
+    }
+    return m_object_bounds;
+  }
+
+  sf::IntRect Tile_Map::tiles_within(const sf::FloatRect &t_bounds) const
+  {
+    const auto first_x = std::max(0, int(std::floor(t_bounds.left / m_tile_size.x)));
+    const auto first_y = std::max(0, int(std::floor(t_bounds.top / m_tile_size.y)));
+    const auto last_x = std::min(int(m_map_size.x), int(std::ceil((t_bounds.left + t_bounds.width) / m_tile_size.x)));
+    const auto last_y = std::min(int(m_map_size.y), int(std::ceil((t_bounds.top + t_bounds.height) / m_tile_size.y)));
+    return sf::IntRect(first_x, first_y, std::max(0, last_x - first_x), std::max(0, last_y - first_y));
+  }
+
+  void Tile_Map::replace_file_objects(std::vector<Object> t_objects)
+  {
+    // objects loaded from the file come first, anything after them was added by script
+    for (auto &obj : t_objects)
+    {
+      const auto previous = std::find_if(m_objects.begin(), m_objects.begin() + m_file_objects,
+          [&obj](const Object &t_obj) { return t_obj.name() == obj.name(); });
+
+      if (previous != m_objects.begin() + m_file_objects)
+      {
+        obj.inherit_behavior(*previous);
+      }
+    }
+
+    m_objects.erase(m_objects.begin(), m_objects.begin() + m_file_objects);
+    m_objects.insert(m_objects.begin(), std::make_move_iterator(t_objects.begin()), std::make_move_iterator(t_objects.end()));
+    m_file_objects = t_objects.size();
+    m_object_bounds_generation = 0;
+  }
+
+  const std::string &Tile_Map::file_path() const
+  {
+    return m_file_path;
+  }
+
+  uint64_t Tile_Map::revision() const
+  {
+    return m_revision;
+  }
+
+  void Tile_Map::add_object(const Object &t_o)
+  {
+    m_objects.push_back(t_o);
+    m_pathfinder.reset();
+    m_object_bounds_generation = 0;
+  }
+
+  sf::FloatRect Tile_Map::get_bounding_box(const sf::Sprite &t_s, const sf::Vector2f &t_distance)
+  {
+    auto bounding_box = sf::Transform().translate(t_distance).transformRect(t_s.getGlobalBounds());
+    bounding_box = sf::FloatRect(bounding_box.left + .05f, bounding_box.top + .05f, bounding_box.width - .10f, bounding_box.height - .10f);
+    return bounding_box;
+  }
+
+  bool Tile_Map::test_move(const sf::Sprite &t_s, const sf::Vector2f &distance) const
+  {
+    auto bounding_box = get_bounding_box(t_s, distance);
+
+    const auto tiles = tiles_within(bounding_box);
+    for (int y = tiles.top; y < tiles.top + tiles.height; ++y)
+    {
+      for (int x = tiles.left; x < tiles.left + tiles.width; ++x)
+      {
+        if (!m_tile_passability.passable(x, y)) {
+          return false;
+        }
+      }
+    }
+
+    object_bounds().intersecting(bounding_box, m_object_hits);
+    return std::none_of(m_object_hits.begin(), m_object_hits.end(), [](const uint64_t t_hits) { return t_hits != 0; });
+  }
+
+  void Tile_Map::set_collision_action(const std::string &t_obj_name,
+    std::function<void(const Game_State &, Object &, sf::Sprite &)> t_collision_action)
+  {
+    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
+    if (obj != m_objects.end()) {
+      obj->set_collision_action(t_collision_action);
+    } else if (const auto behavior = detached_behavior(t_obj_name)) {
+      behavior->collision_action = t_collision_action;
+    } else {
+      throw std::logic_error("Attempt to set collision action on non-existent object: " + t_obj_name);
+    }
+  }
+
+
+  void Tile_Map::set_portrait(const std::string &t_obj_name, const std::string &t_portrait_path)
+  {
+    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
+    if (obj != m_objects.end()) {
+      obj->set_portrait(t_portrait_path);
+    } else if (const auto behavior = detached_behavior(t_obj_name)) {
+      behavior->portrait = t_portrait_path;
+    } else {
+      throw std::logic_error("Attempt to set portrait path on non-existent object: " + t_obj_name);
+    }
+  }
+
+  void Tile_Map::add_exit(const std::string &t_map_name)
+  {
+    if (std::find(m_script_exits.begin(), m_script_exits.end(), t_map_name) == m_script_exits.end()) {
+      m_script_exits.push_back(t_map_name);
+    }
+  }
+
+  std::vector<std::string> Tile_Map::exits() const
+  {
+    auto exits = m_script_exits;
+    for (const auto &exit : m_file_exits)
+    {
+      if (std::find(exits.begin(), exits.end(), exit) == exits.end()) {
+        exits.push_back(exit);
+      }
+    }
+    return exits;
+  }
+
+  std::vector<std::string> Tile_Map::portraits() const
+  {
+    std::vector<std::string> portraits;
+    for (const auto &obj : m_objects)
+    {
+      const auto &portrait = obj.get_portrait();
+      if (!portrait.empty() && std::find(portraits.begin(), portraits.end(), portrait) == portraits.end()) {
+        portraits.push_back(portrait);
+      }
+    }
+
+    // objects of a streamed map may come into the window any time
+    for (const auto &behavior : m_detached_behaviors)
+    {
+      const auto &portrait = behavior.second.portrait;
+      if (!portrait.empty() && std::find(portraits.begin(), portraits.end(), portrait) == portraits.end()) {
+        portraits.push_back(portrait);
+      }
+    }
+    return portraits;
+  }
+
+  void Tile_Map::set_action_generator(const std::string &t_obj_name,
+    std::function<std::vector<Object_Action>(const Game_State &, Object &)> t_action_generator)
+  {
+    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
+    if (obj != m_objects.end()) {
+      obj->set_action_generator(t_action_generator);
+    } else if (const auto behavior = detached_behavior(t_obj_name)) {
+      behavior->action_generator = t_action_generator;
+    } else {
+      throw std::logic_error("Attempt to set collision action on non-existent object: " + t_obj_name);
+    }
+  }
+
+  std::vector<std::reference_wrapper<Object>> Tile_Map::get_collisions(const sf::Sprite &t_s, const sf::Vector2f &t_distance)
+  {
+    std::vector<std::reference_wrapper<Object>> retval;
+    auto bounding_box = get_bounding_box(t_s, t_distance);
+
+    object_bounds().intersecting(bounding_box, m_object_hits);
+    Aabb_Batch::for_each_hit(m_object_hits, [&](const size_t t_object) {
+        retval.push_back(std::ref(m_objects[t_object]));
+      });
+
+    return retval;
+  }
+
+  Object *Tile_Map::first_collision(const sf::Sprite &t_s, const sf::Vector2f &t_distance)
+  {
+    object_bounds().intersecting(get_bounding_box(t_s, t_distance), m_object_hits);
+
+    for (size_t word = 0; word < m_object_hits.size(); ++word)
+    {
+      if (const auto bits = m_object_hits[word])
+      {
+        auto bit = size_t(0);
+        while (((bits >> bit) & 1) == 0) {
+          ++bit;
+        }
+        return &m_objects[word * 64 + bit];
+      }
+    }
+
+    return nullptr;
+  }
+
+  sf::Vector2f Tile_Map::adjust_move(const sf::Sprite &t_s, const sf::Vector2f &distance) const
+  {
+    const auto &tiles = tile_passability();
+
+    return slide_move(get_bounding_box(t_s, sf::Vector2f(0, 0)), distance,
+        [&](const sf::FloatRect &t_box, const sf::Vector2f &t_distance, Sweep_Hit &t_hit) {
+          // the avatar is allowed to walk off the map
+          sweep_tiles(tiles, m_tile_size, t_box, t_distance, false, t_hit);
+
+          object_bounds().touching(swept_bounds(t_box, t_distance), m_object_hits);
+          Aabb_Batch::for_each_hit(m_object_hits, [&](const size_t t_object) {
+              sweep_box(t_box, t_distance, m_objects[t_object].getGlobalBounds(), t_hit);
+            });
+        });
+  }
+
+  void Tile_Map::do_move(const Game_State &t_game, sf::Sprite &t_s, const sf::Vector2f &distance)
+  {
+    const auto time = t_game.state().simulation_time;
+    auto bounds = t_s.getGlobalBounds();
+
+    auto center = sf::Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2);
+    auto endCenter = center + distance;
+
+    auto movementBounds = sf::FloatRect(std::min(center.x, endCenter.x) - 1, std::min(center.y, endCenter.y) - 1,
+        std::abs(distance.x) + 2, std::abs(distance.y) + 2);
+
+    auto segment = Line_Segment(center, endCenter);
+
+    const auto cells = size_t(m_map_size.x) * m_map_size.y;
+    const auto tiles = tiles_within(movementBounds);
+
+    // at most one segment per layer and tile in range, reserved up front so the frame arena hands out a single block
+    Frame_Vector<std::tuple<uint16_t, Line_Segment, float>> segments(
+        Arena_Allocator<std::tuple<uint16_t, Line_Segment, float>>(t_game.game().frame_arena()));
+    segments.reserve(m_layer_data.size() * size_t(tiles.width) * size_t(tiles.height));
+
+    for (size_t layer = 0; layer < m_layer_data.size(); ++layer)
+    {
+      const auto *layer_cells = m_cell_property_sets.data() + layer * cells;
+      for (int y = tiles.top; y < tiles.top + tiles.height; ++y)
+      {
+        for (int x = tiles.left; x < tiles.left + tiles.width; ++x)
+        {
+          // only tiles with an action matter, the default set never has one
+          const auto set = layer_cells[size_t(y) * m_map_size.x + size_t(x)];
+          if (set == 0) {
+            continue;
+          }
+
+          const auto tile_bounds = sf::FloatRect(float(x * m_tile_size.x), float(y * m_tile_size.y), float(m_tile_size.x), float(m_tile_size.y));
+
+          // this is a potential box that we've passed through
+          if (auto passedSegment = segment.clipTo(tile_bounds))
+          {
+            // it's a valid segment
+            segments.push_back(std::make_tuple(set, passedSegment, passedSegment.distance_to_p1(center)));
+          }
+        }
+      }
+    }
+
+    std::sort(segments.begin(), segments.end(),
+      [](const std::tuple<uint16_t, Line_Segment, float> &t_lhs,
+         const std::tuple<uint16_t, Line_Segment, float> &t_rhs)
+      {
+        return std::get<2>(t_lhs) < std::get<2>(t_rhs);
+      }
+    );
+
+    auto total_length = segment.length();
+
+
+    auto total = 0.0;
+    // segments should now contain a sorted list of tiles that this movement passes through
+    for (auto &cur_segment : segments)
+    {
+      auto length = std::get<1>(cur_segment).length();
+      auto percent = total_length == 0 ? 1 : (length / total_length);
       total += percent;
 
-      std::get<0>(cur_segment).get().properties.do_movement_action(Game_State(Simulation_State(t_game.state().game_time, time * percent), t_game.game()), length);
+      m_property_sets[std::get<0>(cur_segment)].do_movement_action(Game_State(Simulation_State(t_game.state().game_time, time * percent), t_game.game()), length);
     }
 
     //assert(total >= 0.999);
@@ -660,19 +1530,304 @@ namespace spiced {
     // apply the transform
     states.transform *= getTransform();
 
-    for (size_t i = 0; i < m_layers.size(); ++i)
+    draw_layers(target, states);
+
+    for (auto &obj : m_objects)
+    {
+      target.draw(obj, states);
+    }
+  }
+
+  void Tile_Map::draw_layers(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    draw_layers(target, states, 0, m_layer_data.size());
+  }
+
+  void Tile_Map::draw_layers(sf::RenderTarget& target, sf::RenderStates states, const size_t t_first_layer, const size_t t_end_layer) const
+  {
+    const auto tilesets = m_tilesets.size();
+    for (size_t i = t_first_layer * tilesets; i < t_end_layer * tilesets; ++i)
     {
       auto state = states;
-      state.texture = &m_tilesets[i % m_tilesets.size()].texture.get();
+      state.texture = m_tilesets[i % tilesets].texture.get();
       target.draw(m_layers[i], state);
     }
+  }
 
-    for (auto &obj : m_objects)
+  size_t Tile_Map::layer_count() const
+  {
+    return m_layer_data.size();
+  }
+
+  bool Tile_Map::layer_is_animated(const size_t t_layer) const
+  {
+    return m_animated_layers[t_layer];
+  }
+
+  Map_Memory Tile_Map::memory_usage() const
+  {
+    Map_Memory memory;
+
+    const auto cells = size_t(m_map_size.x) * m_map_size.y;
+    for (size_t layer = 0; layer < m_layer_data.size(); ++layer)
     {
-      target.draw(obj, states);
+      Layer_Memory layer_memory;
+      for (size_t tileset = 0; tileset < m_tilesets.size(); ++tileset)
+      {
+        layer_memory.vertex_bytes += m_layers[layer * m_tilesets.size() + tileset].getVertexCount() * sizeof(sf::Vertex);
+      }
+      layer_memory.tile_bytes = vector_bytes(m_layer_data[layer].data);
+      layer_memory.cell_bytes = cells * sizeof(uint16_t);
+      memory.layers.push_back(layer_memory);
+    }
+
+    memory.tileset_bytes = vector_bytes(m_tilesets) + vector_bytes(m_tile_tilesets);
+    for (const auto &tileset : m_tilesets)
+    {
+      memory.tileset_bytes += tileset.memory_bytes();
+    }
+
+    memory.property_bytes = vector_bytes(m_property_sets) + vector_bytes(m_tile_property_sets)
+      + map_node_bytes(m_script_defaults) + map_node_bytes(m_tile_properties);
+    for (const auto &tile : m_tile_properties)
+    {
+      memory.property_bytes += map_node_bytes(tile.second);
+      for (const auto &property : tile.second)
+      {
+        memory.property_bytes += string_bytes(property.first) + string_bytes(property.second);
+      }
+    }
+
+    memory.passability_bytes = m_tile_passability.memory_bytes();
+    if (m_pathfinder) {
+      memory.passability_bytes += m_pathfinder->memory_bytes();
+    }
+
+    memory.object_bytes = vector_bytes(m_objects) + m_object_bounds.memory_bytes() + vector_bytes(m_object_hits);
+    for (const auto &obj : m_objects)
+    {
+      memory.object_bytes += obj.memory_bytes();
+      memory.object_tileset_bytes += obj.tileset_memory_bytes();
+    }
+
+    if (m_chunk_index)
+    {
+      memory.chunk_bytes = m_chunk_index->memory_bytes() + map_node_bytes(m_resident_chunks)
+        + vector_bytes(m_streamed_objects) + map_node_bytes(m_chunk_objects)
+        + vector_bytes(m_attached_objects) + map_node_bytes(m_detached_behaviors);
+
+      for (const auto &chunk : m_resident_chunks)
+      {
+        memory.chunk_bytes += sizeof(Chunk_Index::Tiles) + vector_bytes(*chunk.second);
+        for (const auto &layer : *chunk.second)
+        {
+          memory.chunk_bytes += vector_bytes(layer);
+        }
+      }
+
+      for (const auto &obj : m_streamed_objects)
+      {
+        memory.chunk_bytes += string_bytes(obj.name) + map_node_bytes(obj.properties);
+      }
+
+      for (const auto &chunk : m_chunk_objects)
+      {
+        memory.chunk_bytes += vector_bytes(chunk.second);
+      }
     }
+
+    return memory;
+  }
+
+  void Tile_Map::capture_objects(std::vector<sf::Sprite> &t_sprites) const
+  {
+    t_sprites.clear();
+    for (const auto &obj : m_objects)
+    {
+      t_sprites.push_back(obj);
+    }
+  }
+
+
+  void Tile_Map::save_objects(std::vector<Saved_Object> &t_objects) const
+  {
+    t_objects.clear();
+    t_objects.reserve(m_objects.size());
+
+    // saved in the world, the window may be elsewhere when they are restored
+    const auto offset = world_offset();
+    for (const auto &obj : m_objects)
+    {
+      t_objects.emplace_back(obj.name(), obj.getPosition() + offset);
+    }
+  }
+
+  void Tile_Map::restore_objects(const std::vector<Saved_Object> &t_objects)
+  {
+    // the map file may have changed since the save, so match up objects by name, in order.
+    // Objects of a streamed map that aren't in the window start over from the file when they come back.
+    std::vector<bool> restored(m_objects.size(), false);
+    const auto offset = world_offset();
+
+    for (const auto &saved : t_objects)
+    {
+      for (size_t i = 0; i < m_objects.size(); ++i)
+      {
+        if (!restored[i] && m_objects[i].name() == saved.name)
+        {
+          m_objects[i].set_position(saved.position.x - offset.x, saved.position.y - offset.y);
+          restored[i] = true;
+          break;
+        }
+      }
+    }
+
+    m_pathfinder.reset();
+  }
+
+  const Passability_Grid &Tile_Map::tile_passability() const
+  {
+    return m_tile_passability;
+  }
+
+  Passability_Grid Tile_Map::passability() const
+  {
+    auto grid = tile_passability();
+
+    // objects block every tile they overlap, as in test_move
+    for (const auto &object : m_objects)
+    {
+      if (object.motion().is_mobile()) {
+        continue;
+      }
+
+      const auto tiles = tiles_within(object.getGlobalBounds());
+      for (int y = tiles.top; y < tiles.top + tiles.height; ++y)
+      {
+        for (int x = tiles.left; x < tiles.left + tiles.width; ++x)
+        {
+          grid.set_passable(x, y, false);
+        }
+      }
+    }
+
+    return grid;
+  }
+
+  const Pathfinder &Tile_Map::pathfinder() const
+  {
+    if (!m_pathfinder) {
+      m_pathfinder = std::make_shared<const Pathfinder>(passability());
+    }
+    return *m_pathfinder;
+  }
+
+  void Tile_Map::invalidate_paths()
+  {
+    m_pathfinder.reset();
+  }
+
+  std::vector<Object> &Tile_Map::objects()
+  {
+    return m_objects;
+  }
+
+  const std::vector<Object> &Tile_Map::objects() const
+  {
+    return m_objects;
   }
 
+  Object &Tile_Map::find_object(const std::string &t_obj_name)
+  {
+    const auto obj = std::find_if(m_objects.begin(), m_objects.end(), [&](const Object &t_obj) { return t_obj.name() == t_obj_name; });
+    if (obj == m_objects.end()) throw std::logic_error("Attempt to move non-existent object: " + t_obj_name);
+    return *obj;
+  }
+
+  void Tile_Map::make_mobile(Object &t_obj, const float t_speed)
+  {
+    if (!t_obj.motion().is_mobile()) {
+      // it no longer blocks paths
+      m_pathfinder.reset();
+    }
+    t_obj.motion().speed = t_speed;
+  }
+
+  bool Tile_Map::plan_route(Object &t_obj, const sf::Vector2i &t_tile) const
+  {
+    auto &motion = t_obj.motion();
+    const auto bounds = t_obj.getGlobalBounds();
+    const auto path = find_path(tile_at(sf::Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2)), t_tile);
+
+    motion.route.clear();
+    motion.next_waypoint = 0;
+    motion.blocked_time = 0;
+
+    // center the object on each tile, the first one being the tile it is on already
+    for (size_t i = 1; i < path.size(); ++i)
+    {
+      motion.route.push_back(sf::Vector2f(
+            path[i].x * float(m_tile_size.x) + (m_tile_size.x - bounds.width) / 2,
+            path[i].y * float(m_tile_size.y) + (m_tile_size.y - bounds.height) / 2));
+    }
+
+    return !path.empty();
+  }
+
+  void Tile_Map::set_velocity(const std::string &t_obj_name, const float t_x, const float t_y)
+  {
+    auto &obj = find_object(t_obj_name);
+    if (!obj.motion().is_mobile()) {
+      m_pathfinder.reset();
+    }
+    obj.motion().velocity = sf::Vector2f(t_x, t_y);
+  }
+
+  bool Tile_Map::walk_to(const std::string &t_obj_name, const int t_x, const int t_y, const float t_speed)
+  {
+    auto &obj = find_object(t_obj_name);
+    make_mobile(obj, t_speed);
+    return plan_route(obj, sf::Vector2i(t_x, t_y));
+  }
+
+  void Tile_Map::set_wander(const std::string &t_obj_name, const float t_speed, const int t_radius)
+  {
+    auto &obj = find_object(t_obj_name);
+    make_mobile(obj, t_speed);
+
+    const auto bounds = obj.getGlobalBounds();
+    obj.motion().wander_radius = t_radius;
+    obj.motion().wander_origin = tile_at(sf::Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2));
+  }
+
+  void Tile_Map::stop(const std::string &t_obj_name)
+  {
+    auto &obj = find_object(t_obj_name);
+    obj.motion() = Motion();
+
+    // it blocks paths again
+    m_pathfinder.reset();
+  }
+
+  sf::Vector2i Tile_Map::tile_at(const sf::Vector2f &t_position) const
+  {
+    return sf::Vector2i(int(std::floor(t_position.x / m_tile_size.x)), int(std::floor(t_position.y / m_tile_size.y)));
+  }
+
+  std::vector<sf::Vector2i> Tile_Map::find_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    return pathfinder().find_path(t_from, t_to);
+  }
+
+  bool Tile_Map::is_reachable(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    return pathfinder().reachable(t_from, t_to);
+  }
+
+  uint32_t Tile_Map::region_at(const sf::Vector2i &t_tile) const
+  {
+    return pathfinder().region(t_tile);
+  }
 
   sf::Vector2u Tile_Map::tile_size() const
   {
@@ -680,7 +1835,7 @@ namespace spiced {
   }
 
 
-  Tileset::Tileset(std::reference_wrapper<const sf::Texture> t_texture, const int t_first_gid,
+  Tileset::Tileset(Texture_Handle t_texture, const int t_first_gid,
     const int t_tile_width, const int t_tile_height, std::map<int, Animation> t_anim)
     : texture(std::move(t_texture)), first_gid(t_first_gid), tile_width(t_tile_width), tile_height(t_tile_height),
     anim(std::move(t_anim))
@@ -692,8 +1847,18 @@ namespace spiced {
     return first_gid;
   }
 
+  size_t Tileset::memory_bytes() const
+  {
+    auto bytes = map_node_bytes(anim);
+    for (const auto &frames : anim)
+    {
+      bytes += vector_bytes(frames.second);
+    }
+    return bytes;
+  }
+
   int Tileset::max_gid() const {
-    return first_gid + (texture.get().getSize().x / tile_width) * (texture.get().getSize().y / tile_height) - 1;
+    return first_gid + (texture->getSize().x / tile_width) * (texture->getSize().y / tile_height) - 1;
   }
 
   sf::IntRect Tileset::get_rect(const int gid, const float t_game_time) const
@@ -738,37 +1903,40 @@ namespace spiced {
 
   sf::Vector2i Tileset::location(const int gid) const
   {
-    const auto num_horz_tiles = texture.get().getSize().x / tile_width;
+    const auto num_horz_tiles = texture->getSize().x / tile_width;
     const auto id = gid - first_gid;
 
     return sf::Vector2i(id % num_horz_tiles, id / num_horz_tiles);
   }
 
   sf::VertexArray Tileset::vertices(const int gid, const int i, const int j) const
+  {
+    sf::VertexArray verts(sf::Quads, 4);
+    write_quad(&verts[0], gid, i, j);
+    return verts;
+  }
+
+  void Tileset::write_quad(sf::Vertex *t_quad, const int gid, const int i, const int j) const
   {
     const auto loc = location(gid);
 
     const auto tu = loc.x;
     const auto tv = loc.y;
 
-    sf::VertexArray verts(sf::Quads);
-
-    verts.append(sf::Vertex(
+    t_quad[0] = sf::Vertex(
       sf::Vector2f(float(i * tile_width), float(j * tile_height)),
-      sf::Vector2f(float(tu * tile_width), float(tv * tile_height))));
+      sf::Vector2f(float(tu * tile_width), float(tv * tile_height)));
 
-    verts.append(sf::Vertex(
+    t_quad[1] = sf::Vertex(
       sf::Vector2f(float((i + 1) * tile_width), float(j * tile_height)),
-      sf::Vector2f(float((tu + 1) * tile_width), float(tv * tile_height))));
+      sf::Vector2f(float((tu + 1) * tile_width), float(tv * tile_height)));
 
-    verts.append(sf::Vertex(
+    t_quad[2] = sf::Vertex(
       sf::Vector2f(float((i + 1) * tile_width), float((j + 1) * tile_height)),
-      sf::Vector2f(float((tu + 1) * tile_width), float((tv + 1) * tile_height))));
+      sf::Vector2f(float((tu + 1) * tile_width), float((tv + 1) * tile_height)));
 
-    verts.append(sf::Vertex(
+    t_quad[3] = sf::Vertex(
       sf::Vector2f(float(i * tile_width), float((j + 1) * tile_height)),
-      sf::Vector2f(float(tu * tile_width), float((tv + 1) * tile_height))));
-
-    return verts;
+      sf::Vector2f(float(tu * tile_width), float((tv + 1) * tile_height)));
   }
 }
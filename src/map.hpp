@@ -1,14 +1,25 @@
 #ifndef GAME_ENGINE_MAP_HPP
 #define GAME_ENGINE_MAP_HPP
 
+#include "aabb_batch.hpp"
+#include "map_file.hpp"
+#include "pathfinding.hpp"
+#include "resource_handle.hpp"
+
 #include <SFML/Graphics.hpp>
+#include <cstdint>
 #include <functional>
+#include <map>
+#include <memory>
+#include <utility>
 
 namespace spiced
 {
   class Game;
+  class Job_System;
   class Object;
   class Game_State;
+  struct Saved_Object;
 
   struct Frame
   {
@@ -26,7 +37,7 @@ namespace spiced
   struct Tileset
   {
 
-    Tileset(std::reference_wrapper<const sf::Texture> t_texture, const int t_first_gid, const int t_tile_width, const int t_tile_height,
+    Tileset(Texture_Handle t_texture, const int t_first_gid, const int t_tile_width, const int t_tile_height,
       std::map<int, Animation> t_anim);
 
     int min_gid() const;
@@ -36,7 +47,13 @@ namespace spiced
     sf::Vector2i location(const int gid) const;
     sf::VertexArray vertices(const int gid, const int i, const int j) const;
 
-    std::reference_wrapper<const sf::Texture> texture;
+    /// Writes the 4 vertices of tile gid placed at column i, row j
+    void write_quad(sf::Vertex *t_quad, const int gid, const int i, const int j) const;
+
+    /// Heap bytes of the animations, the texture is shared and not counted
+    size_t memory_bytes() const;
+
+    Texture_Handle texture;
     int first_gid;
     int tile_width;
     int tile_height;
@@ -66,6 +83,45 @@ namespace spiced
     std::function<void(const Game_State &, Object &)> action;
   };
 
+  /// Native movement state of an object, advanced by the Movement_System
+  struct Motion
+  {
+    /// Pixels per second, used while there is no route to follow
+    sf::Vector2f velocity;
+
+    /// Positions to walk through at speed pixels per second
+    std::vector<sf::Vector2f> route;
+    size_t next_waypoint = 0;
+    float speed = 0;
+
+    /// Picks a new random route within this many tiles of wander_origin whenever idle, 0 disables wandering
+    int wander_radius = 0;
+    sf::Vector2i wander_origin;
+
+    float idle_time = 0;
+    float blocked_time = 0;
+
+    bool has_route() const
+    {
+      return next_waypoint < route.size();
+    }
+
+    /// Mobile objects are ignored when building paths, they would invalidate them constantly
+    bool is_mobile() const
+    {
+      return velocity != sf::Vector2f(0, 0) || speed > 0;
+    }
+  };
+
+  /// What scripts attached to an object, kept by name while the object is not on its map
+  struct Object_Behavior
+  {
+    std::string portrait;
+    std::function<void(const Game_State &, Object &, sf::Sprite &)> collision_action;
+    std::function<std::vector<Object_Action>(const Game_State &, Object &)> action_generator;
+    Motion motion;
+  };
+
   class Object : public sf::Sprite
   {
   public:
@@ -81,6 +137,9 @@ namespace spiced
 
     void set_position(const float x, const float y);
 
+    /// Changes whenever set_position places any object, so that cached object bounds can tell they are stale
+    static uint64_t placement_generation();
+
     std::vector<Object_Action> get_actions(const Game_State &t_state);
 
     void do_collision(const Game_State &t_state, sf::Sprite &t_collided_with);
@@ -88,10 +147,27 @@ namespace spiced
     void set_collision_action(std::function<void(const Game_State &t_state, Object &, sf::Sprite &)> t_collision_action);
     void set_action_generator(std::function<std::vector<Object_Action>(const Game_State &t_state, Object &)> t_action_generator);
 
-    std::string name() const;
+    const std::string &name() const;
+
+    /// Takes over the script assigned behavior of t_previous, used when an object is reloaded from its map file
+    void inherit_behavior(const Object &t_previous);
+
+    Object_Behavior behavior() const;
+
+    /// Attaches script behavior to an object that starts over from its position in the file
+    void set_behavior(const Object_Behavior &t_behavior);
 
     void set_portrait(const std::string &t_portrait);
-    std::string get_portrait() const;
+    const std::string &get_portrait() const;
+
+    /// Heap bytes of the name, portrait path and route, not counting the copy of the tileset
+    size_t memory_bytes() const;
+
+    /// Heap bytes of this object's copy of its tileset's animations
+    size_t tileset_memory_bytes() const;
+
+    Motion &motion();
+    const Motion &motion() const;
 
   private:
     std::string m_name;
@@ -101,6 +177,7 @@ namespace spiced
     bool m_visible;
     std::function<void(const Game_State &, Object &, sf::Sprite &)> m_collision_action;
     std::function<std::vector<Object_Action>(const Game_State &, Object &)> m_action_generator;
+    Motion m_motion;
   };
 
 
@@ -161,24 +238,98 @@ namespace spiced
     bool valid;
   };
 
-  struct Tile_Data
+  /// Bytes held by one tile layer of a Tile_Map
+  struct Layer_Memory
+  {
+    /// Quads of the layer's tiles, over all tilesets
+    size_t vertex_bytes = 0;
+
+    /// Tile ids as read from the map file
+    size_t tile_bytes = 0;
+
+    /// Property set index of every cell
+    size_t cell_bytes = 0;
+
+    size_t total() const
+    {
+      return vertex_bytes + tile_bytes + cell_bytes;
+    }
+  };
+
+  /// Approximate memory held by a Tile_Map. Textures are shared between maps and
+  /// reported by Resource_Manager::usage() instead, script callbacks are not counted.
+  struct Map_Memory
   {
-    Tile_Data(int t_x, int t_y, Tile_Properties t_props, sf::FloatRect t_bounds);
+    std::vector<Layer_Memory> layers;
+
+    /// Tilesets with their animations, and the index from tile id to tileset
+    size_t tileset_bytes = 0;
+
+    /// Distinct tile property sets, the index from tile id to set, and the map file's raw tile properties
+    size_t property_bytes = 0;
+
+    /// Combined tile passability, plus the pathfinder if it is built
+    size_t passability_bytes = 0;
+
+    /// Objects with their names, routes and collision bounds
+    size_t object_bytes = 0;
+
+    /// The copy of its tileset every object keeps, animations included
+    size_t object_tileset_bytes = 0;
 
-    int x;
-    int y;
-    Tile_Properties properties;
-    sf::FloatRect bounds;
+    /// For streamed maps: the chunk index, the decoded chunks kept in and around the window,
+    /// and the objects of the whole world waiting for their chunk
+    size_t chunk_bytes = 0;
+
+    size_t layer_bytes() const
+    {
+      size_t bytes = 0;
+      for (const auto &layer : layers)
+      {
+        bytes += layer.total();
+      }
+      return bytes;
+    }
+
+    size_t total() const
+    {
+      return layer_bytes() + tileset_bytes + property_bytes + passability_bytes + object_bytes + object_tileset_bytes + chunk_bytes;
+    }
   };
 
+  /// Compiles the collision_action scripts of tile properties. Copies share a cache of the compiled
+  /// callbacks keyed by their source, so a snippet used by many tiles and maps is compiled once.
+  /// The cache is not invalidated, collision_action_parser must be set before the first map loads.
   struct Script_Parser
   {
-    std::function<std::function<void (const Game_State &, sf::Sprite &)> (const std::string &)> collision_action_parser;
+    typedef std::function<void (const Game_State &, sf::Sprite &)> Collision_Action;
+
+    Script_Parser();
+
+    /// The callback compiled from t_source, only calls collision_action_parser the first time t_source is seen
+    Collision_Action collision_action(const std::string &t_source) const;
+
+    /// Distinct sources compiled so far
+    size_t compiled_collision_actions() const;
+
+    std::function<Collision_Action (const std::string &)> collision_action_parser;
+
+  private:
+    std::shared_ptr<std::map<std::string, Collision_Action>> m_collision_actions;
   };
 
+  /// The tiles and objects of a map made with Tiled.
+  ///
+  /// Maps read from an infinite TMX file are streamed: only a window of chunks around the avatar is
+  /// loaded, everything else stays on disk. The window's contents are moved back by world_offset(),
+  /// so positions and tiles on the map are relative to the window's top left corner. It starts out
+  /// at the world's origin, and each time it moves the Game moves the avatar along with it.
   class Tile_Map : public sf::Drawable, public sf::Transformable
   {
   public:
+    /// Chunks loaded on each side of the avatar's chunk by default
+    static const int default_stream_radius = 2;
+
     struct Layer
     {
       Layer(std::vector<int> t_data, const bool t_visible)
@@ -186,6 +337,11 @@ namespace spiced
       {
       }
 
+      bool operator==(const Layer &t_rhs) const
+      {
+        return visible == t_rhs.visible && data == t_rhs.data;
+      }
+
       std::vector<int> data;
       bool visible;
     };
@@ -193,7 +349,18 @@ namespace spiced
     Tile_Map(Game &t_game, const std::string &t_file_path, std::vector<Tile_Defaults> t_map_defaults,
         const Script_Parser &t_parser);
 
-    virtual ~Tile_Map() = default;
+    /// Waits for a window that is still loading
+    virtual ~Tile_Map();
+
+    /// Re-reads the map file. If only tile layer contents changed, just those layers are rebuilt.
+    /// Objects from the file are replaced but keep the behavior scripts attached to them by name,
+    /// objects added by script are kept as they are.
+    void reload(Game &t_game);
+
+    const std::string &file_path() const;
+
+    /// Incremented on every reload, lets cached renderings of the map detect that they are stale
+    uint64_t revision() const;
 
     void add_enter_action(const std::function<void(Game &)> t_action);
 
@@ -201,7 +368,37 @@ namespace spiced
 
     sf::Vector2u dimensions_in_pixels() const;
 
-    void load(sf::Vector2u t_tile_size, const std::vector<Layer> &layers, const unsigned int width, const unsigned int height);
+    bool is_streamed() const;
+
+    /// Position of the map's top left corner in the world, in pixels. 0 unless the map is streamed.
+    sf::Vector2f world_offset() const;
+
+    /// Chunks kept loaded on each side of the avatar's chunk, applied the next time the window moves
+    void set_stream_radius(const int t_radius);
+
+    /// Called with the coordinates of every chunk that enters the window of a streamed map
+    void add_chunk_load_action(std::function<void(Game &, const int, const int)> t_action);
+
+    /// Called with the coordinates of every chunk that leaves the window of a streamed map
+    void add_chunk_unload_action(std::function<void(Game &, const int, const int)> t_action);
+
+    /// Starts loading the window centered on the chunk at t_position on t_jobs, unless the window is there already.
+    /// Reading, decoding, meshing and the collision grid all happen on a worker. Does nothing while a window is
+    /// still loading or if the map isn't streamed.
+    void stream_around(Job_System &t_jobs, const sf::Vector2f &t_position);
+
+    /// True once the window started by stream_around can be attached
+    bool window_ready() const;
+
+    /// Replaces the map's contents with the loaded window. Objects whose chunk left are detached, their script
+    /// behavior kept by name until they come back, objects whose chunk entered are attached. Everything else
+    /// on the map and t_avatar move by the window's shift, then the chunk actions run.
+    /// A window that failed to load is logged and dropped, the map keeps the current one and
+    /// stream_around starts over. The renderer must not be drawing the map meanwhile.
+    void attach_window(Game &t_game, sf::Sprite &t_avatar);
+
+    /// Builds the tile meshes, spread over t_jobs for big maps
+    void load(Job_System &t_jobs, sf::Vector2u t_tile_size, const std::vector<Layer> &layers, const unsigned int width, const unsigned int height);
 
     void add_object(const Object &t_o);
 
@@ -213,6 +410,16 @@ namespace spiced
 
     void set_portrait(const std::string &t_obj_name, const std::string &t_portrait_path);
 
+    /// Declares that the player can get from this map to the map added to the game as t_map_name,
+    /// so that its resources are loaded ahead of time. Tiled objects declare the same with an "exit" property.
+    void add_exit(const std::string &t_map_name);
+
+    /// Names of the maps reachable from this one, declared by the map file or by script
+    std::vector<std::string> exits() const;
+
+    /// Portrait paths of every object on the map, each listed once
+    std::vector<std::string> portraits() const;
+
 
     static sf::FloatRect get_bounding_box(const sf::Sprite &t_s, const sf::Vector2f &t_distance);
 
@@ -220,6 +427,11 @@ namespace spiced
 
     std::vector<std::reference_wrapper<Object>> get_collisions(const sf::Sprite &t_s, const sf::Vector2f &t_distance);
 
+    /// The first object get_collisions would return, without building the list. nullptr if there is none.
+    Object *first_collision(const sf::Sprite &t_s, const sf::Vector2f &t_distance);
+
+    /// How far t_s gets when moving by distance: stops at the first contact along the way
+    /// and slides along the blocking surface with the rest of the move
     sf::Vector2f adjust_move(const sf::Sprite &t_s, const sf::Vector2f &distance) const;
 
     void do_move(const Game_State &t_game, sf::Sprite &t_s, const sf::Vector2f &distance);
@@ -228,6 +440,63 @@ namespace spiced
 
     sf::Vector2u tile_size() const;
 
+    /// Draws the static tile layers only, without applying this map's transform
+    void draw_layers(sf::RenderTarget& target, sf::RenderStates states) const;
+
+    /// Draws tile layers t_first_layer up to, not including, t_end_layer
+    void draw_layers(sf::RenderTarget& target, sf::RenderStates states, const size_t t_first_layer, const size_t t_end_layer) const;
+
+    size_t layer_count() const;
+
+    /// True if the layer uses a tile that has an animation
+    bool layer_is_animated(const size_t t_layer) const;
+
+    Map_Memory memory_usage() const;
+
+    /// Replaces the contents of t_sprites with the current state of every object on the map
+    void capture_objects(std::vector<sf::Sprite> &t_sprites) const;
+
+    void save_objects(std::vector<Saved_Object> &t_objects) const;
+    void restore_objects(const std::vector<Saved_Object> &t_objects);
+
+    /// Impassable tiles of all layers combined
+    const Passability_Grid &tile_passability() const;
+
+    /// Impassable tiles and the tiles covered by objects that do not move
+    Passability_Grid passability() const;
+
+    /// Built on first use, and again after the map or its objects changed
+    const Pathfinder &pathfinder() const;
+
+    /// Call after moving objects, so that routes take their new positions into account
+    void invalidate_paths();
+
+    sf::Vector2i tile_at(const sf::Vector2f &t_position) const;
+
+    /// Tile by tile route between two tiles, empty if there is none
+    std::vector<sf::Vector2i> find_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    bool is_reachable(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    /// Connected region of a tile, 0 if the tile is impassable. Tiles with the same region reach each other.
+    uint32_t region_at(const sf::Vector2i &t_tile) const;
+
+    std::vector<Object> &objects();
+    const std::vector<Object> &objects() const;
+
+    /// Replaces t_obj's route with a path to t_tile, returns false if there is none
+    bool plan_route(Object &t_obj, const sf::Vector2i &t_tile) const;
+
+    /// Moves the object at a constant velocity in pixels per second, until stopped or blocked
+    void set_velocity(const std::string &t_obj_name, const float t_x, const float t_y);
+
+    /// Routes the object to a tile, returns false if the tile can't be reached
+    bool walk_to(const std::string &t_obj_name, const int t_x, const int t_y, const float t_speed);
+
+    /// Lets the object walk to random tiles within t_radius tiles of where it is now
+    void set_wander(const std::string &t_obj_name, const float t_speed, const int t_radius);
+
+    void stop(const std::string &t_obj_name);
 
   private:
 
@@ -235,14 +504,124 @@ namespace spiced
 
     static std::map<int, Tile_Properties> to_map(std::vector<Tile_Defaults> &&t_vec);
 
+    /// Meshes, cells and passability of a set of tile layers, built without modifying the map
+    struct Layer_Build
+    {
+      std::vector<sf::VertexArray> vertices;
+      std::vector<uint16_t> cells;
+      std::vector<bool> animated;
+      Passability_Grid passability = Passability_Grid(0, 0);
+    };
+
+    /// A window of a streamed map being loaded by a worker
+    struct Window_Build;
+
+    void load_file(Game &t_game, const bool t_incremental);
+    void build_property_sets(std::map<int, Tile_Properties> t_defaults);
+    /// Index of the tileset each tile id belongs to
+    void index_tilesets();
+
+    /// Only reads the tilesets and property sets, a worker may build while the map is in use
+    Layer_Build build_layers(Job_System &t_jobs, const std::vector<Layer> &t_layers, const sf::Vector2u &t_size) const;
+    void use_layers(Layer_Build t_build);
+
+    /// Fills one vertex array per tileset and the layer's cells, returns true if the layer uses an animated tile.
+    /// Only reads shared state, so different layers can be built concurrently.
+    bool build_layer(const Layer &t_layer, const sf::Vector2u &t_size, sf::VertexArray *t_vertices, uint16_t *t_cells) const;
+    void rebuild_layer(const size_t t_layer, const Layer &t_data);
+    Passability_Grid build_tile_passability(const std::vector<uint16_t> &t_cells, const size_t t_layers, const sf::Vector2u &t_size) const;
+
+    /// Queues the load of the window with t_first_chunk at its top left corner
+    void start_window(Job_System &t_jobs, const sf::Vector2i &t_first_chunk);
+
+    /// Waits for the window being loaded and throws it away
+    void cancel_window();
+
+    /// Waits for the window being loaded and takes it, rethrows the error if it failed to load
+    std::shared_ptr<Window_Build> finish_window();
+
+    /// Swaps in a loaded window, see attach_window. Returns how far the map's contents moved.
+    sf::Vector2f swap_window(Window_Build &t_build, std::vector<sf::Vector2i> &t_loaded, std::vector<sf::Vector2i> &t_unloaded);
+
+    /// Chunk of the world containing t_position, which is a position on the map
+    sf::Vector2i chunk_at(const sf::Vector2f &t_position) const;
+
+    /// Top left tile of the window in the world
+    sf::Vector2i window_origin() const;
+
+    /// Remembers the object's behavior until it is attached again
+    void detach_object(const Object &t_obj);
+
+    /// Behavior waiting for the streamed object t_obj_name to be attached, nullptr if the map has no such object
+    Object_Behavior *detached_behavior(const std::string &t_obj_name);
+
+    /// Tiles overlapping t_bounds, clipped to the map
+    sf::IntRect tiles_within(const sf::FloatRect &t_bounds) const;
+
+    /// Global bounds of m_objects, gathered again once objects were added or placed since the last call.
+    /// Not thread safe, for use by the collision queries of the main thread.
+    const Aabb_Batch &object_bounds() const;
+
+    void replace_file_objects(std::vector<Object> t_objects);
+    Object &find_object(const std::string &t_obj_name);
+    void make_mobile(Object &t_obj, const float t_speed);
+
+    std::string m_file_path;
+    std::map<int, Tile_Properties> m_script_defaults;
+    Script_Parser m_script_parser;
+    std::map<int, std::map<std::string, std::string>> m_tile_properties;
+    std::vector<Layer> m_layer_data;
+    std::vector<bool> m_animated_layers;
+    size_t m_file_objects = 0;
+    uint64_t m_revision = 0;
+    std::vector<std::string> m_file_exits;
+    std::vector<std::string> m_script_exits;
+
+    /// Shared between copies of the map, replaced rather than modified when the map changes
+    mutable std::shared_ptr<const Pathfinder> m_pathfinder;
+
+    /// Each distinct set of tile properties is stored once, cells refer to it by index.
+    /// Set 0 is the default, used by empty cells and by tiles without properties.
+    std::vector<Tile_Properties> m_property_sets;
+    std::vector<uint16_t> m_tile_property_sets;
+
+    /// Property set of every cell, layer after layer, row by row
+    std::vector<uint16_t> m_cell_property_sets;
+    Passability_Grid m_tile_passability = Passability_Grid(0, 0);
+
     std::vector<sf::VertexArray> m_layers;
     std::vector<Tileset> m_tilesets;
-    std::vector<Tile_Data> m_tile_data;
-    std::map<int, Tile_Properties> m_map_defaults;
+    std::vector<uint16_t> m_tile_tilesets;
     std::vector<Object> m_objects;
+    mutable Aabb_Batch m_object_bounds;
+    mutable uint64_t m_object_bounds_generation = 0;
+    mutable std::vector<uint64_t> m_object_hits;
     std::vector<std::function<void(Game &)>> m_enter_actions;
     sf::Vector2u m_map_size;
     sf::Vector2u m_tile_size;
+
+    /// Where the chunks of a streamed map are on disk, null for maps loaded as a whole
+    std::shared_ptr<const Chunk_Index> m_chunk_index;
+    int m_stream_radius = default_stream_radius;
+
+    /// Top left chunk of the window and its edge length in chunks, 0 before the first window is attached
+    sf::Vector2i m_window_chunk;
+    int m_window_span = 0;
+    std::shared_ptr<Window_Build> m_window_build;
+
+    /// Decoded chunks with tiles, in the window and one chunk around it. Immutable, shared with the worker.
+    std::map<std::pair<int, int>, std::shared_ptr<const Chunk_Index::Tiles>> m_resident_chunks;
+
+    /// Every object of a streamed map with its position in the world, indexed by chunk
+    std::vector<Map_File::Object> m_streamed_objects;
+    std::map<std::pair<int, int>, std::vector<size_t>> m_chunk_objects;
+
+    /// Streamed object each of the m_file_objects objects was made from
+    std::vector<size_t> m_attached_objects;
+    std::map<std::string, Object_Behavior> m_detached_behaviors;
+
+    std::vector<std::function<void(Game &, const int, const int)>> m_chunk_load_actions;
+    std::vector<std::function<void(Game &, const int, const int)>> m_chunk_unload_actions;
   };
 }
 
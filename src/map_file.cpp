@@ -0,0 +1,148 @@
+#include "map_file.hpp"
+#include "SimpleJSON/json.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace spiced {
+  namespace {
+    Map_File::Properties read_properties(const json::JSON &t_owner)
+    {
+      Map_File::Properties properties;
+      if (t_owner.hasKey("properties")) {
+        for (const auto &property : t_owner.at("properties").ObjectRange()) {
+          properties.emplace(property.first, property.second.ToString());
+        }
+      }
+      return properties;
+    }
+
+    bool ends_with(const std::string &t_string, const std::string &t_suffix)
+    {
+      return t_string.size() >= t_suffix.size()
+        && t_string.compare(t_string.size() - t_suffix.size(), t_suffix.size(), t_suffix) == 0;
+    }
+  }
+
+  std::string parent_path(const std::string &t_path)
+  {
+    const auto slash = t_path.rfind('/');
+
+    if (slash == std::string::npos) {
+      return std::string();
+    } else {
+      return t_path.substr(0, slash + 1);
+    }
+  }
+
+  Map_File read_map_file(Job_System &t_jobs, const std::string &t_file_path)
+  {
+    if (ends_with(t_file_path, ".tmx")) {
+      return read_tmx_map(t_jobs, t_file_path);
+    } else {
+      return read_json_map(t_file_path);
+    }
+  }
+
+  Map_File read_json_map(const std::string &t_file_path)
+  {
+    std::ifstream ifs(t_file_path);
+    if (!ifs) {
+      throw std::runtime_error("Unable to open map file: '" + t_file_path + "'");
+    }
+
+    std::stringstream buff;
+    buff << ifs.rdbuf();
+    const auto json = json::JSON::Load(buff.str());
+
+    if (json.hasKey("infinite") && json.at("infinite").ToBool()) {
+      throw std::runtime_error("Infinite maps can only be streamed from TMX files: '" + t_file_path + "'");
+    }
+
+    Map_File map;
+    map.tile_size = sf::Vector2u(json.at("tilewidth").ToInt(), json.at("tileheight").ToInt());
+    map.width = json.at("width").ToInt();
+    map.height = json.at("height").ToInt();
+
+    const auto directory = parent_path(t_file_path);
+
+    for (const auto &tileset_json : json.at("tilesets").ArrayRange())
+    {
+      Map_File::Tileset tileset;
+      tileset.first_gid = tileset_json.at("firstgid").ToInt();
+      tileset.image = directory + tileset_json.at("image").ToString();
+      tileset.tile_width = tileset_json.at("tilewidth").ToInt();
+      tileset.tile_height = tileset_json.at("tileheight").ToInt();
+
+      if (tileset_json.hasKey("tileproperties")) {
+        for (const auto &tile : tileset_json.at("tileproperties").ObjectRange()) {
+          auto &properties = tileset.tile_properties[std::stoi(tile.first)];
+          for (const auto &property : tile.second.ObjectRange()) {
+            properties.emplace(property.first, property.second.ToString());
+          }
+        }
+      }
+
+      if (tileset_json.hasKey("tiles")) {
+        for (const auto &tile : tileset_json.at("tiles").ObjectRange()) {
+          if (tile.second.hasKey("animation")) {
+            auto &animation = tileset.animations[std::stoi(tile.first)];
+            for (const auto &frame : tile.second.at("animation").ArrayRange()) {
+              animation.push_back(Map_File::Frame{int(frame.at("tileid").ToInt()), int(frame.at("duration").ToInt())});
+            }
+          }
+        }
+      }
+
+      map.tilesets.push_back(std::move(tileset));
+    }
+
+    for (const auto &layer : json.at("layers").ArrayRange())
+    {
+      const auto type = layer.at("type").ToString();
+
+      if (type == "tilelayer")
+      {
+        Map_File::Layer tile_layer;
+        tile_layer.name = layer.hasKey("name") ? layer.at("name").ToString() : std::string();
+        tile_layer.visible = layer.at("visible").ToBool();
+        tile_layer.properties = read_properties(layer);
+
+        const auto &data = layer.at("data");
+        tile_layer.data.reserve(size_t(data.length()));
+        for (const auto &val : data.ArrayRange()) {
+          tile_layer.data.push_back(int(val.ToInt()));
+        }
+
+        map.layers.push_back(std::move(tile_layer));
+      }
+      else if (type == "objectgroup")
+      {
+        for (const auto &obj : layer.at("objects").ArrayRange())
+        {
+          const auto get_float = [&obj](const std::string &t_name) {
+            const auto &v = obj.at(t_name);
+            if (v.JSONType() == json::JSON::Class::Floating) {
+              return float(v.ToFloat());
+            } else {
+              return float(v.ToInt());
+            }
+          };
+
+          Map_File::Object object;
+          object.name = obj.at("name").ToString();
+          object.gid = int(obj.at("gid").ToInt());
+          object.visible = obj.at("visible").ToBool();
+          object.x = get_float("x");
+          object.y = get_float("y");
+          object.properties = read_properties(obj);
+          map.objects.push_back(std::move(object));
+        }
+      }
+    }
+
+    return map;
+  }
+}
+
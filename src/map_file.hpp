@@ -0,0 +1,148 @@
+#ifndef GAME_ENGINE_MAP_FILE_HPP
+#define GAME_ENGINE_MAP_FILE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spiced
+{
+  class Job_System;
+
+  /// Where the tile data of an infinite TMX map's chunks is in its file. Only this index stays in
+  /// memory, chunks are read back from disk and decoded when they are needed.
+  ///
+  /// Immutable once built, so any number of threads may read chunks from it at the same time.
+  class Chunk_Index
+  {
+  public:
+    /// gids of every tile layer within one chunk, row by row
+    typedef std::vector<std::vector<int>> Tiles;
+
+    struct Layer_Format
+    {
+      /// "csv" or "base64"
+      std::string encoding;
+
+      /// Empty if the data isn't compressed
+      std::string compression;
+    };
+
+    Chunk_Index(std::string t_file_path, const sf::Vector2u &t_chunk_size, std::vector<Layer_Format> t_layers);
+
+    /// Records where layer t_layer of chunk t_chunk, in chunk coordinates, is found in the file
+    void add(const sf::Vector2i &t_chunk, const size_t t_layer, const uint64_t t_offset, const uint32_t t_length);
+
+    /// Tiles per chunk
+    sf::Vector2u chunk_size() const;
+
+    size_t layer_count() const;
+
+    /// False if no layer has tiles in t_chunk
+    bool contains(const sf::Vector2i &t_chunk) const;
+
+    /// Reads and decodes one chunk, layers without data there are all 0.
+    /// Throws std::runtime_error if the file can't be read or doesn't match the index anymore.
+    Tiles read(const sf::Vector2i &t_chunk) const;
+
+    /// Heap bytes held by the index
+    size_t memory_bytes() const;
+
+  private:
+    struct Span
+    {
+      uint64_t offset = 0;
+
+      /// 0 where the layer has no data
+      uint32_t length = 0;
+    };
+
+    static uint64_t key(const sf::Vector2i &t_chunk);
+
+    std::string m_file_path;
+    sf::Vector2u m_chunk_size;
+    std::vector<Layer_Format> m_layers;
+
+    /// First span of each chunk, followed by the spans of the other layers
+    std::unordered_map<uint64_t, size_t> m_chunks;
+    std::vector<Span> m_spans;
+  };
+
+  /// A map made with Tiled, as read from disk and before any of it becomes engine state.
+  /// Both the JSON export and the native TMX format read into this.
+  struct Map_File
+  {
+    typedef std::map<std::string, std::string> Properties;
+
+    struct Frame
+    {
+      int tile_id;
+      int duration;
+    };
+
+    struct Tileset
+    {
+      int first_gid;
+
+      /// Relative to the working directory, not to the map
+      std::string image;
+      int tile_width;
+      int tile_height;
+
+      /// By tile id local to the tileset
+      std::map<int, Properties> tile_properties;
+      std::map<int, std::vector<Frame>> animations;
+    };
+
+    struct Layer
+    {
+      std::string name;
+      bool visible;
+      Properties properties;
+
+      /// width * height gids, row by row
+      std::vector<int> data;
+    };
+
+    struct Object
+    {
+      std::string name;
+      int gid;
+      bool visible;
+      float x;
+      float y;
+      Properties properties;
+    };
+
+    sf::Vector2u tile_size;
+    unsigned int width;
+    unsigned int height;
+
+    /// Set for infinite maps instead of reading their tile data, which leaves the layers' data empty
+    /// and width and height meaningless. Objects may be anywhere, at negative positions too.
+    std::shared_ptr<const Chunk_Index> chunks;
+
+    std::vector<Tileset> tilesets;
+    std::vector<Layer> layers;
+    std::vector<Object> objects;
+  };
+
+  /// Reads a .tmx map natively, anything else as Tiled's JSON export.
+  /// TMX tile layers may be CSV, base64, base64 + zlib / gzip (when built with zlib) or
+  /// base64 + zstd (when built with zstd), and are decoded in parallel on t_jobs.
+  /// Infinite TMX maps, which must use CSV or base64, are only indexed, see Map_File::chunks.
+  /// Throws std::runtime_error on files that can't be read.
+  Map_File read_map_file(Job_System &t_jobs, const std::string &t_file_path);
+
+  Map_File read_json_map(const std::string &t_file_path);
+  Map_File read_tmx_map(Job_System &t_jobs, const std::string &t_file_path);
+
+  /// Directory part of t_path including the trailing '/', empty if there is none
+  std::string parent_path(const std::string &t_path);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include "mini_map.hpp"
+#include "map.hpp"
+#include "render_snapshot.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace spiced {
+  const unsigned int Mini_Map::max_texture_size;
+
+  void Mini_Map::bake(const Tile_Map &t_map, const uint64_t t_revision, const sf::Vector2f &t_dimensions)
+  {
+    const auto max_size = float(std::min(max_texture_size, sf::Texture::getMaximumSize()));
+    const auto scale = std::min(1.0f, max_size / std::max(t_dimensions.x, t_dimensions.y));
+    const auto width = std::max(1u, static_cast<unsigned int>(std::ceil(t_dimensions.x * scale)));
+    const auto height = std::max(1u, static_cast<unsigned int>(std::ceil(t_dimensions.y * scale)));
+
+    if (!m_texture.create(width, height))
+    {
+      throw std::runtime_error("Unable to create mini map texture");
+    }
+    m_texture.setSmooth(true);
+
+    m_texture.setView(sf::View(sf::FloatRect(sf::Vector2f(0, 0), t_dimensions)));
+    m_texture.clear();
+
+    sf::RenderStates states;
+    states.transform *= t_map.getTransform();
+    t_map.draw_layers(m_texture, states);
+    m_texture.display();
+
+    // stretch the baked texture back over the map's own coordinate space
+    m_sprite = sf::Sprite(m_texture.getTexture());
+    m_sprite.setScale(t_dimensions.x / width, t_dimensions.y / height);
+
+    m_map = &t_map;
+    m_revision = t_revision;
+  }
+
+  void Mini_Map::invalidate()
+  {
+    m_map = nullptr;
+  }
+
+  void Mini_Map::draw(sf::RenderTarget &t_target, const Render_Snapshot &t_snapshot)
+  {
+    if (!t_snapshot.map) {
+      return;
+    }
+
+    const auto dimensions = sf::Vector2f(t_snapshot.map_dimensions);
+
+    if (m_map != t_snapshot.map || m_revision != t_snapshot.map_revision)
+    {
+      bake(*t_snapshot.map, t_snapshot.map_revision, dimensions);
+    }
+
+    const auto window_size = t_target.getSize();
+    sf::View miniView(sf::FloatRect(sf::Vector2f(0,0), dimensions));
+    miniView.setViewport(sf::FloatRect(0.75f, 0, 0.25f, (.25f * window_size.x) * (dimensions.y / dimensions.x) / window_size.y ));
+    t_target.setView(miniView);
+
+    t_target.draw(m_sprite);
+
+    auto map_states = sf::RenderStates();
+    map_states.transform *= t_snapshot.map->getTransform();
+    for (const auto &obj : t_snapshot.objects)
+    {
+      t_target.draw(obj, map_states);
+    }
+
+    t_target.draw(t_snapshot.avatar);
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef GAME_ENGINE_MINI_MAP_HPP
+#define GAME_ENGINE_MINI_MAP_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+
+namespace spiced
+{
+  class Tile_Map;
+  struct Render_Snapshot;
+
+  /// Mini map overlay. The static tile layers of the current map are baked into a texture
+  /// the first time the map is shown, after that each frame costs one textured quad plus
+  /// the dynamic content (objects and avatar). Reloading the map from disk triggers a rebake.
+  ///
+  /// Owned by the render thread, which is the only thread allowed to touch its GL resources.
+  class Mini_Map
+  {
+  public:
+    /// Largest edge of the baked texture in pixels, the overlay only covers a quarter of the window
+    static const unsigned int max_texture_size = 512;
+
+    void draw(sf::RenderTarget &t_target, const Render_Snapshot &t_snapshot);
+
+    /// Forces a rebake on the next draw, needed when the maps were replaced and a new map may reuse an old address
+    void invalidate();
+
+  private:
+    void bake(const Tile_Map &t_map, const uint64_t t_revision, const sf::Vector2f &t_dimensions);
+
+    const Tile_Map *m_map = nullptr;
+    uint64_t m_revision = 0;
+    sf::RenderTexture m_texture;
+    sf::Sprite m_sprite;
+  };
+}
+
+#endif
+
@@ -0,0 +1,315 @@
+#include "movement.hpp"
+#include "collision.hpp"
+#include "job_system.hpp"
+#include "map.hpp"
+#include "pathfinding.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace spiced {
+  const size_t Movement_System::min_parallel_movers;
+  const int Movement_System::max_routes_per_update;
+  const int Movement_System::region_tiles;
+  const int Movement_System::bucket_tiles;
+
+  namespace {
+    sf::Vector2f center(const sf::FloatRect &t_rect)
+    {
+      return sf::Vector2f(t_rect.left + t_rect.width / 2, t_rect.top + t_rect.height / 2);
+    }
+
+    float length(const sf::Vector2f &t_v)
+    {
+      return std::sqrt(t_v.x * t_v.x + t_v.y * t_v.y);
+    }
+  }
+
+  Movement_System::Movement_System(Job_System &t_jobs)
+    : m_jobs(t_jobs)
+  {
+  }
+
+  size_t Movement_System::memory_bytes() const
+  {
+    return m_movers.capacity() * sizeof(Mover)
+      + m_chunks.capacity() * sizeof(std::pair<size_t, size_t>)
+      + (m_start_bounds.capacity() + m_bounds.capacity()) * sizeof(sf::FloatRect)
+      + (m_bucket_start.capacity() + m_bucket_objects.capacity()) * sizeof(uint32_t);
+  }
+
+  void Movement_System::update(Tile_Map &t_map, const sf::FloatRect &t_avatar_bounds, const float t_time)
+  {
+    if (t_time <= 0) {
+      return;
+    }
+
+    plan(t_map, t_time);
+
+    if (m_movers.empty()) {
+      return;
+    }
+
+    build_buckets(t_map);
+
+    // group the movers by region so each task works on one neighbourhood of the map
+    std::sort(m_movers.begin(), m_movers.end(),
+        [](const Mover &t_lhs, const Mover &t_rhs) {
+          return t_lhs.region < t_rhs.region || (t_lhs.region == t_rhs.region && t_lhs.object < t_rhs.object);
+        });
+
+    m_chunks.clear();
+    if (m_movers.size() < min_parallel_movers || m_jobs.worker_count() == 0)
+    {
+      m_chunks.emplace_back(0, m_movers.size());
+    }
+    else {
+      const auto target_size = std::max<size_t>(1, m_movers.size() / ((m_jobs.worker_count() + 1) * 4));
+      size_t begin = 0;
+      while (begin < m_movers.size())
+      {
+        // chunks end on region boundaries
+        auto end = std::min(begin + target_size, m_movers.size());
+        while (end < m_movers.size() && m_movers[end].region == m_movers[end - 1].region) {
+          ++end;
+        }
+        m_chunks.emplace_back(begin, end);
+        begin = end;
+      }
+    }
+
+    const auto &map = t_map;
+    m_jobs.parallel_for(m_chunks.size(), 1, [&](const size_t t_begin, const size_t t_end) {
+          for (auto chunk = t_begin; chunk < t_end; ++chunk)
+          {
+            for (auto i = m_chunks[chunk].first; i < m_chunks[chunk].second; ++i)
+            {
+              resolve(map, m_movers[i], t_avatar_bounds);
+            }
+          }
+        });
+
+    // object order, not region order, is what makes the outcome reproducible
+    std::sort(m_movers.begin(), m_movers.end(),
+        [](const Mover &t_lhs, const Mover &t_rhs) { return t_lhs.object < t_rhs.object; });
+
+    apply(t_map, t_time);
+  }
+
+  void Movement_System::plan(Tile_Map &t_map, const float t_time)
+  {
+    m_movers.clear();
+
+    auto &objects = t_map.objects();
+    const auto tile_size = sf::Vector2f(t_map.tile_size());
+    const auto regions_x = int(std::ceil(t_map.dimensions_in_pixels().x / (tile_size.x * region_tiles)));
+    int routes_left = max_routes_per_update;
+
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+      auto &obj = objects[i];
+      auto &motion = obj.motion();
+
+      if (!motion.is_mobile()) {
+        continue;
+      }
+
+      if (!motion.has_route() && motion.wander_radius > 0)
+      {
+        if (motion.idle_time > 0) {
+          motion.idle_time -= t_time;
+        } else if (routes_left > 0) {
+          --routes_left;
+
+          std::uniform_int_distribution<int> offset(-motion.wander_radius, motion.wander_radius);
+          const auto target = motion.wander_origin + sf::Vector2i(offset(m_random), offset(m_random));
+          if (!t_map.plan_route(obj, target)) {
+            // try again a little later rather than spending the frame on it
+            motion.idle_time = 0.5f;
+          }
+        }
+      }
+
+      sf::Vector2f step;
+      if (motion.has_route())
+      {
+        const auto to_waypoint = motion.route[motion.next_waypoint] - obj.getPosition();
+        const auto distance = length(to_waypoint);
+        const auto max_distance = motion.speed * t_time;
+        step = distance <= max_distance ? to_waypoint : to_waypoint * (max_distance / distance);
+      }
+      else {
+        step = motion.velocity * t_time;
+      }
+
+      if (step == sf::Vector2f(0, 0)) {
+        continue;
+      }
+
+      const auto position = center(obj.getGlobalBounds());
+      const auto region = std::max(0, int(position.y / (tile_size.y * region_tiles))) * regions_x
+                        + std::max(0, int(position.x / (tile_size.x * region_tiles)));
+
+      m_movers.push_back(Mover{uint32_t(i), uint32_t(region), step, sf::Vector2f()});
+    }
+  }
+
+  void Movement_System::build_buckets(const Tile_Map &t_map)
+  {
+    const auto &objects = t_map.objects();
+    const auto dimensions = sf::Vector2f(t_map.dimensions_in_pixels());
+
+    m_bucket_size = sf::Vector2f(t_map.tile_size()) * float(bucket_tiles);
+    m_buckets_x = std::max(1, int(std::ceil(dimensions.x / m_bucket_size.x)));
+    m_buckets_y = std::max(1, int(std::ceil(dimensions.y / m_bucket_size.y)));
+
+    m_start_bounds.clear();
+    for (const auto &obj : objects)
+    {
+      m_start_bounds.push_back(obj.getGlobalBounds());
+    }
+    m_bounds = m_start_bounds;
+
+    // counting sort of the objects into every bucket they overlap
+    m_bucket_start.assign(size_t(m_buckets_x * m_buckets_y) + 1, 0);
+
+    const auto bucket_range = [this](const sf::FloatRect &t_box, int &t_x0, int &t_y0, int &t_x1, int &t_y1) {
+      t_x0 = std::max(0, std::min(m_buckets_x - 1, int(std::floor(t_box.left / m_bucket_size.x))));
+      t_y0 = std::max(0, std::min(m_buckets_y - 1, int(std::floor(t_box.top / m_bucket_size.y))));
+      t_x1 = std::max(0, std::min(m_buckets_x - 1, int(std::floor((t_box.left + t_box.width) / m_bucket_size.x))));
+      t_y1 = std::max(0, std::min(m_buckets_y - 1, int(std::floor((t_box.top + t_box.height) / m_bucket_size.y))));
+    };
+
+    int x0, y0, x1, y1;
+    for (const auto &box : m_start_bounds)
+    {
+      bucket_range(box, x0, y0, x1, y1);
+      for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+          ++m_bucket_start[size_t(y * m_buckets_x + x) + 1];
+        }
+      }
+    }
+
+    for (size_t i = 1; i < m_bucket_start.size(); ++i)
+    {
+      m_bucket_start[i] += m_bucket_start[i - 1];
+    }
+
+    m_bucket_objects.resize(m_bucket_start.back());
+    std::vector<uint32_t> fill(m_bucket_start.begin(), m_bucket_start.end() - 1);
+
+    for (size_t i = 0; i < m_start_bounds.size(); ++i)
+    {
+      bucket_range(m_start_bounds[i], x0, y0, x1, y1);
+      for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+          m_bucket_objects[fill[size_t(y * m_buckets_x + x)]++] = uint32_t(i);
+        }
+      }
+    }
+  }
+
+  template<typename Visitor>
+  void Movement_System::for_each_nearby(const sf::FloatRect &t_box, Visitor &&t_visitor) const
+  {
+    // objects are bucketed by their start position and move less than a bucket per frame,
+    // so looking one bucket further out covers where they are now
+    const auto x0 = std::max(0, int(std::floor(t_box.left / m_bucket_size.x)) - 1);
+    const auto y0 = std::max(0, int(std::floor(t_box.top / m_bucket_size.y)) - 1);
+    const auto x1 = std::min(m_buckets_x - 1, int(std::floor((t_box.left + t_box.width) / m_bucket_size.x)) + 1);
+    const auto y1 = std::min(m_buckets_y - 1, int(std::floor((t_box.top + t_box.height) / m_bucket_size.y)) + 1);
+
+    for (int y = y0; y <= y1; ++y)
+    {
+      for (int x = x0; x <= x1; ++x)
+      {
+        const auto bucket = size_t(y * m_buckets_x + x);
+        for (auto i = m_bucket_start[bucket]; i < m_bucket_start[bucket + 1]; ++i)
+        {
+          if (!t_visitor(m_bucket_objects[i])) {
+            return;
+          }
+        }
+      }
+    }
+  }
+
+  void Movement_System::resolve(const Tile_Map &t_map, Mover &t_mover, const sf::FloatRect &t_avatar_bounds) const
+  {
+    const auto &tiles = t_map.tile_passability();
+    const auto tile_size = t_map.tile_size();
+    const auto &obj = t_map.objects()[t_mover.object];
+
+    t_mover.resolved = slide_move(Tile_Map::get_bounding_box(obj, sf::Vector2f(0, 0)), t_mover.step,
+        [&](const sf::FloatRect &t_box, const sf::Vector2f &t_distance, Sweep_Hit &t_hit) {
+          // unlike the avatar, objects never leave the map
+          sweep_tiles(tiles, tile_size, t_box, t_distance, true, t_hit);
+          sweep_box(t_box, t_distance, t_avatar_bounds, t_hit);
+
+          for_each_nearby(swept_bounds(t_box, t_distance), [&](const uint32_t t_other) {
+                if (t_other != t_mover.object) {
+                  sweep_box(t_box, t_distance, m_start_bounds[t_other], t_hit);
+                }
+                return true;
+              });
+        });
+  }
+
+  void Movement_System::apply(Tile_Map &t_map, const float t_time)
+  {
+    auto &objects = t_map.objects();
+
+    for (auto &mover : m_movers)
+    {
+      auto &obj = objects[mover.object];
+      auto &motion = obj.motion();
+
+      if (mover.resolved != sf::Vector2f(0, 0))
+      {
+        const auto box = Tile_Map::get_bounding_box(obj, mover.resolved);
+
+        // another object may have moved into the same space earlier in this frame
+        for_each_nearby(box, [&](const uint32_t t_other) {
+              if (t_other != mover.object && m_bounds[t_other].intersects(box)) {
+                mover.resolved = sf::Vector2f(0, 0);
+              }
+              return mover.resolved != sf::Vector2f(0, 0);
+            });
+      }
+
+      if (mover.resolved == sf::Vector2f(0, 0))
+      {
+        motion.blocked_time += t_time;
+
+        // give up on a route that stays blocked, wandering objects will pick another one
+        if (motion.has_route() && motion.blocked_time > 1.0f)
+        {
+          motion.route.clear();
+          motion.next_waypoint = 0;
+          motion.idle_time = 1.0f;
+        }
+        continue;
+      }
+
+      motion.blocked_time = 0;
+      const auto position = obj.getPosition() + mover.resolved;
+      obj.set_position(position.x, position.y);
+      m_bounds[mover.object] = obj.getGlobalBounds();
+
+      if (motion.has_route() && length(motion.route[motion.next_waypoint] - obj.getPosition()) < 0.01f)
+      {
+        obj.set_position(motion.route[motion.next_waypoint].x, motion.route[motion.next_waypoint].y);
+
+        if (++motion.next_waypoint == motion.route.size())
+        {
+          motion.route.clear();
+          motion.next_waypoint = 0;
+
+          std::uniform_real_distribution<float> pause(1.0f, 4.0f);
+          motion.idle_time = pause(m_random);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef GAME_ENGINE_MOVEMENT_HPP
+#define GAME_ENGINE_MOVEMENT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace spiced
+{
+  class Job_System;
+  class Tile_Map;
+
+  /// Moves every mobile Object of a map under the same collision rules as the avatar:
+  /// a move stops at its first contact and slides along the surface it hit.
+  ///
+  /// Each update runs in three phases:
+  ///  - plan, serial: route following and wandering decide each object's desired step
+  ///  - resolve, parallel: objects are grouped by map region and the groups are spread over
+  ///    the job system's workers, each step is swept against the tiles and the start-of-frame
+  ///    positions of all objects and the avatar
+  ///  - apply, serial: steps are applied in object order, a step that would overlap an object
+  ///    already moved this frame is dropped, so the outcome never depends on thread timing
+  ///
+  /// Tile movement actions are not run for objects, those belong to the avatar.
+  class Movement_System
+  {
+  public:
+    /// Below this many moving objects the resolve phase runs on the calling thread
+    static const size_t min_parallel_movers = 64;
+
+    /// Bounds the pathfinding done per frame for wandering objects
+    static const int max_routes_per_update = 16;
+
+    /// Edge length in tiles of the regions objects are grouped by
+    static const int region_tiles = 8;
+
+    /// Edge length in tiles of the buckets used to find nearby objects
+    static const int bucket_tiles = 4;
+
+    explicit Movement_System(Job_System &t_jobs);
+    Movement_System(const Movement_System &) = delete;
+    Movement_System &operator=(const Movement_System &) = delete;
+
+    void update(Tile_Map &t_map, const sf::FloatRect &t_avatar_bounds, const float t_time);
+
+    /// Heap bytes of the per frame buffers, which keep their capacity between frames
+    size_t memory_bytes() const;
+
+  private:
+    struct Mover
+    {
+      uint32_t object;
+      uint32_t region;
+      sf::Vector2f step;
+      sf::Vector2f resolved;
+    };
+
+    void plan(Tile_Map &t_map, const float t_time);
+    void build_buckets(const Tile_Map &t_map);
+    void resolve(const Tile_Map &t_map, Mover &t_mover, const sf::FloatRect &t_avatar_bounds) const;
+    void apply(Tile_Map &t_map, const float t_time);
+
+    template<typename Visitor>
+    void for_each_nearby(const sf::FloatRect &t_box, Visitor &&t_visitor) const;
+
+    Job_System &m_jobs;
+    std::minstd_rand m_random;
+
+    std::vector<Mover> m_movers;
+    std::vector<std::pair<size_t, size_t>> m_chunks;
+
+    /// global bounds of every object, at the start of the frame and as moved so far
+    std::vector<sf::FloatRect> m_start_bounds;
+    std::vector<sf::FloatRect> m_bounds;
+
+    /// objects per bucket: m_bucket_objects[m_bucket_start[b] .. m_bucket_start[b + 1])
+    sf::Vector2f m_bucket_size;
+    int m_buckets_x = 0;
+    int m_buckets_y = 0;
+    std::vector<uint32_t> m_bucket_start;
+    std::vector<uint32_t> m_bucket_objects;
+  };
+}
+
+#endif
+
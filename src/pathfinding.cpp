@@ -0,0 +1,782 @@
+#include "pathfinding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+namespace spiced {
+  const int Pathfinder::default_cluster_size;
+  const int Pathfinder::max_single_entrance_width;
+
+  namespace {
+    const float diagonal_cost = 1.41421356f;
+
+    float octile_distance(const sf::Vector2i &t_from, const sf::Vector2i &t_to)
+    {
+      const auto dx = float(std::abs(t_to.x - t_from.x));
+      const auto dy = float(std::abs(t_to.y - t_from.y));
+      return dx + dy + (diagonal_cost - 2) * std::min(dx, dy);
+    }
+
+    int sign(const int t_value)
+    {
+      return (t_value > 0) - (t_value < 0);
+    }
+
+    /// Per thread A* state. Entries are only valid if their stamp matches the current
+    /// generation, so starting a search costs nothing no matter how large the grid is.
+    struct Search_Scratch
+    {
+      std::vector<float> cost;
+      std::vector<int> parent;
+      std::vector<uint32_t> seen;
+      std::vector<uint32_t> closed;
+      uint32_t generation = 0;
+
+      typedef std::pair<float, int> Open_Entry;
+      std::priority_queue<Open_Entry, std::vector<Open_Entry>, std::greater<Open_Entry>> open;
+
+      void begin(const size_t t_cells)
+      {
+        if (t_cells > cost.size())
+        {
+          cost.resize(t_cells);
+          parent.resize(t_cells);
+          seen.resize(t_cells, 0);
+          closed.resize(t_cells, 0);
+        }
+
+        if (++generation == 0)
+        {
+          std::fill(seen.begin(), seen.end(), 0);
+          std::fill(closed.begin(), closed.end(), 0);
+          generation = 1;
+        }
+
+        open = decltype(open)();
+      }
+
+      bool is_seen(const int t_cell) const { return seen[size_t(t_cell)] == generation; }
+      bool is_closed(const int t_cell) const { return closed[size_t(t_cell)] == generation; }
+
+      void visit(const int t_cell, const int t_parent, const float t_cost, const float t_estimate)
+      {
+        if (is_closed(t_cell) || (is_seen(t_cell) && cost[size_t(t_cell)] <= t_cost)) {
+          return;
+        }
+
+        seen[size_t(t_cell)] = generation;
+        cost[size_t(t_cell)] = t_cost;
+        parent[size_t(t_cell)] = t_parent;
+        open.push(Open_Entry(t_cost + t_estimate, t_cell));
+      }
+    };
+
+    thread_local Search_Scratch scratch;
+
+    /// Records a successor of the cell being expanded
+    class Search_Visitor
+    {
+    public:
+      Search_Visitor(const int t_width, const int t_current, const sf::Vector2i &t_current_cell, const sf::Vector2i &t_goal)
+        : m_width(t_width), m_current(t_current), m_current_cell(t_current_cell), m_goal(t_goal)
+      {
+      }
+
+      void operator()(const sf::Vector2i &t_next) const
+      {
+        scratch.visit(t_next.y * m_width + t_next.x, m_current,
+            scratch.cost[size_t(m_current)] + octile_distance(m_current_cell, t_next), octile_distance(t_next, m_goal));
+      }
+
+    private:
+      int m_width;
+      int m_current;
+      sf::Vector2i m_current_cell;
+      sf::Vector2i m_goal;
+    };
+
+    /// Generic A* over grid cells. t_successors(cell, parent, visitor) calls visitor(next_cell) for each successor.
+    /// Returns the cells from the start to the goal, as found by the successor function.
+    template<typename Successors>
+    std::vector<sf::Vector2i> grid_search(const Passability_Grid &t_grid, const sf::Vector2i &t_from, const sf::Vector2i &t_to,
+        Successors &&t_successors)
+    {
+      const auto width = int(t_grid.width());
+      const auto index = [width](const sf::Vector2i &t_cell) { return t_cell.y * width + t_cell.x; };
+      const auto cell = [width](const int t_index) { return sf::Vector2i(t_index % width, t_index / width); };
+
+      scratch.begin(size_t(t_grid.width()) * t_grid.height());
+
+      const auto goal = index(t_to);
+      scratch.visit(index(t_from), -1, 0, octile_distance(t_from, t_to));
+
+      while (!scratch.open.empty())
+      {
+        const auto current = scratch.open.top().second;
+        scratch.open.pop();
+
+        if (scratch.is_closed(current)) {
+          continue;
+        }
+        scratch.closed[size_t(current)] = scratch.generation;
+
+        if (current == goal)
+        {
+          std::vector<sf::Vector2i> path;
+          for (auto i = current; i != -1; i = scratch.parent[size_t(i)])
+          {
+            path.push_back(cell(i));
+          }
+          std::reverse(path.begin(), path.end());
+          return path;
+        }
+
+        const auto current_cell = cell(current);
+        const auto parent = scratch.parent[size_t(current)];
+
+        t_successors(current_cell, parent == -1 ? current_cell : cell(parent), Search_Visitor(width, current, current_cell, t_to));
+      }
+
+      return std::vector<sf::Vector2i>();
+    }
+
+    float path_cost(const std::vector<sf::Vector2i> &t_path)
+    {
+      float cost = 0;
+      for (size_t i = 1; i < t_path.size(); ++i)
+      {
+        cost += octile_distance(t_path[i - 1], t_path[i]);
+      }
+      return cost;
+    }
+
+    /// Appends the straight line of cells after the last cell of t_path up to t_to
+    void append_line(std::vector<sf::Vector2i> &t_path, const sf::Vector2i &t_to)
+    {
+      auto current = t_path.back();
+      const sf::Vector2i step(sign(t_to.x - current.x), sign(t_to.y - current.y));
+      while (current != t_to)
+      {
+        current += step;
+        t_path.push_back(current);
+      }
+    }
+
+    bool can_step(const Passability_Grid &t_grid, const sf::Vector2i &t_from, const int dx, const int dy)
+    {
+      if (!t_grid.passable(t_from.x + dx, t_from.y + dy)) {
+        return false;
+      }
+      return dx == 0 || dy == 0 || (t_grid.passable(t_from.x + dx, t_from.y) && t_grid.passable(t_from.x, t_from.y + dy));
+    }
+
+    /// Jump point search for grids that forbid corner cutting: diagonal jumps are
+    /// resolved by the orthogonal jumps branching off them.
+    class Jumper
+    {
+    public:
+      Jumper(const Passability_Grid &t_grid, const sf::Vector2i &t_goal)
+        : m_grid(t_grid), m_goal(t_goal)
+      {
+      }
+
+      bool jump(sf::Vector2i t_cell, const int dx, const int dy, sf::Vector2i &t_result) const
+      {
+        for (;;)
+        {
+          if (!m_grid.passable(t_cell.x, t_cell.y)) {
+            return false;
+          }
+
+          if (t_cell == m_goal) {
+            t_result = t_cell;
+            return true;
+          }
+
+          if (dx != 0 && dy != 0)
+          {
+            sf::Vector2i ignored;
+            if (jump(sf::Vector2i(t_cell.x + dx, t_cell.y), dx, 0, ignored) || jump(sf::Vector2i(t_cell.x, t_cell.y + dy), 0, dy, ignored))
+            {
+              t_result = t_cell;
+              return true;
+            }
+          }
+          else if (dx != 0)
+          {
+            if ((m_grid.passable(t_cell.x, t_cell.y - 1) && !m_grid.passable(t_cell.x - dx, t_cell.y - 1))
+                || (m_grid.passable(t_cell.x, t_cell.y + 1) && !m_grid.passable(t_cell.x - dx, t_cell.y + 1)))
+            {
+              t_result = t_cell;
+              return true;
+            }
+          }
+          else
+          {
+            if ((m_grid.passable(t_cell.x - 1, t_cell.y) && !m_grid.passable(t_cell.x - 1, t_cell.y - dy))
+                || (m_grid.passable(t_cell.x + 1, t_cell.y) && !m_grid.passable(t_cell.x + 1, t_cell.y - dy)))
+            {
+              t_result = t_cell;
+              return true;
+            }
+          }
+
+          if (!m_grid.passable(t_cell.x + dx, t_cell.y) || !m_grid.passable(t_cell.x, t_cell.y + dy)) {
+            return false;
+          }
+
+          t_cell += sf::Vector2i(dx, dy);
+        }
+      }
+
+      void successors(const sf::Vector2i &t_cell, const sf::Vector2i &t_parent, const Search_Visitor &t_add) const
+      {
+        const auto try_direction = [&](const int dx, const int dy) {
+          sf::Vector2i jump_point;
+          if (jump(t_cell + sf::Vector2i(dx, dy), dx, dy, jump_point)) {
+            t_add(jump_point);
+          }
+        };
+
+        const auto dx = sign(t_cell.x - t_parent.x);
+        const auto dy = sign(t_cell.y - t_parent.y);
+
+        if (dx == 0 && dy == 0)
+        {
+          // the start cell, every direction is open
+          for (int y = -1; y <= 1; ++y) {
+            for (int x = -1; x <= 1; ++x) {
+              if ((x != 0 || y != 0) && can_step(m_grid, t_cell, x, y)) {
+                try_direction(x, y);
+              }
+            }
+          }
+        }
+        else if (dx != 0 && dy != 0)
+        {
+          const auto vertical = m_grid.passable(t_cell.x, t_cell.y + dy);
+          const auto horizontal = m_grid.passable(t_cell.x + dx, t_cell.y);
+          if (vertical) try_direction(0, dy);
+          if (horizontal) try_direction(dx, 0);
+          if (vertical && horizontal) try_direction(dx, dy);
+        }
+        else if (dx != 0)
+        {
+          const auto next = m_grid.passable(t_cell.x + dx, t_cell.y);
+          const auto up = m_grid.passable(t_cell.x, t_cell.y - 1);
+          const auto down = m_grid.passable(t_cell.x, t_cell.y + 1);
+          if (next) {
+            try_direction(dx, 0);
+            if (up && m_grid.passable(t_cell.x + dx, t_cell.y - 1)) try_direction(dx, -1);
+            if (down && m_grid.passable(t_cell.x + dx, t_cell.y + 1)) try_direction(dx, 1);
+          }
+          if (up) try_direction(0, -1);
+          if (down) try_direction(0, 1);
+        }
+        else
+        {
+          const auto next = m_grid.passable(t_cell.x, t_cell.y + dy);
+          const auto left = m_grid.passable(t_cell.x - 1, t_cell.y);
+          const auto right = m_grid.passable(t_cell.x + 1, t_cell.y);
+          if (next) {
+            try_direction(0, dy);
+            if (left && m_grid.passable(t_cell.x - 1, t_cell.y + dy)) try_direction(-1, dy);
+            if (right && m_grid.passable(t_cell.x + 1, t_cell.y + dy)) try_direction(1, dy);
+          }
+          if (left) try_direction(-1, 0);
+          if (right) try_direction(1, 0);
+        }
+      }
+
+    private:
+      const Passability_Grid &m_grid;
+      sf::Vector2i m_goal;
+    };
+  }
+
+
+  Passability_Grid::Passability_Grid(const unsigned int t_width, const unsigned int t_height)
+    : m_width(t_width), m_height(t_height), m_bits((size_t(t_width) * t_height + 63) / 64, ~uint64_t(0))
+  {
+  }
+
+  unsigned int Passability_Grid::width() const
+  {
+    return m_width;
+  }
+
+  unsigned int Passability_Grid::height() const
+  {
+    return m_height;
+  }
+
+  bool Passability_Grid::in_bounds(const int x, const int y) const
+  {
+    return x >= 0 && y >= 0 && unsigned(x) < m_width && unsigned(y) < m_height;
+  }
+
+  bool Passability_Grid::passable(const int x, const int y) const
+  {
+    if (!in_bounds(x, y)) {
+      return false;
+    }
+    const auto cell = size_t(y) * m_width + size_t(x);
+    return (m_bits[cell >> 6] >> (cell & 63)) & 1;
+  }
+
+  void Passability_Grid::set_passable(const int x, const int y, const bool t_passable)
+  {
+    if (!in_bounds(x, y)) {
+      throw std::out_of_range("Cell outside of passability grid");
+    }
+    const auto cell = size_t(y) * m_width + size_t(x);
+    const auto bit = uint64_t(1) << (cell & 63);
+    if (t_passable) {
+      m_bits[cell >> 6] |= bit;
+    } else {
+      m_bits[cell >> 6] &= ~bit;
+    }
+  }
+
+
+  size_t Passability_Grid::memory_bytes() const
+  {
+    return m_bits.capacity() * sizeof(uint64_t);
+  }
+
+
+  Pathfinder::Pathfinder(Passability_Grid t_grid, const int t_cluster_size)
+    : m_grid(std::move(t_grid)),
+      m_cluster_size(t_cluster_size),
+      m_clusters_x((m_grid.width() + unsigned(t_cluster_size) - 1) / unsigned(t_cluster_size)),
+      m_clusters_y((m_grid.height() + unsigned(t_cluster_size) - 1) / unsigned(t_cluster_size)),
+      m_cluster_nodes(size_t(m_clusters_x) * m_clusters_y)
+  {
+    if (t_cluster_size < 2) {
+      throw std::invalid_argument("Pathfinder cluster size must be at least 2");
+    }
+
+    build_regions();
+    build_entrances();
+    build_cluster_paths();
+  }
+
+  const Passability_Grid &Pathfinder::grid() const
+  {
+    return m_grid;
+  }
+
+  size_t Pathfinder::abstract_node_count() const
+  {
+    return m_nodes.size();
+  }
+
+  size_t Pathfinder::memory_bytes() const
+  {
+    auto bytes = m_grid.memory_bytes() + m_regions.capacity() * sizeof(uint32_t);
+
+    bytes += m_nodes.capacity() * sizeof(Abstract_Node);
+    for (const auto &node : m_nodes)
+    {
+      bytes += node.edges.capacity() * sizeof(Abstract_Edge);
+    }
+
+    bytes += m_cluster_nodes.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto &nodes : m_cluster_nodes)
+    {
+      bytes += nodes.capacity() * sizeof(uint32_t);
+    }
+
+    bytes += m_paths.capacity() * sizeof(std::vector<sf::Vector2i>);
+    for (const auto &path : m_paths)
+    {
+      bytes += path.capacity() * sizeof(sf::Vector2i);
+    }
+
+    return bytes;
+  }
+
+  uint32_t Pathfinder::region(const sf::Vector2i &t_cell) const
+  {
+    if (!m_grid.passable(t_cell.x, t_cell.y)) {
+      return 0;
+    }
+    return m_regions[size_t(t_cell.y) * m_grid.width() + size_t(t_cell.x)];
+  }
+
+  bool Pathfinder::reachable(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    const auto from_region = region(t_from);
+    return from_region != 0 && from_region == region(t_to);
+  }
+
+  uint32_t Pathfinder::cluster_of(const sf::Vector2i &t_cell) const
+  {
+    return uint32_t(t_cell.y / m_cluster_size) * m_clusters_x + uint32_t(t_cell.x / m_cluster_size);
+  }
+
+  sf::IntRect Pathfinder::cluster_bounds(const uint32_t t_cluster) const
+  {
+    const auto left = int(t_cluster % m_clusters_x) * m_cluster_size;
+    const auto top = int(t_cluster / m_clusters_x) * m_cluster_size;
+    return sf::IntRect(left, top,
+        std::min(m_cluster_size, int(m_grid.width()) - left),
+        std::min(m_cluster_size, int(m_grid.height()) - top));
+  }
+
+  void Pathfinder::build_regions()
+  {
+    const auto width = int(m_grid.width());
+    const auto height = int(m_grid.height());
+    m_regions.assign(size_t(width) * size_t(height), 0);
+
+    // diagonal steps need both orthogonal neighbors open, so 4-way connectivity is exact
+    uint32_t next_region = 0;
+    std::deque<sf::Vector2i> pending;
+
+    for (int y = 0; y < height; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        if (!m_grid.passable(x, y) || m_regions[size_t(y * width + x)] != 0) {
+          continue;
+        }
+
+        ++next_region;
+        m_regions[size_t(y * width + x)] = next_region;
+        pending.push_back(sf::Vector2i(x, y));
+
+        while (!pending.empty())
+        {
+          const auto cell = pending.front();
+          pending.pop_front();
+
+          const sf::Vector2i neighbors[] = { {cell.x - 1, cell.y}, {cell.x + 1, cell.y}, {cell.x, cell.y - 1}, {cell.x, cell.y + 1} };
+          for (const auto &neighbor : neighbors)
+          {
+            if (m_grid.passable(neighbor.x, neighbor.y))
+            {
+              auto &region = m_regions[size_t(neighbor.y * width + neighbor.x)];
+              if (region == 0)
+              {
+                region = next_region;
+                pending.push_back(neighbor);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t Pathfinder::node_at(const sf::Vector2i &t_cell)
+  {
+    auto &cluster_nodes = m_cluster_nodes[cluster_of(t_cell)];
+    for (const auto node : cluster_nodes)
+    {
+      if (m_nodes[node].cell == t_cell) {
+        return node;
+      }
+    }
+
+    Abstract_Node node;
+    node.cell = t_cell;
+    node.cluster = cluster_of(t_cell);
+    m_nodes.push_back(node);
+    cluster_nodes.push_back(uint32_t(m_nodes.size() - 1));
+    return uint32_t(m_nodes.size() - 1);
+  }
+
+  void Pathfinder::add_entrance(const sf::Vector2i &t_inside, const sf::Vector2i &t_outside)
+  {
+    const auto inside = node_at(t_inside);
+    const auto outside = node_at(t_outside);
+
+    m_paths.push_back(std::vector<sf::Vector2i>{t_inside, t_outside});
+    const auto path = uint32_t(m_paths.size() - 1);
+
+    m_nodes[inside].edges.push_back(Abstract_Edge{outside, 1, path, false});
+    m_nodes[outside].edges.push_back(Abstract_Edge{inside, 1, path, true});
+  }
+
+  void Pathfinder::build_entrances()
+  {
+    // scans the border cells t_first + i * t_along (i < t_length); each is paired with the cell at t_across
+    const auto scan_border = [this](const sf::Vector2i &t_first, const sf::Vector2i &t_along, const sf::Vector2i &t_across, const int t_length) {
+      int run_start = -1;
+      for (int i = 0; i <= t_length; ++i)
+      {
+        const auto cell = t_first + t_along * i;
+        const auto open = i < t_length && m_grid.passable(cell.x, cell.y) && m_grid.passable(cell.x + t_across.x, cell.y + t_across.y);
+
+        if (open && run_start == -1) {
+          run_start = i;
+        } else if (!open && run_start != -1) {
+          const auto run_end = i - 1;
+          if (run_end - run_start + 1 > max_single_entrance_width) {
+            add_entrance(t_first + t_along * run_start, t_first + t_along * run_start + t_across);
+            add_entrance(t_first + t_along * run_end, t_first + t_along * run_end + t_across);
+          } else {
+            const auto middle = t_first + t_along * ((run_start + run_end) / 2);
+            add_entrance(middle, middle + t_across);
+          }
+          run_start = -1;
+        }
+      }
+    };
+
+    for (uint32_t cluster = 0; cluster < m_cluster_nodes.size(); ++cluster)
+    {
+      const auto bounds = cluster_bounds(cluster);
+      const auto right = bounds.left + bounds.width - 1;
+      const auto bottom = bounds.top + bounds.height - 1;
+
+      if (right + 1 < int(m_grid.width())) {
+        scan_border(sf::Vector2i(right, bounds.top), sf::Vector2i(0, 1), sf::Vector2i(1, 0), bounds.height);
+      }
+
+      if (bottom + 1 < int(m_grid.height())) {
+        scan_border(sf::Vector2i(bounds.left, bottom), sf::Vector2i(1, 0), sf::Vector2i(0, 1), bounds.width);
+      }
+    }
+  }
+
+  void Pathfinder::build_cluster_paths()
+  {
+    std::vector<sf::Vector2i> path;
+
+    for (uint32_t cluster = 0; cluster < m_cluster_nodes.size(); ++cluster)
+    {
+      const auto bounds = cluster_bounds(cluster);
+      const auto &nodes = m_cluster_nodes[cluster];
+
+      for (size_t i = 0; i < nodes.size(); ++i)
+      {
+        for (size_t j = i + 1; j < nodes.size(); ++j)
+        {
+          const auto from = nodes[i];
+          const auto to = nodes[j];
+
+          if (m_regions.empty() || region(m_nodes[from].cell) != region(m_nodes[to].cell)) {
+            continue;
+          }
+
+          const auto cost = bounded_search(m_nodes[from].cell, m_nodes[to].cell, bounds, path);
+          if (cost < 0) {
+            continue;
+          }
+
+          m_paths.push_back(path);
+          const auto path_index = uint32_t(m_paths.size() - 1);
+          m_nodes[from].edges.push_back(Abstract_Edge{to, cost, path_index, false});
+          m_nodes[to].edges.push_back(Abstract_Edge{from, cost, path_index, true});
+        }
+      }
+    }
+  }
+
+  float Pathfinder::bounded_search(const sf::Vector2i &t_from, const sf::Vector2i &t_to, const sf::IntRect &t_bounds,
+      std::vector<sf::Vector2i> &t_path) const
+  {
+    t_path = grid_search(m_grid, t_from, t_to,
+        [this, &t_bounds](const sf::Vector2i &t_cell, const sf::Vector2i &, const Search_Visitor &t_add) {
+          for (int dy = -1; dy <= 1; ++dy)
+          {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+              if ((dx != 0 || dy != 0) && t_bounds.contains(t_cell.x + dx, t_cell.y + dy) && can_step(m_grid, t_cell, dx, dy)) {
+                t_add(sf::Vector2i(t_cell.x + dx, t_cell.y + dy));
+              }
+            }
+          }
+        });
+
+    return t_path.empty() ? -1.0f : path_cost(t_path);
+  }
+
+  std::vector<sf::Vector2i> Pathfinder::find_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    if (!reachable(t_from, t_to)) {
+      return std::vector<sf::Vector2i>();
+    }
+
+    if (octile_distance(t_from, t_to) <= float(2 * m_cluster_size)) {
+      return find_local_path(t_from, t_to);
+    }
+
+    auto path = find_hierarchical_path(t_from, t_to);
+    if (path.empty()) {
+      path = find_local_path(t_from, t_to);
+    }
+    return path;
+  }
+
+  std::vector<sf::Vector2i> Pathfinder::find_local_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    if (!reachable(t_from, t_to)) {
+      return std::vector<sf::Vector2i>();
+    }
+
+    const Jumper jumper(m_grid, t_to);
+    const auto jump_points = grid_search(m_grid, t_from, t_to,
+        [&jumper](const sf::Vector2i &t_cell, const sf::Vector2i &t_parent, const Search_Visitor &t_add) {
+          jumper.successors(t_cell, t_parent, t_add);
+        });
+
+    if (jump_points.empty()) {
+      return jump_points;
+    }
+
+    // jump points are joined by straight lines
+    std::vector<sf::Vector2i> path(1, jump_points.front());
+    for (size_t i = 1; i < jump_points.size(); ++i)
+    {
+      append_line(path, jump_points[i]);
+    }
+    return path;
+  }
+
+  std::vector<sf::Vector2i> Pathfinder::find_hierarchical_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const
+  {
+    if (!reachable(t_from, t_to)) {
+      return std::vector<sf::Vector2i>();
+    }
+
+    const auto start_cluster = cluster_of(t_from);
+    const auto goal_cluster = cluster_of(t_to);
+
+    std::vector<sf::Vector2i> path;
+
+    if (start_cluster == goal_cluster
+        && bounded_search(t_from, t_to, cluster_bounds(start_cluster), path) >= 0)
+    {
+      return path;
+    }
+
+    // connect the start and goal cells to the entrances of their clusters
+    struct Link
+    {
+      uint32_t node;
+      float cost;
+      std::vector<sf::Vector2i> path;
+    };
+
+    const auto link = [this, &path](const sf::Vector2i &t_cell, const uint32_t t_cluster) {
+      std::vector<Link> links;
+      for (const auto node : m_cluster_nodes[t_cluster])
+      {
+        const auto cost = bounded_search(t_cell, m_nodes[node].cell, cluster_bounds(t_cluster), path);
+        if (cost >= 0) {
+          links.push_back(Link{node, cost, path});
+        }
+      }
+      return links;
+    };
+
+    const auto start_links = link(t_from, start_cluster);
+    const auto goal_links = link(t_to, goal_cluster);
+
+    // A* on the abstract graph, the start and goal get the two ids past the real nodes
+    const auto node_count = m_nodes.size();
+    const auto start = uint32_t(node_count);
+    const auto goal = uint32_t(node_count + 1);
+    const auto none = std::numeric_limits<uint32_t>::max();
+
+    const auto cell_of = [&](const uint32_t t_node) {
+      return t_node == start ? t_from : t_node == goal ? t_to : m_nodes[t_node].cell;
+    };
+
+    std::vector<float> cost(node_count + 2, std::numeric_limits<float>::infinity());
+    std::vector<uint32_t> parent(node_count + 2, none);
+    std::vector<const std::vector<sf::Vector2i> *> parent_path(node_count + 2, nullptr);
+    std::vector<bool> parent_reversed(node_count + 2, false);
+    std::vector<bool> closed(node_count + 2, false);
+
+    typedef std::pair<float, uint32_t> Open_Entry;
+    std::priority_queue<Open_Entry, std::vector<Open_Entry>, std::greater<Open_Entry>> open;
+
+    const auto relax = [&](const uint32_t t_from_node, const uint32_t t_to_node, const float t_cost,
+        const std::vector<sf::Vector2i> &t_path, const bool t_reversed) {
+      const auto new_cost = cost[t_from_node] + t_cost;
+      if (!closed[t_to_node] && new_cost < cost[t_to_node])
+      {
+        cost[t_to_node] = new_cost;
+        parent[t_to_node] = t_from_node;
+        parent_path[t_to_node] = &t_path;
+        parent_reversed[t_to_node] = t_reversed;
+        open.push(Open_Entry(new_cost + octile_distance(cell_of(t_to_node), t_to), t_to_node));
+      }
+    };
+
+    cost[start] = 0;
+    open.push(Open_Entry(octile_distance(t_from, t_to), start));
+
+    while (!open.empty())
+    {
+      const auto current = open.top().second;
+      open.pop();
+
+      if (closed[current]) {
+        continue;
+      }
+      closed[current] = true;
+
+      if (current == goal) {
+        break;
+      }
+
+      if (current == start)
+      {
+        for (const auto &l : start_links) {
+          relax(start, l.node, l.cost, l.path, false);
+        }
+        continue;
+      }
+
+      for (const auto &edge : m_nodes[current].edges) {
+        relax(current, edge.to, edge.cost, m_paths[edge.path], edge.reversed);
+      }
+
+      if (m_nodes[current].cluster == goal_cluster)
+      {
+        for (const auto &l : goal_links) {
+          if (l.node == current) {
+            relax(current, goal, l.cost, l.path, true);
+          }
+        }
+      }
+    }
+
+    if (!closed[goal]) {
+      return std::vector<sf::Vector2i>();
+    }
+
+    // splice the cached paths of the abstract edges back together
+    std::vector<uint32_t> nodes;
+    for (auto node = goal; node != start; node = parent[node])
+    {
+      nodes.push_back(node);
+    }
+    std::reverse(nodes.begin(), nodes.end());
+
+    path.assign(1, t_from);
+    for (const auto node : nodes)
+    {
+      const auto &segment = *parent_path[node];
+      if (parent_reversed[node]) {
+        path.insert(path.end(), segment.rbegin() + 1, segment.rend());
+      } else {
+        path.insert(path.end(), segment.begin() + 1, segment.end());
+      }
+    }
+
+    return path;
+  }
+}
+
@@ -0,0 +1,132 @@
+#ifndef GAME_ENGINE_PATHFINDING_HPP
+#define GAME_ENGINE_PATHFINDING_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace spiced
+{
+  /// One flag per tile: can something walk through it. Stored as a bitset, row by row.
+  class Passability_Grid
+  {
+  public:
+    /// All cells start out passable
+    Passability_Grid(const unsigned int t_width, const unsigned int t_height);
+
+    unsigned int width() const;
+    unsigned int height() const;
+
+    bool in_bounds(const int x, const int y) const;
+
+    /// Cells outside of the grid are never passable
+    bool passable(const int x, const int y) const;
+
+    void set_passable(const int x, const int y, const bool t_passable);
+
+    /// Heap bytes held by the bits
+    size_t memory_bytes() const;
+
+  private:
+    unsigned int m_width;
+    unsigned int m_height;
+    std::vector<uint64_t> m_bits;
+  };
+
+  /// Routes over a Passability_Grid with 8-way movement. Diagonal steps are only allowed when
+  /// both orthogonal neighbors are passable, so paths never cut corners.
+  ///
+  /// Built once per grid:
+  ///  - connected region ids, for O(1) reachability checks that fail fast instead of searching
+  ///  - an HPA* abstraction: the grid is split into square clusters, entrances are placed on the
+  ///    open stretches of every cluster border and the paths between the entrances of a cluster
+  ///    are searched once and cached
+  ///
+  /// Short queries run jump point search on the grid itself, long queries search the small
+  /// abstract graph and splice the cached paths together. Either way a query never touches
+  /// the whole map.
+  ///
+  /// A Pathfinder is immutable after construction. Queries can run on any thread,
+  /// each thread keeps its own search buffers.
+  class Pathfinder
+  {
+  public:
+    static const int default_cluster_size = 16;
+
+    /// Entrances wider than this get one node at each end instead of one in the middle
+    static const int max_single_entrance_width = 6;
+
+    explicit Pathfinder(Passability_Grid t_grid, const int t_cluster_size = default_cluster_size);
+
+    const Passability_Grid &grid() const;
+
+    /// Id of the connected region t_cell belongs to, 0 for impassable cells
+    uint32_t region(const sf::Vector2i &t_cell) const;
+
+    bool reachable(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    /// Every cell from t_from to t_to inclusive, each a single step from the last.
+    /// Empty if there is no path.
+    std::vector<sf::Vector2i> find_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    /// Jump point search over the full grid, optimal but its cost grows with the distance
+    std::vector<sf::Vector2i> find_local_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    /// Search on the cluster abstraction, near optimal and cheap regardless of distance
+    std::vector<sf::Vector2i> find_hierarchical_path(const sf::Vector2i &t_from, const sf::Vector2i &t_to) const;
+
+    size_t abstract_node_count() const;
+
+    /// Heap bytes held by the grid, the regions and the abstraction, not counting per thread search buffers
+    size_t memory_bytes() const;
+
+  private:
+    struct Abstract_Edge
+    {
+      uint32_t to;
+      float cost;
+
+      /// Index into m_paths, walked backwards if reversed
+      uint32_t path;
+      bool reversed;
+    };
+
+    struct Abstract_Node
+    {
+      sf::Vector2i cell;
+      uint32_t cluster;
+      std::vector<Abstract_Edge> edges;
+    };
+
+    uint32_t cluster_of(const sf::Vector2i &t_cell) const;
+    sf::IntRect cluster_bounds(const uint32_t t_cluster) const;
+
+    void build_regions();
+    void build_entrances();
+    void add_entrance(const sf::Vector2i &t_inside, const sf::Vector2i &t_outside);
+    uint32_t node_at(const sf::Vector2i &t_cell);
+    void build_cluster_paths();
+
+    /// A* restricted to t_bounds, returns the cost or a negative value if there is no path
+    float bounded_search(const sf::Vector2i &t_from, const sf::Vector2i &t_to, const sf::IntRect &t_bounds,
+        std::vector<sf::Vector2i> &t_path) const;
+
+    Passability_Grid m_grid;
+    int m_cluster_size;
+    unsigned int m_clusters_x;
+    unsigned int m_clusters_y;
+
+    std::vector<uint32_t> m_regions;
+
+    std::vector<Abstract_Node> m_nodes;
+
+    /// abstract node ids of each cluster's entrances
+    std::vector<std::vector<uint32_t>> m_cluster_nodes;
+
+    /// cell paths of the abstract edges, first and last cell being the edge's nodes
+    std::vector<std::vector<sf::Vector2i>> m_paths;
+  };
+}
+
+#endif
+
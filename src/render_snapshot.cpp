@@ -0,0 +1,36 @@
+#include "render_snapshot.hpp"
+#include "map.hpp"
+
+#include <SFML/Graphics.hpp>
+
+namespace spiced {
+  void Render_Snapshot::draw(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    if (map)
+    {
+      auto map_states = states;
+      map_states.transform *= map->getTransform();
+
+      map->draw_layers(target, map_states);
+    }
+
+    draw_dynamic(target, states);
+  }
+
+  void Render_Snapshot::draw_dynamic(sf::RenderTarget& target, sf::RenderStates states) const
+  {
+    if (map)
+    {
+      auto map_states = states;
+      map_states.transform *= map->getTransform();
+
+      for (const auto &obj : objects)
+      {
+        target.draw(obj, map_states);
+      }
+    }
+
+    target.draw(avatar, states);
+  }
+}
+
@@ -0,0 +1,49 @@
+#ifndef GAME_ENGINE_RENDER_SNAPSHOT_HPP
+#define GAME_ENGINE_RENDER_SNAPSHOT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  class Tile_Map;
+
+  /// Immutable copy of everything the renderer needs for one frame.
+  /// Filled by Game::capture on the simulation thread, drawn by the render thread.
+  /// Snapshots are swapped, never copied, so the vectors keep their capacity from frame to frame.
+  struct Render_Snapshot : sf::Drawable
+  {
+    std::string map_name;
+    const Tile_Map *map = nullptr;
+    uint64_t map_revision = 0;
+    sf::Vector2u map_dimensions;
+
+    std::vector<sf::Sprite> objects;
+    sf::Sprite avatar;
+
+    sf::Vector2f view_center;
+    float zoom = 1;
+    float rotate = 0;
+    bool show_mini_map = false;
+
+    /// Draw static tile layers from a Layer_Cache instead of their vertices
+    bool bake_layers = true;
+
+    std::shared_ptr<const sf::Drawable> event;
+
+    /// Debug information, drawn above everything else
+    std::shared_ptr<const sf::Drawable> overlay;
+
+    /// Objects and avatar, everything above the tile layers
+    void draw_dynamic(sf::RenderTarget& target, sf::RenderStates states) const;
+
+  protected:
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+  };
+}
+
+#endif
+
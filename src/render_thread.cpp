@@ -0,0 +1,167 @@
+#include "render_thread.hpp"
+#include "map.hpp"
+#include "text_geometry.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <utility>
+
+namespace spiced {
+  Render_Thread::Render_Thread(sf::RenderWindow &t_window)
+    : m_window(t_window)
+  {
+    // the GL context can only be active on one thread at a time
+    m_window.setActive(false);
+    m_thread = std::thread(&Render_Thread::run, this);
+  }
+
+  Render_Thread::~Render_Thread()
+  {
+    stop();
+  }
+
+  void Render_Thread::publish(Render_Snapshot &t_snapshot)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return !m_fresh || m_stopping; });
+
+    if (m_error)
+    {
+      std::rethrow_exception(m_error);
+    }
+
+    if (!m_stopping)
+    {
+      using std::swap;
+      swap(m_pending, t_snapshot);
+      m_fresh = true;
+      m_condition.notify_all();
+    }
+  }
+
+  void Render_Thread::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable())
+    {
+      m_thread.join();
+      m_window.setActive(true);
+    }
+  }
+
+  Render_Thread::Pause::Pause(Render_Thread &t_renderer)
+    : m_renderer(t_renderer)
+  {
+    std::unique_lock<std::mutex> lock(m_renderer.m_mutex);
+    m_renderer.m_paused = true;
+    m_renderer.m_condition.wait(lock, [this]() { return !m_renderer.m_rendering || m_renderer.m_stopping; });
+
+    // the render thread is idle until we resume, so its state may be touched from here
+    m_renderer.m_fresh = false;
+    m_renderer.m_mini_map.invalidate();
+    m_renderer.m_layer_cache.invalidate();
+    m_renderer.m_condition.notify_all();
+  }
+
+  Render_Thread::Pause::~Pause()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_renderer.m_mutex);
+      m_renderer.m_paused = false;
+    }
+    m_renderer.m_condition.notify_all();
+  }
+
+  bool Render_Thread::acquire()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_rendering = false;
+    m_condition.notify_all();
+    m_condition.wait(lock, [this]() { return (m_fresh && !m_paused) || m_stopping; });
+
+    if (m_stopping)
+    {
+      return false;
+    }
+
+    using std::swap;
+    swap(m_front, m_pending);
+    m_fresh = false;
+    m_rendering = true;
+    m_condition.notify_all();
+    return true;
+  }
+
+  void Render_Thread::run()
+  {
+    try {
+      m_window.setActive(true);
+
+      while (acquire())
+      {
+        render(m_front);
+      }
+
+      m_window.setActive(false);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_error = std::current_exception();
+      m_stopping = true;
+      m_condition.notify_all();
+    }
+  }
+
+  void Render_Thread::render(const Render_Snapshot &t_snapshot)
+  {
+    const auto window_size = m_window.getSize();
+
+    sf::View mainView(t_snapshot.view_center, sf::Vector2f(window_size));
+    mainView.zoom(t_snapshot.zoom);
+    mainView.rotate(t_snapshot.rotate);
+    m_window.setView(mainView);
+
+    m_window.clear();
+
+    // main frame
+    if (t_snapshot.map && t_snapshot.bake_layers)
+    {
+      sf::RenderStates map_states;
+      map_states.transform *= t_snapshot.map->getTransform();
+      m_layer_cache.draw(m_window, map_states, t_snapshot);
+      t_snapshot.draw_dynamic(m_window, sf::RenderStates());
+    }
+    else {
+      m_window.draw(t_snapshot);
+    }
+
+    if (t_snapshot.show_mini_map)
+    {
+      m_mini_map.draw(m_window, t_snapshot);
+    }
+
+    // fixed overlays
+    m_window.setView(sf::View(sf::FloatRect(0, 0, float(window_size.x), float(window_size.y))));
+
+    {
+      // their text samples glyph atlases the simulation thread may be adding glyphs to
+      std::lock_guard<std::mutex> lock(glyph_atlas_mutex());
+
+      if (t_snapshot.event)
+      {
+        m_window.draw(*t_snapshot.event);
+      }
+
+      if (t_snapshot.overlay)
+      {
+        m_window.draw(*t_snapshot.overlay);
+      }
+    }
+
+    m_window.display();
+  }
+}
+
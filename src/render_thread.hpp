@@ -0,0 +1,79 @@
+#ifndef GAME_ENGINE_RENDER_THREAD_HPP
+#define GAME_ENGINE_RENDER_THREAD_HPP
+
+#include "layer_cache.hpp"
+#include "mini_map.hpp"
+#include "render_snapshot.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace spiced
+{
+  /// Draws published Render_Snapshots on a dedicated thread so that the next simulation
+  /// step overlaps with drawing and window.display() / vsync of the previous one.
+  ///
+  /// The window stays owned by the calling thread, which must keep polling its events.
+  /// Only snapshots cross the thread boundary: ChaiScript is built without thread support,
+  /// so every script callback must keep running on the simulation thread.
+  class Render_Thread
+  {
+  public:
+    explicit Render_Thread(sf::RenderWindow &t_window);
+    Render_Thread(const Render_Thread &) = delete;
+    Render_Thread &operator=(const Render_Thread &) = delete;
+
+    ~Render_Thread();
+
+    /// Hands t_snapshot to the renderer, returning the previously consumed buffer in its place.
+    /// Blocks while the last published snapshot has not been picked up yet, which keeps
+    /// the simulation at most one frame ahead of the display.
+    /// Rethrows any error raised on the render thread.
+    void publish(Render_Snapshot &t_snapshot);
+
+    /// Stops and joins the render thread, leaving the window active on the calling thread.
+    void stop();
+
+    /// Holds the renderer idle for its lifetime: waits for the frame being drawn to finish and
+    /// drops any snapshot not drawn yet, so the game state those snapshots point into
+    /// (maps, objects) can be replaced safely. The next publish() resumes rendering.
+    class Pause
+    {
+    public:
+      explicit Pause(Render_Thread &t_renderer);
+      Pause(const Pause &) = delete;
+      Pause &operator=(const Pause &) = delete;
+      ~Pause();
+
+    private:
+      Render_Thread &m_renderer;
+    };
+
+  private:
+    void run();
+    bool acquire();
+    void render(const Render_Snapshot &t_snapshot);
+
+    sf::RenderWindow &m_window;
+    Mini_Map m_mini_map;
+    Layer_Cache m_layer_cache;
+
+    Render_Snapshot m_pending;
+    Render_Snapshot m_front;
+    bool m_fresh = false;
+    bool m_stopping = false;
+    bool m_paused = false;
+    bool m_rendering = false;
+    std::exception_ptr m_error;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_thread;
+  };
+}
+
+#endif
+
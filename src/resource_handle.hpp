@@ -0,0 +1,21 @@
+#ifndef GAME_ENGINE_RESOURCE_HANDLE_HPP
+#define GAME_ENGINE_RESOURCE_HANDLE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <memory>
+
+namespace spiced
+{
+  /// Reference counted handles to resources owned by the Resource_Manager.
+  /// A resource is only evicted once no handle to it remains outside the manager.
+  typedef std::shared_ptr<const sf::Texture> Texture_Handle;
+  typedef std::shared_ptr<const sf::Font> Font_Handle;
+
+  /// A texture that may still be loading: holds a transparent placeholder until the
+  /// Resource_Manager's update() uploads the texture, then the texture itself.
+  /// Only read it on the thread that updates the manager.
+  typedef std::shared_ptr<const Texture_Handle> Async_Texture_Handle;
+}
+
+#endif
+
@@ -0,0 +1,459 @@
+#include "resource_manager.hpp"
+#include "log.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace spiced {
+  const size_t Resource_Manager::default_budget;
+  const int Resource_Manager::max_uploads_per_update;
+
+  Resource_Manager::Resource_Manager(std::shared_ptr<Job_System> t_jobs, const size_t t_budget)
+    : m_jobs(std::move(t_jobs)),
+      m_budget(t_budget)
+  {
+  }
+
+  Resource_Manager::~Resource_Manager()
+  {
+    {
+      // decodes that have not started yet turn into no-ops
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_jobs->wait(m_decodes);
+  }
+
+  Job_System &Resource_Manager::jobs() const
+  {
+    return *m_jobs;
+  }
+
+  std::string Resource_Manager::normalize(const std::string &t_path)
+  {
+    std::string path(t_path);
+    std::replace(path.begin(), path.end(), '\\', '/');
+
+    const bool absolute = !path.empty() && path[0] == '/';
+
+    std::vector<std::string> segments;
+    size_t begin = 0;
+    while (begin <= path.size())
+    {
+      const auto end = std::min(path.find('/', begin), path.size());
+      const auto segment = path.substr(begin, end - begin);
+      begin = end + 1;
+
+      if (segment.empty() || segment == ".") {
+        continue;
+      } else if (segment == ".." && !segments.empty() && segments.back() != "..") {
+        segments.pop_back();
+      } else if (segment == ".." && absolute) {
+        continue; // can't go above the root
+      } else {
+        segments.push_back(segment);
+      }
+    }
+
+    std::string result(absolute ? "/" : "");
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+      if (i != 0) result += '/';
+      result += segments[i];
+    }
+    return result;
+  }
+
+  size_t Resource_Manager::image_bytes(const sf::Vector2u &t_size)
+  {
+    return size_t(t_size.x) * t_size.y * 4;
+  }
+
+  void Resource_Manager::upload(Texture_Entry &t_entry)
+  {
+    auto texture = std::make_shared<sf::Texture>();
+    if (texture->loadFromImage(*t_entry.image))
+    {
+      t_entry.texture = std::move(texture);
+      t_entry.bytes = image_bytes(t_entry.texture->getSize());
+      t_entry.state = Texture_Entry::State::Ready;
+    }
+    else {
+      t_entry.state = Texture_Entry::State::Failed;
+    }
+    t_entry.image.reset();
+  }
+
+  Resource_Manager::Texture_Entry &Resource_Manager::load_texture(const std::string &t_key)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto itr = m_textures.find(t_key);
+    if (itr == m_textures.end())
+    {
+      itr = m_textures.emplace(t_key, Texture_Entry()).first;
+    }
+
+    auto &entry = itr->second;
+    entry.last_used = m_frame;
+
+    // a background load is in flight, it is cheaper to wait for it than to start over
+    m_condition.wait(lock, [&entry]() { return entry.state != Texture_Entry::State::Decoding; });
+
+    if (entry.state == Texture_Entry::State::Decoded)
+    {
+      upload(entry);
+    }
+
+    if (entry.state == Texture_Entry::State::Queued || entry.state == Texture_Entry::State::Failed)
+    {
+      // claim it, the decoding job skips anything that is no longer queued
+      entry.state = Texture_Entry::State::Decoding;
+      lock.unlock();
+
+      std::unique_ptr<sf::Image> image(new sf::Image());
+      const bool loaded = image->loadFromFile(t_key);
+
+      lock.lock();
+      if (loaded)
+      {
+        entry.image = std::move(image);
+        upload(entry);
+      }
+      else {
+        entry.state = Texture_Entry::State::Failed;
+      }
+      m_condition.notify_all();
+    }
+
+    if (entry.state != Texture_Entry::State::Ready)
+    {
+      throw std::runtime_error("Unable to load texture: " + t_key);
+    }
+
+    return entry;
+  }
+
+  Texture_Handle Resource_Manager::texture(const std::string &t_path)
+  {
+    return load_texture(normalize(t_path)).texture;
+  }
+
+  const sf::Texture &Resource_Manager::pinned_texture(const std::string &t_path)
+  {
+    auto &entry = load_texture(normalize(t_path));
+    entry.pinned = true;
+    return *entry.texture;
+  }
+
+  Async_Texture_Handle Resource_Manager::texture_async(const std::string &t_path)
+  {
+    const auto key = normalize(t_path);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto itr = m_textures.find(key);
+      if (itr != m_textures.end() && itr->second.state == Texture_Entry::State::Ready)
+      {
+        itr->second.last_used = m_frame;
+        return std::make_shared<const Texture_Handle>(itr->second.texture);
+      }
+    }
+
+    prefetch(key);
+
+    if (!m_placeholder)
+    {
+      sf::Image image;
+      image.create(1, 1, sf::Color::Transparent);
+      auto placeholder = std::make_shared<sf::Texture>();
+      placeholder->loadFromImage(image);
+      m_placeholder = std::move(placeholder);
+    }
+
+    // update() points it at the texture once that is uploaded
+    auto handle = std::make_shared<Texture_Handle>(m_placeholder);
+    m_async_textures[key].push_back(handle);
+    return handle;
+  }
+
+  void Resource_Manager::prefetch(const std::string &t_path)
+  {
+    const auto key = normalize(t_path);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto itr = m_textures.find(key);
+      if (itr != m_textures.end())
+      {
+        itr->second.last_used = m_frame;
+        return;
+      }
+
+      m_textures.emplace(key, Texture_Entry());
+    }
+
+    m_jobs->run([this, key]() { decode(key); }, m_decodes);
+  }
+
+  bool Resource_Manager::is_loaded(const std::string &t_path) const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto itr = m_textures.find(normalize(t_path));
+    return itr != m_textures.end() && itr->second.state == Texture_Entry::State::Ready;
+  }
+
+  Font_Handle Resource_Manager::font(const std::string &t_path)
+  {
+    const auto key = normalize(t_path);
+
+    auto itr = m_fonts.find(key);
+    if (itr == m_fonts.end())
+    {
+      auto font = std::make_shared<sf::Font>();
+      if (!font->loadFromFile(key))
+      {
+        throw std::runtime_error("Unable to load font: " + key);
+      }
+
+      Font_Entry entry;
+      entry.font = std::move(font);
+      // sf::Font streams from the file, its size is a fair estimate of the memory held
+      entry.bytes = size_t(std::ifstream(key, std::ios::binary | std::ios::ate).tellg());
+      itr = m_fonts.emplace(key, std::move(entry)).first;
+    }
+
+    itr->second.last_used = m_frame;
+    return itr->second.font;
+  }
+
+  const sf::Font &Resource_Manager::pinned_font(const std::string &t_path)
+  {
+    const auto handle = font(t_path);
+    m_fonts[normalize(t_path)].pinned = true;
+    return *handle;
+  }
+
+  void Resource_Manager::update()
+  {
+    ++m_frame;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    int uploads = 0;
+    while (!m_decoded.empty() && uploads < max_uploads_per_update)
+    {
+      const auto itr = m_textures.find(m_decoded.front());
+      m_decoded.erase(m_decoded.begin());
+
+      // it may have been picked up by a blocking load in the meantime
+      if (itr != m_textures.end() && itr->second.state == Texture_Entry::State::Decoded)
+      {
+        upload(itr->second);
+        ++uploads;
+      }
+    }
+
+    // before evicting, so that textures waited for are held by their handles
+    resolve_async_textures();
+    evict();
+  }
+
+  void Resource_Manager::resolve_async_textures()
+  {
+    auto itr = m_async_textures.begin();
+    while (itr != m_async_textures.end())
+    {
+      const auto texture = m_textures.find(itr->first);
+      const auto state = texture == m_textures.end() ? Texture_Entry::State::Failed : texture->second.state;
+
+      if (state == Texture_Entry::State::Ready)
+      {
+        for (const auto &weak : itr->second)
+        {
+          if (const auto handle = weak.lock()) {
+            *handle = texture->second.texture;
+          }
+        }
+      }
+      else if (state == Texture_Entry::State::Failed)
+      {
+        SPICED_LOG(Resources, Warning, "Unable to load texture " << itr->first << ", its handles keep the placeholder");
+      }
+      else
+      {
+        ++itr;
+        continue;
+      }
+
+      itr = m_async_textures.erase(itr);
+    }
+  }
+
+  void Resource_Manager::evict()
+  {
+    size_t total = 0;
+    for (const auto &texture : m_textures)
+    {
+      total += texture.second.bytes;
+    }
+    for (const auto &font : m_fonts)
+    {
+      total += font.second.bytes;
+    }
+
+    if (total <= m_budget)
+    {
+      return;
+    }
+
+    // (last used, is texture, key) of everything that only the manager still references
+    std::vector<std::tuple<uint64_t, bool, std::string>> candidates;
+    for (const auto &texture : m_textures)
+    {
+      const auto &entry = texture.second;
+      if (entry.state == Texture_Entry::State::Ready && !entry.pinned && entry.texture.use_count() == 1)
+      {
+        candidates.emplace_back(entry.last_used, true, texture.first);
+      }
+    }
+    for (const auto &font : m_fonts)
+    {
+      if (!font.second.pinned && font.second.font.use_count() == 1)
+      {
+        candidates.emplace_back(font.second.last_used, false, font.first);
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &candidate : candidates)
+    {
+      if (total <= m_budget) break;
+
+      if (std::get<1>(candidate)) {
+        const auto itr = m_textures.find(std::get<2>(candidate));
+        total -= itr->second.bytes;
+        m_textures.erase(itr);
+      } else {
+        const auto itr = m_fonts.find(std::get<2>(candidate));
+        total -= itr->second.bytes;
+        m_fonts.erase(itr);
+      }
+      ++m_evictions;
+    }
+  }
+
+  void Resource_Manager::set_budget(const size_t t_budget)
+  {
+    m_budget = t_budget;
+  }
+
+  size_t Resource_Manager::budget() const
+  {
+    return m_budget;
+  }
+
+  Resource_Stats Resource_Manager::stats() const
+  {
+    Resource_Stats stats;
+    stats.budget = m_budget;
+    stats.evictions = m_evictions;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto &texture : m_textures)
+    {
+      const auto &entry = texture.second;
+      if (entry.state == Texture_Entry::State::Ready) {
+        ++stats.textures;
+        stats.texture_bytes += entry.bytes;
+      } else if (entry.state == Texture_Entry::State::Decoded) {
+        ++stats.pending_loads;
+        stats.decoded_bytes += entry.bytes;
+      } else if (entry.state != Texture_Entry::State::Failed) {
+        ++stats.pending_loads;
+      }
+    }
+
+    for (const auto &font : m_fonts)
+    {
+      ++stats.fonts;
+      stats.font_bytes += font.second.bytes;
+    }
+
+    return stats;
+  }
+
+  std::vector<Resource_Usage> Resource_Manager::usage() const
+  {
+    std::vector<Resource_Usage> usage;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const auto &texture : m_textures)
+      {
+        const auto &entry = texture.second;
+        if (entry.state == Texture_Entry::State::Ready)
+        {
+          Resource_Usage resource;
+          resource.path = texture.first;
+          resource.bytes = entry.bytes;
+          resource.handles = entry.texture.use_count() - 1;
+          resource.pinned = entry.pinned;
+          usage.push_back(std::move(resource));
+        }
+      }
+    }
+
+    for (const auto &font : m_fonts)
+    {
+      Resource_Usage resource;
+      resource.path = font.first;
+      resource.is_font = true;
+      resource.bytes = font.second.bytes;
+      resource.handles = font.second.font.use_count() - 1;
+      resource.pinned = font.second.pinned;
+      usage.push_back(std::move(resource));
+    }
+
+    std::stable_sort(usage.begin(), usage.end(),
+        [](const Resource_Usage &t_lhs, const Resource_Usage &t_rhs) { return t_lhs.bytes > t_rhs.bytes; });
+
+    return usage;
+  }
+
+  void Resource_Manager::decode(const std::string &t_key)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto itr = m_textures.find(t_key);
+      if (m_stopping || itr == m_textures.end() || itr->second.state != Texture_Entry::State::Queued) {
+        return;
+      }
+      itr->second.state = Texture_Entry::State::Decoding;
+    }
+
+    // decoding is pure CPU work and safe off the main thread, the GL upload is not
+    std::unique_ptr<sf::Image> image(new sf::Image());
+    const bool loaded = image->loadFromFile(t_key);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      // entries are never evicted while decoding
+      auto &entry = m_textures.find(t_key)->second;
+      if (loaded) {
+        entry.bytes = image_bytes(image->getSize());
+        entry.image = std::move(image);
+        entry.state = Texture_Entry::State::Decoded;
+        m_decoded.push_back(t_key);
+      } else {
+        entry.state = Texture_Entry::State::Failed;
+      }
+    }
+    m_condition.notify_all();
+  }
+}
@@ -0,0 +1,158 @@
+#ifndef GAME_ENGINE_RESOURCE_MANAGER_HPP
+#define GAME_ENGINE_RESOURCE_MANAGER_HPP
+
+#include "job_system.hpp"
+#include "resource_handle.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  struct Resource_Stats
+  {
+    size_t textures = 0;
+    size_t texture_bytes = 0;
+    size_t pending_loads = 0;
+    size_t decoded_bytes = 0;
+    size_t fonts = 0;
+    size_t font_bytes = 0;
+    size_t budget = 0;
+    size_t evictions = 0;
+
+    size_t total_bytes() const
+    {
+      return texture_bytes + decoded_bytes + font_bytes;
+    }
+  };
+
+  /// One texture or font held by a Resource_Manager
+  struct Resource_Usage
+  {
+    std::string path;
+    bool is_font = false;
+    size_t bytes = 0;
+
+    /// Handles held outside of the manager, resources without any can be evicted unless pinned
+    long handles = 0;
+    bool pinned = false;
+  };
+
+  /// Owns every texture and font the engine loads.
+  ///
+  /// Resources are keyed by normalized path and handed out as reference counted handles.
+  /// When the memory in use exceeds the budget, the least recently requested resources that
+  /// nobody holds a handle to anymore are evicted, and reloaded on their next request.
+  ///
+  /// Images can be decoded in background jobs; the upload into a texture then happens
+  /// in update(), on the calling thread, so that no GL work ever runs on a worker.
+  ///
+  /// Apart from its decoding jobs, a Resource_Manager must only be used from one thread.
+  class Resource_Manager
+  {
+  public:
+    static const size_t default_budget = 256 * 1024 * 1024;
+
+    /// Most textures uploaded per update() call, bounds the per frame cost of async loads
+    static const int max_uploads_per_update = 2;
+
+    explicit Resource_Manager(std::shared_ptr<Job_System> t_jobs, const size_t t_budget = default_budget);
+    Resource_Manager(const Resource_Manager &) = delete;
+    Resource_Manager &operator=(const Resource_Manager &) = delete;
+    ~Resource_Manager();
+
+    /// Canonical form of t_path: forward slashes, no empty or "." segments, ".." resolved where possible
+    static std::string normalize(const std::string &t_path);
+
+    /// Returns the texture, loading it on the calling thread if necessary
+    Texture_Handle texture(const std::string &t_path);
+
+    /// Returns a handle to the texture without blocking. If it isn't loaded yet, the handle holds a
+    /// placeholder until update() uploads the texture; a texture that fails to load keeps the placeholder.
+    Async_Texture_Handle texture_async(const std::string &t_path);
+
+    /// Starts loading t_path in the background if it is not loaded yet
+    void prefetch(const std::string &t_path);
+
+    bool is_loaded(const std::string &t_path) const;
+
+    /// For callers that keep raw references: the texture is loaded and never evicted
+    const sf::Texture &pinned_texture(const std::string &t_path);
+
+    Font_Handle font(const std::string &t_path);
+
+    /// For callers that keep raw references: the font is loaded and never evicted
+    const sf::Font &pinned_font(const std::string &t_path);
+
+    Job_System &jobs() const;
+
+    /// Uploads finished background loads, hands them to their async handles and enforces the memory budget
+    void update();
+
+    void set_budget(const size_t t_budget);
+    size_t budget() const;
+
+    Resource_Stats stats() const;
+
+    /// Every loaded resource, largest first. Textures still being loaded are left out.
+    std::vector<Resource_Usage> usage() const;
+
+  private:
+    struct Texture_Entry
+    {
+      enum class State { Queued, Decoding, Decoded, Ready, Failed };
+
+      State state = State::Queued;
+      std::shared_ptr<sf::Texture> texture;
+      std::unique_ptr<sf::Image> image;
+      size_t bytes = 0;
+      uint64_t last_used = 0;
+      bool pinned = false;
+    };
+
+    struct Font_Entry
+    {
+      std::shared_ptr<sf::Font> font;
+      size_t bytes = 0;
+      uint64_t last_used = 0;
+      bool pinned = false;
+    };
+
+    static size_t image_bytes(const sf::Vector2u &t_size);
+
+    Texture_Entry &load_texture(const std::string &t_key);
+    void upload(Texture_Entry &t_entry);
+    void evict();
+    void resolve_async_textures();
+    void decode(const std::string &t_key);
+
+    std::shared_ptr<Job_System> m_jobs;
+    size_t m_budget;
+    uint64_t m_frame = 0;
+    size_t m_evictions = 0;
+
+    Texture_Handle m_placeholder;
+
+    /// Handles given out by texture_async that still hold the placeholder, by key
+    std::map<std::string, std::vector<std::weak_ptr<Texture_Handle>>> m_async_textures;
+
+    std::map<std::string, Font_Entry> m_fonts;
+
+    // shared with the decoding jobs
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::map<std::string, Texture_Entry> m_textures;
+    std::vector<std::string> m_decoded;
+    bool m_stopping = false;
+    Job_Counter m_decodes;
+  };
+}
+
+#endif
+
@@ -0,0 +1,411 @@
+#include "save_game.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef SPICED_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace spiced {
+  namespace {
+    const char magic[4] = { 'S', 'P', 'S', 'V' };
+    const size_t header_size = sizeof(magic) + 2 + 1 + 4;
+
+    class Writer
+    {
+    public:
+      explicit Writer(std::vector<uint8_t> &t_out)
+        : m_out(t_out)
+      {
+      }
+
+      void u8(const uint8_t t_value)
+      {
+        m_out.push_back(t_value);
+      }
+
+      void fixed(uint64_t t_value, const int t_bytes)
+      {
+        for (int i = 0; i < t_bytes; ++i, t_value >>= 8)
+        {
+          m_out.push_back(uint8_t(t_value & 0xFF));
+        }
+      }
+
+      void varint(uint64_t t_value)
+      {
+        while (t_value >= 0x80)
+        {
+          m_out.push_back(uint8_t(t_value | 0x80));
+          t_value >>= 7;
+        }
+        m_out.push_back(uint8_t(t_value));
+      }
+
+      void integer(const int t_value)
+      {
+        const auto value = int64_t(t_value);
+        varint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+      }
+
+      void real(const float t_value)
+      {
+        uint32_t bits;
+        std::memcpy(&bits, &t_value, sizeof(bits));
+        fixed(bits, 4);
+      }
+
+      void string(const std::string &t_value)
+      {
+        varint(t_value.size());
+        m_out.insert(m_out.end(), t_value.begin(), t_value.end());
+      }
+
+    private:
+      std::vector<uint8_t> &m_out;
+    };
+
+    class Reader
+    {
+    public:
+      Reader(const uint8_t *t_begin, const uint8_t *t_end)
+        : m_pos(t_begin), m_end(t_end)
+      {
+      }
+
+      uint8_t u8()
+      {
+        need(1);
+        return *m_pos++;
+      }
+
+      uint64_t fixed(const int t_bytes)
+      {
+        need(size_t(t_bytes));
+        uint64_t value = 0;
+        for (int i = 0; i < t_bytes; ++i)
+        {
+          value |= uint64_t(*m_pos++) << (8 * i);
+        }
+        return value;
+      }
+
+      uint64_t varint()
+      {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+          const auto byte = u8();
+          value |= uint64_t(byte & 0x7F) << shift;
+          if (!(byte & 0x80)) {
+            return value;
+          }
+        }
+        throw std::runtime_error("Save file damaged: varint too long");
+      }
+
+      int integer()
+      {
+        const auto value = varint();
+        return int(int64_t(value >> 1) ^ -int64_t(value & 1));
+      }
+
+      float real()
+      {
+        const auto bits = uint32_t(fixed(4));
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+      }
+
+      /// Element counts are bounded by the remaining input, so a damaged count can't trigger a huge allocation
+      size_t count()
+      {
+        const auto value = varint();
+        if (value > remaining()) {
+          throw std::runtime_error("Save file damaged: count exceeds file size");
+        }
+        return size_t(value);
+      }
+
+      std::string string()
+      {
+        const auto size = count();
+        std::string value(reinterpret_cast<const char *>(m_pos), size);
+        m_pos += size;
+        return value;
+      }
+
+      size_t remaining() const
+      {
+        return size_t(m_end - m_pos);
+      }
+
+    private:
+      void need(const size_t t_bytes) const
+      {
+        if (remaining() < t_bytes) {
+          throw std::runtime_error("Save file damaged: unexpected end of data");
+        }
+      }
+
+      const uint8_t *m_pos;
+      const uint8_t *m_end;
+    };
+
+    void write_payload(Writer &t_out, const Save_State &t_state)
+    {
+      t_out.varint(t_state.flags.size());
+      for (const auto &flag : t_state.flags)
+      {
+        t_out.string(flag.first);
+        t_out.u8(flag.second ? 1 : 0);
+      }
+
+      t_out.varint(t_state.values.size());
+      for (const auto &value : t_state.values)
+      {
+        t_out.string(value.first);
+        t_out.integer(value.second);
+      }
+
+      t_out.string(t_state.current_map);
+      t_out.real(t_state.avatar_position.x);
+      t_out.real(t_state.avatar_position.y);
+      t_out.real(t_state.zoom);
+      t_out.real(t_state.rotate);
+
+      t_out.varint(t_state.objects.size());
+      for (const auto &map : t_state.objects)
+      {
+        t_out.string(map.first);
+        t_out.varint(map.second.size());
+        for (const auto &obj : map.second)
+        {
+          t_out.string(obj.name);
+          t_out.real(obj.position.x);
+          t_out.real(obj.position.y);
+        }
+      }
+    }
+
+    Save_State read_payload(Reader &t_in)
+    {
+      Save_State state;
+
+      for (auto i = t_in.count(); i > 0; --i)
+      {
+        auto name = t_in.string();
+        state.flags[std::move(name)] = t_in.u8() != 0;
+      }
+
+      for (auto i = t_in.count(); i > 0; --i)
+      {
+        auto name = t_in.string();
+        state.values[std::move(name)] = t_in.integer();
+      }
+
+      state.current_map = t_in.string();
+      state.avatar_position.x = t_in.real();
+      state.avatar_position.y = t_in.real();
+      state.zoom = t_in.real();
+      state.rotate = t_in.real();
+
+      for (auto i = t_in.count(); i > 0; --i)
+      {
+        auto &objects = state.objects[t_in.string()];
+        for (auto j = t_in.count(); j > 0; --j)
+        {
+          auto name = t_in.string();
+          const auto x = t_in.real();
+          const auto y = t_in.real();
+          objects.emplace_back(std::move(name), sf::Vector2f(x, y));
+        }
+      }
+
+      return state;
+    }
+
+    void write_file(const std::string &t_path, const std::vector<uint8_t> &t_data)
+    {
+      const auto temp_path = t_path + ".tmp";
+
+      {
+        std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(t_data.data()), std::streamsize(t_data.size()));
+        if (!ofs) {
+          throw std::runtime_error("Unable to write save file: " + temp_path);
+        }
+      }
+
+#ifdef _WIN32
+      // rename does not replace existing files on Windows
+      std::remove(t_path.c_str());
+#endif
+
+      if (std::rename(temp_path.c_str(), t_path.c_str()) != 0) {
+        throw std::runtime_error("Unable to replace save file: " + t_path);
+      }
+    }
+  }
+
+  std::vector<uint8_t> save_format::encode(const Save_State &t_state)
+  {
+    std::vector<uint8_t> payload;
+    Writer payload_writer(payload);
+    write_payload(payload_writer, t_state);
+
+    std::vector<uint8_t> result(std::begin(magic), std::end(magic));
+    Writer out(result);
+    out.fixed(version, 2);
+
+#ifdef SPICED_HAS_ZLIB
+    auto compressed_size = compressBound(uLong(payload.size()));
+    result.reserve(header_size + compressed_size);
+    out.u8(uint8_t(Compression::Zlib));
+    out.fixed(payload.size(), 4);
+    result.resize(header_size + compressed_size);
+    if (compress2(result.data() + header_size, &compressed_size, payload.data(), uLong(payload.size()), Z_BEST_SPEED) != Z_OK) {
+      throw std::runtime_error("Unable to compress save state");
+    }
+    result.resize(header_size + compressed_size);
+#else
+    out.u8(uint8_t(Compression::None));
+    out.fixed(payload.size(), 4);
+    result.insert(result.end(), payload.begin(), payload.end());
+#endif
+
+    return result;
+  }
+
+  Save_State save_format::decode(const std::vector<uint8_t> &t_data)
+  {
+    if (t_data.size() < header_size || !std::equal(std::begin(magic), std::end(magic), t_data.begin())) {
+      throw std::runtime_error("Not a save file");
+    }
+
+    Reader header(t_data.data() + sizeof(magic), t_data.data() + header_size);
+    const auto file_version = header.fixed(2);
+    const auto compression = Compression(header.u8());
+    const auto payload_size = size_t(header.fixed(4));
+
+    if (file_version > version) {
+      throw std::runtime_error("Save file was written by a newer version of the game");
+    }
+
+    const auto *payload = t_data.data() + header_size;
+    const auto stored_size = t_data.size() - header_size;
+
+    switch (compression)
+    {
+      case Compression::None:
+      {
+        if (stored_size != payload_size) {
+          throw std::runtime_error("Save file damaged: size mismatch");
+        }
+        Reader in(payload, payload + payload_size);
+        return read_payload(in);
+      }
+
+      case Compression::Zlib:
+      {
+#ifdef SPICED_HAS_ZLIB
+        std::vector<uint8_t> inflated(payload_size);
+        auto inflated_size = uLongf(payload_size);
+        if (uncompress(inflated.data(), &inflated_size, payload, uLong(stored_size)) != Z_OK || inflated_size != payload_size) {
+          throw std::runtime_error("Save file damaged: unable to decompress");
+        }
+        Reader in(inflated.data(), inflated.data() + inflated.size());
+        return read_payload(in);
+#else
+        throw std::runtime_error("Save file is compressed, but the game was built without zlib");
+#endif
+      }
+    }
+
+    throw std::runtime_error("Save file uses an unknown compression");
+  }
+
+  Save_State read_save_file(const std::string &t_path)
+  {
+    std::ifstream ifs(t_path, std::ios::binary);
+    if (!ifs) {
+      throw std::runtime_error("Unable to open save file: " + t_path);
+    }
+
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    return save_format::decode(data);
+  }
+
+
+  Save_Writer::Save_Writer(Job_System &t_jobs)
+    : m_jobs(t_jobs)
+  {
+  }
+
+  Save_Writer::~Save_Writer()
+  {
+    flush();
+  }
+
+  void Save_Writer::write(const std::string &t_path, Save_State t_state)
+  {
+    bool start_job = false;
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      const auto queued = std::find_if(m_queue.begin(), m_queue.end(),
+          [&t_path](const std::pair<std::string, Save_State> &t_entry) { return t_entry.first == t_path; });
+
+      if (queued != m_queue.end()) {
+        queued->second = std::move(t_state);
+      } else {
+        m_queue.emplace_back(t_path, std::move(t_state));
+      }
+
+      start_job = !m_draining;
+      m_draining = true;
+    }
+
+    if (start_job) {
+      m_jobs.run([this]() { drain(); }, m_writes);
+    }
+  }
+
+  void Save_Writer::flush()
+  {
+    m_jobs.wait(m_writes);
+  }
+
+  void Save_Writer::drain()
+  {
+    for (;;)
+    {
+      std::pair<std::string, Save_State> entry;
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.empty()) {
+          m_draining = false;
+          return;
+        }
+
+        entry = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      try {
+        write_file(entry.first, save_format::encode(entry.second));
+      } catch (const std::exception &e) {
+        SPICED_LOG(Save, Error, "Saving failed: " << e.what());
+      }
+    }
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef GAME_ENGINE_SAVE_GAME_HPP
+#define GAME_ENGINE_SAVE_GAME_HPP
+
+#include "job_system.hpp"
+
+#include <SFML/System.hpp>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace spiced
+{
+  struct Saved_Object
+  {
+    Saved_Object(std::string t_name, const sf::Vector2f &t_position)
+      : name(std::move(t_name)), position(t_position)
+    {
+    }
+
+    std::string name;
+    sf::Vector2f position;
+  };
+
+  /// Plain copy of the persistent game state, cheap to capture on the simulation thread
+  struct Save_State
+  {
+    std::map<std::string, bool> flags;
+    std::map<std::string, int> values;
+
+    std::string current_map;
+    sf::Vector2f avatar_position;
+    float zoom = 1;
+    float rotate = 0;
+
+    /// map name -> objects of that map, in map order
+    std::map<std::string, std::vector<Saved_Object>> objects;
+  };
+
+  /// Save file layout, all integers little endian:
+  ///
+  ///   "SPSV" | u16 format version | u8 compression | u32 uncompressed size | payload
+  ///
+  /// The payload is the serialized Save_State, compressed with zlib when the engine was
+  /// built with it. Counts and string lengths are stored as varints, ints zigzag encoded.
+  namespace save_format
+  {
+    static const uint16_t version = 1;
+
+    enum class Compression : uint8_t { None = 0, Zlib = 1 };
+
+    std::vector<uint8_t> encode(const Save_State &t_state);
+
+    /// Throws std::runtime_error on a damaged file or an unsupported version
+    Save_State decode(const std::vector<uint8_t> &t_data);
+  }
+
+  Save_State read_save_file(const std::string &t_path);
+
+  /// Encodes and writes save states in a background job, so that saving never stalls a frame.
+  /// Files are written to a temporary name first and then renamed, a crash during a save
+  /// leaves the previous save intact. Queued states for the same path are coalesced.
+  class Save_Writer
+  {
+  public:
+    explicit Save_Writer(Job_System &t_jobs);
+    Save_Writer(const Save_Writer &) = delete;
+    Save_Writer &operator=(const Save_Writer &) = delete;
+
+    /// Writes everything still queued before returning
+    ~Save_Writer();
+
+    void write(const std::string &t_path, Save_State t_state);
+
+    /// Blocks until every queued state is on disk
+    void flush();
+
+  private:
+    /// Body of the writing job, at most one runs at a time so saves land in order
+    void drain();
+
+    Job_System &m_jobs;
+    Job_Counter m_writes;
+
+    std::mutex m_mutex;
+    std::deque<std::pair<std::string, Save_State>> m_queue;
+    bool m_draining = false;
+  };
+}
+
+#endif
+
@@ -0,0 +1,89 @@
+#include "text_geometry.hpp"
+
+#include <SFML/Graphics.hpp>
+
+namespace spiced {
+  std::mutex &glyph_atlas_mutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  void prewarm_glyphs(const sf::Font &t_font, const unsigned int t_character_size)
+  {
+    std::lock_guard<std::mutex> lock(glyph_atlas_mutex());
+    for (sf::Uint32 c = 32; c < 127; ++c)
+    {
+      t_font.getGlyph(c, t_character_size, false);
+    }
+    t_font.getTexture(t_character_size);
+  }
+
+
+  Text_Geometry::Text_Geometry(Font_Handle t_font, const unsigned int t_character_size)
+    : font(std::move(t_font)),
+      character_size(t_character_size),
+      texture(nullptr)
+  {
+    // the first use of a character size adds a page to the font
+    std::lock_guard<std::mutex> lock(glyph_atlas_mutex());
+    texture = &font->getTexture(t_character_size);
+  }
+
+  size_t Text_Geometry::add_line(const sf::String &t_string, const sf::Vector2f &t_position, const sf::Color &t_color)
+  {
+    const auto begin = vertices.size();
+
+    // glyphs missing from the atlas are rasterized into the texture the render thread draws text from
+    std::lock_guard<std::mutex> lock(glyph_atlas_mutex());
+
+    // same layout rules as sf::Text
+    const auto hspace = font->getGlyph(L' ', character_size, false).advance;
+    const auto vspace = font->getLineSpacing(character_size);
+
+    auto x = 0.0f;
+    auto y = float(character_size);
+    sf::Uint32 prev_char = 0;
+
+    vertices.reserve(vertices.size() + t_string.getSize() * 4);
+
+    for (size_t i = 0; i < t_string.getSize(); ++i)
+    {
+      const sf::Uint32 cur_char = t_string[i];
+
+      x += font->getKerning(prev_char, cur_char, character_size);
+      prev_char = cur_char;
+
+      switch (cur_char)
+      {
+        case ' ':  x += hspace; continue;
+        case '\t': x += hspace * 4; continue;
+        case '\n': y += vspace; x = 0; continue;
+        case '\r': continue;
+      }
+
+      const auto &glyph = font->getGlyph(cur_char, character_size, false);
+
+      const auto left = t_position.x + x + glyph.bounds.left;
+      const auto top = t_position.y + y + glyph.bounds.top;
+      const auto right = left + glyph.bounds.width;
+      const auto bottom = top + glyph.bounds.height;
+
+      const auto u1 = float(glyph.textureRect.left);
+      const auto v1 = float(glyph.textureRect.top);
+      const auto u2 = float(glyph.textureRect.left + glyph.textureRect.width);
+      const auto v2 = float(glyph.textureRect.top + glyph.textureRect.height);
+
+      vertices.push_back(sf::Vertex(sf::Vector2f(left, top), t_color, sf::Vector2f(u1, v1)));
+      vertices.push_back(sf::Vertex(sf::Vector2f(right, top), t_color, sf::Vector2f(u2, v1)));
+      vertices.push_back(sf::Vertex(sf::Vector2f(right, bottom), t_color, sf::Vector2f(u2, v2)));
+      vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), t_color, sf::Vector2f(u1, v2)));
+
+      x += glyph.advance;
+    }
+
+    lines.push_back(std::make_pair(begin, vertices.size()));
+    return lines.size() - 1;
+  }
+}
+
@@ -0,0 +1,46 @@
+#ifndef GAME_ENGINE_TEXT_GEOMETRY_HPP
+#define GAME_ENGINE_TEXT_GEOMETRY_HPP
+
+#include "resource_handle.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace spiced
+{
+  /// Guards the fonts' glyph atlases: sf::Font rasterizes missing glyphs into its atlas texture,
+  /// growing or replacing it, while the render thread may be drawing text from it.
+  /// Held by the render thread while it draws text and by anyone asking a font for glyphs.
+  std::mutex &glyph_atlas_mutex();
+
+  /// Loads every printable ASCII glyph of t_font at t_character_size into its glyph atlas,
+  /// so that showing text later rarely has to rasterize glyphs and wait for the render thread
+  void prewarm_glyphs(const sf::Font &t_font, const unsigned int t_character_size);
+
+  /// Glyph quads for one or more lines of text, built once and then drawn as-is.
+  /// The glyph atlas texture is resolved at build time so drawing never touches the font.
+  /// Building holds glyph_atlas_mutex(), so it's safe on the simulation thread with any
+  /// character and size, though glyphs that weren't prewarmed wait for the text being drawn.
+  struct Text_Geometry
+  {
+    Text_Geometry(Font_Handle t_font, const unsigned int t_character_size);
+
+    /// Lays out t_string at t_position and returns the index of the new line
+    size_t add_line(const sf::String &t_string, const sf::Vector2f &t_position, const sf::Color &t_color);
+
+    Font_Handle font;
+    unsigned int character_size;
+    const sf::Texture *texture;
+
+    std::vector<sf::Vertex> vertices;
+
+    /// [begin, end) vertex range of each line
+    std::vector<std::pair<size_t, size_t>> lines;
+  };
+}
+
+#endif
+
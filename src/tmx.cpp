@@ -0,0 +1,538 @@
+#include "map_file.hpp"
+#include "job_system.hpp"
+#include "log.hpp"
+#include "xml.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef SPICED_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SPICED_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace spiced {
+  namespace {
+    /// Below this many cells, summed over all layers, tile layers are decoded on the loading thread only
+    const size_t min_parallel_decode_tiles = 1 << 14;
+
+    /// Tiled's chunk size, for infinite maps that have no chunks to take it from
+    const unsigned int default_chunk_size = 16;
+
+    std::string read_file(const std::string &t_file_path)
+    {
+      std::ifstream ifs(t_file_path, std::ios::binary);
+      if (!ifs) {
+        throw std::runtime_error("Unable to open map file: '" + t_file_path + "'");
+      }
+
+      std::stringstream buff;
+      buff << ifs.rdbuf();
+      return buff.str();
+    }
+
+    const char *required(const Xml_Document &t_doc, const Xml_Document::Node &t_node, const char *t_name)
+    {
+      const auto value = t_doc.attribute(t_node, t_name);
+      if (!value) {
+        throw std::runtime_error(std::string("TMX element <") + t_node.name + "> has no '" + t_name + "' attribute");
+      }
+      return value;
+    }
+
+    int int_attribute(const Xml_Document &t_doc, const Xml_Document::Node &t_node, const char *t_name)
+    {
+      return int(std::strtol(required(t_doc, t_node, t_name), nullptr, 10));
+    }
+
+    float float_attribute(const Xml_Document &t_doc, const Xml_Document::Node &t_node, const char *t_name, const float t_default)
+    {
+      const auto value = t_doc.attribute(t_node, t_name);
+      return value ? float(std::strtod(value, nullptr)) : t_default;
+    }
+
+    bool visible_attribute(const Xml_Document &t_doc, const Xml_Document::Node &t_node)
+    {
+      const auto value = t_doc.attribute(t_node, "visible");
+      return !value || std::strcmp(value, "0") != 0;
+    }
+
+    Map_File::Properties read_properties(const Xml_Document &t_doc, const Xml_Document::Node &t_owner)
+    {
+      Map_File::Properties properties;
+      if (const auto list = t_doc.first_child(t_owner, "properties"))
+      {
+        for (auto property = t_doc.first_child(*list, "property"); property; property = t_doc.next_sibling(*property, "property"))
+        {
+          // multi-line strings are stored as text instead of a value attribute
+          const auto value = t_doc.attribute(*property, "value");
+          properties.emplace(required(t_doc, *property, "name"), value ? value : property->text);
+        }
+      }
+      return properties;
+    }
+
+    void read_tileset(const Xml_Document &t_doc, const Xml_Document::Node &t_node, const std::string &t_directory, Map_File::Tileset &t_tileset)
+    {
+      t_tileset.tile_width = int_attribute(t_doc, t_node, "tilewidth");
+      t_tileset.tile_height = int_attribute(t_doc, t_node, "tileheight");
+
+      const auto image = t_doc.first_child(t_node, "image");
+      if (!image) {
+        throw std::runtime_error("Image collection tilesets are not supported");
+      }
+      t_tileset.image = t_directory + required(t_doc, *image, "source");
+
+      for (auto tile = t_doc.first_child(t_node, "tile"); tile; tile = t_doc.next_sibling(*tile, "tile"))
+      {
+        const auto id = int_attribute(t_doc, *tile, "id");
+
+        auto properties = read_properties(t_doc, *tile);
+        if (!properties.empty()) {
+          t_tileset.tile_properties[id] = std::move(properties);
+        }
+
+        if (const auto animation = t_doc.first_child(*tile, "animation"))
+        {
+          auto &frames = t_tileset.animations[id];
+          for (auto frame = t_doc.first_child(*animation, "frame"); frame; frame = t_doc.next_sibling(*frame, "frame")) {
+            frames.push_back(Map_File::Frame{int_attribute(t_doc, *frame, "tileid"), int_attribute(t_doc, *frame, "duration")});
+          }
+        }
+      }
+    }
+
+    std::vector<unsigned char> decode_base64(const char *t_text)
+    {
+      static const auto values = []() {
+        std::vector<signed char> table(256, -1);
+        const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i) {
+          table[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+        }
+        return table;
+      }();
+
+      std::vector<unsigned char> bytes;
+      bytes.reserve(std::strlen(t_text) / 4 * 3);
+
+      unsigned int bits = 0;
+      int bit_count = 0;
+      for (auto c = t_text; *c && *c != '='; ++c)
+      {
+        const auto value = values[static_cast<unsigned char>(*c)];
+        if (value < 0) {
+          if (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r') {
+            continue;
+          }
+          throw std::runtime_error("Invalid base64 in TMX layer data");
+        }
+
+        bits = (bits << 6) | unsigned(value);
+        bit_count += 6;
+        if (bit_count >= 8) {
+          bit_count -= 8;
+          bytes.push_back(static_cast<unsigned char>((bits >> bit_count) & 0xFF));
+        }
+      }
+
+      return bytes;
+    }
+
+    std::vector<unsigned char> decompress(std::vector<unsigned char> t_bytes, const char *t_compression, const size_t t_size)
+    {
+      if (!t_compression || !*t_compression) {
+        return t_bytes;
+      }
+
+      std::vector<unsigned char> out(t_size);
+
+      if (std::strcmp(t_compression, "zlib") == 0 || std::strcmp(t_compression, "gzip") == 0)
+      {
+#ifdef SPICED_HAS_ZLIB
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+
+        // 32 accepts both zlib and gzip headers
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+          throw std::runtime_error("Unable to initialize zlib");
+        }
+
+        stream.next_in = t_bytes.data();
+        stream.avail_in = uInt(t_bytes.size());
+        stream.next_out = out.data();
+        stream.avail_out = uInt(out.size());
+
+        const auto result = inflate(&stream, Z_FINISH);
+        const auto produced = stream.total_out;
+        inflateEnd(&stream);
+
+        if (result != Z_STREAM_END || produced != t_size) {
+          throw std::runtime_error(std::string("Corrupt ") + t_compression + " data in TMX layer");
+        }
+        return out;
+#else
+        throw std::runtime_error(std::string("TMX layer is ") + t_compression + " compressed, but the game was built without zlib");
+#endif
+      }
+
+      if (std::strcmp(t_compression, "zstd") == 0)
+      {
+#ifdef SPICED_HAS_ZSTD
+        const auto produced = ZSTD_decompress(out.data(), out.size(), t_bytes.data(), t_bytes.size());
+        if (ZSTD_isError(produced) || produced != t_size) {
+          throw std::runtime_error("Corrupt zstd data in TMX layer");
+        }
+        return out;
+#else
+        throw std::runtime_error("TMX layer is zstd compressed, but the game was built without zstd");
+#endif
+      }
+
+      throw std::runtime_error(std::string("Unknown TMX layer compression: '") + t_compression + "'");
+    }
+
+    /// The gids in the text of a CSV or base64 encoded <data> or <chunk> element
+    std::vector<int> decode_text(const char *t_text, const char *t_encoding, const char *t_compression, const size_t t_cells)
+    {
+      std::vector<int> gids;
+      gids.reserve(t_cells);
+
+      if (std::strcmp(t_encoding, "csv") == 0)
+      {
+        auto p = t_text;
+        for (;;)
+        {
+          while (*p == ',' || *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            ++p;
+          }
+          if (!*p) {
+            break;
+          }
+
+          char *end = nullptr;
+          // gids are unsigned, the top bits hold the flip flags
+          const auto gid = std::strtoul(p, &end, 10);
+          if (end == p) {
+            throw std::runtime_error("Invalid CSV in TMX layer data");
+          }
+          gids.push_back(int(uint32_t(gid)));
+          p = end;
+        }
+      }
+      else if (std::strcmp(t_encoding, "base64") == 0)
+      {
+        const auto bytes = decompress(decode_base64(t_text), t_compression, t_cells * 4);
+        if (bytes.size() != t_cells * 4) {
+          throw std::runtime_error("TMX layer data has the wrong size");
+        }
+
+        // little endian unsigned 32 bit gids
+        for (size_t i = 0; i < t_cells; ++i) {
+          const auto b = &bytes[i * 4];
+          gids.push_back(int(uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24)));
+        }
+      }
+      else
+      {
+        throw std::runtime_error(std::string("Unknown TMX layer encoding: '") + t_encoding + "'");
+      }
+
+      if (gids.size() != t_cells) {
+        throw std::runtime_error("TMX layer has " + std::to_string(gids.size()) + " tiles, expected " + std::to_string(t_cells));
+      }
+
+      return gids;
+    }
+
+    /// The gids of a <data> element, whichever encoding it uses
+    std::vector<int> decode_layer(const Xml_Document &t_doc, const Xml_Document::Node &t_data, const size_t t_cells)
+    {
+      const auto encoding = t_doc.attribute(t_data, "encoding");
+      if (encoding) {
+        return decode_text(t_data.text, encoding, t_doc.attribute(t_data, "compression"), t_cells);
+      }
+
+      std::vector<int> gids;
+      gids.reserve(t_cells);
+
+      for (auto tile = t_doc.first_child(t_data, "tile"); tile; tile = t_doc.next_sibling(*tile, "tile")) {
+        const auto gid = t_doc.attribute(*tile, "gid");
+        gids.push_back(gid ? int(std::strtoul(gid, nullptr, 10)) : 0);
+      }
+
+      if (gids.size() != t_cells) {
+        throw std::runtime_error("TMX layer has " + std::to_string(gids.size()) + " tiles, expected " + std::to_string(t_cells));
+      }
+
+      return gids;
+    }
+
+    struct Layer_Source
+    {
+      const Xml_Document::Node *data;
+      size_t layer;
+    };
+
+    /// Reads the layers and objects under t_parent in order, descending into groups
+    void read_layers(const Xml_Document &t_doc, const Xml_Document::Node &t_parent, const bool t_visible, Map_File &t_map, std::vector<Layer_Source> &t_sources)
+    {
+      for (auto node = t_doc.first_child(t_parent); node; node = t_doc.next_sibling(*node))
+      {
+        if (std::strcmp(node->name, "layer") == 0)
+        {
+          Map_File::Layer layer;
+          const auto name = t_doc.attribute(*node, "name");
+          layer.name = name ? name : "";
+          layer.visible = t_visible && visible_attribute(t_doc, *node);
+          layer.properties = read_properties(t_doc, *node);
+
+          const auto data = t_doc.first_child(*node, "data");
+          if (!data) {
+            throw std::runtime_error("TMX layer '" + layer.name + "' has no data");
+          }
+
+          t_sources.push_back(Layer_Source{data, t_map.layers.size()});
+          t_map.layers.push_back(std::move(layer));
+        }
+        else if (std::strcmp(node->name, "objectgroup") == 0)
+        {
+          for (auto object = t_doc.first_child(*node, "object"); object; object = t_doc.next_sibling(*object, "object"))
+          {
+            const auto name = t_doc.attribute(*object, "name");
+            const auto gid = t_doc.attribute(*object, "gid");
+
+            if (!gid) {
+              SPICED_LOG(Map, Warning, "Ignoring TMX object without a tile: " << (name ? name : ""));
+              continue;
+            }
+
+            Map_File::Object obj;
+            obj.name = name ? name : "";
+            obj.gid = int(uint32_t(std::strtoul(gid, nullptr, 10)));
+            obj.visible = visible_attribute(t_doc, *object);
+            obj.x = float_attribute(t_doc, *object, "x", 0);
+            obj.y = float_attribute(t_doc, *object, "y", 0);
+            obj.properties = read_properties(t_doc, *object);
+            t_map.objects.push_back(std::move(obj));
+          }
+        }
+        else if (std::strcmp(node->name, "group") == 0)
+        {
+          read_layers(t_doc, *node, t_visible && visible_attribute(t_doc, *node), t_map, t_sources);
+        }
+      }
+    }
+
+    /// Records where the <chunk>s of an infinite map's layers are instead of decoding them
+    std::shared_ptr<const Chunk_Index> index_chunks(const Xml_Document &t_doc, const std::string &t_file_path,
+        const std::vector<Layer_Source> &t_sources, const size_t t_layers)
+    {
+      std::vector<Chunk_Index::Layer_Format> formats(t_layers);
+      sf::Vector2u chunk_size;
+
+      for (const auto &source : t_sources)
+      {
+        // only text can be found again by its offset, <tile> elements would have to be parsed
+        const auto encoding = t_doc.attribute(*source.data, "encoding");
+        if (!encoding || (std::strcmp(encoding, "csv") != 0 && std::strcmp(encoding, "base64") != 0)) {
+          throw std::runtime_error("Infinite TMX maps need CSV or base64 layer data: '" + t_file_path + "'");
+        }
+
+        const auto compression = t_doc.attribute(*source.data, "compression");
+        formats[source.layer] = Chunk_Index::Layer_Format{encoding, compression ? compression : ""};
+
+        const auto chunk = t_doc.first_child(*source.data, "chunk");
+        if (chunk && chunk_size == sf::Vector2u()) {
+          chunk_size = sf::Vector2u(int_attribute(t_doc, *chunk, "width"), int_attribute(t_doc, *chunk, "height"));
+        }
+      }
+
+      if (chunk_size.x == 0 || chunk_size.y == 0) {
+        chunk_size = sf::Vector2u(default_chunk_size, default_chunk_size);
+      }
+
+      const auto width = int(chunk_size.x);
+      const auto height = int(chunk_size.y);
+      auto index = std::make_shared<Chunk_Index>(t_file_path, chunk_size, std::move(formats));
+
+      for (const auto &source : t_sources)
+      {
+        for (auto chunk = t_doc.first_child(*source.data, "chunk"); chunk; chunk = t_doc.next_sibling(*chunk, "chunk"))
+        {
+          const auto x = int_attribute(t_doc, *chunk, "x");
+          const auto y = int_attribute(t_doc, *chunk, "y");
+
+          if (int_attribute(t_doc, *chunk, "width") != width || int_attribute(t_doc, *chunk, "height") != height
+              || x % width != 0 || y % height != 0)
+          {
+            throw std::runtime_error("TMX chunks must all be " + std::to_string(width) + "x" + std::to_string(height)
+                + " tiles and aligned to that size: '" + t_file_path + "'");
+          }
+
+          const auto length = std::strlen(chunk->text);
+          if (length != 0) {
+            index->add(sf::Vector2i(x / width, y / height), source.layer, t_doc.offset(chunk->text), uint32_t(length));
+          }
+        }
+      }
+
+      return index;
+    }
+  }
+
+  Chunk_Index::Chunk_Index(std::string t_file_path, const sf::Vector2u &t_chunk_size, std::vector<Layer_Format> t_layers)
+    : m_file_path(std::move(t_file_path)),
+      m_chunk_size(t_chunk_size),
+      m_layers(std::move(t_layers))
+  {
+  }
+
+  uint64_t Chunk_Index::key(const sf::Vector2i &t_chunk)
+  {
+    return (uint64_t(uint32_t(t_chunk.x)) << 32) | uint32_t(t_chunk.y);
+  }
+
+  void Chunk_Index::add(const sf::Vector2i &t_chunk, const size_t t_layer, const uint64_t t_offset, const uint32_t t_length)
+  {
+    auto itr = m_chunks.find(key(t_chunk));
+    if (itr == m_chunks.end())
+    {
+      itr = m_chunks.emplace(key(t_chunk), m_spans.size()).first;
+      m_spans.resize(m_spans.size() + m_layers.size());
+    }
+
+    auto &span = m_spans[itr->second + t_layer];
+    span.offset = t_offset;
+    span.length = t_length;
+  }
+
+  sf::Vector2u Chunk_Index::chunk_size() const
+  {
+    return m_chunk_size;
+  }
+
+  size_t Chunk_Index::layer_count() const
+  {
+    return m_layers.size();
+  }
+
+  bool Chunk_Index::contains(const sf::Vector2i &t_chunk) const
+  {
+    return m_chunks.count(key(t_chunk)) != 0;
+  }
+
+  Chunk_Index::Tiles Chunk_Index::read(const sf::Vector2i &t_chunk) const
+  {
+    const auto cells = size_t(m_chunk_size.x) * m_chunk_size.y;
+    Tiles tiles(m_layers.size(), std::vector<int>(cells, 0));
+
+    const auto chunk = m_chunks.find(key(t_chunk));
+    if (chunk == m_chunks.end()) {
+      return tiles;
+    }
+
+    std::ifstream ifs(m_file_path, std::ios::binary);
+    if (!ifs) {
+      throw std::runtime_error("Unable to open map file: '" + m_file_path + "'");
+    }
+
+    std::string text;
+    for (size_t layer = 0; layer < m_layers.size(); ++layer)
+    {
+      const auto &span = m_spans[chunk->second + layer];
+      if (span.length == 0) {
+        continue;
+      }
+
+      text.resize(span.length);
+      if (!ifs.seekg(std::streamoff(span.offset)) || !ifs.read(&text[0], std::streamsize(span.length))) {
+        throw std::runtime_error("Map file changed since its chunks were indexed: '" + m_file_path + "'");
+      }
+
+      const auto &format = m_layers[layer];
+      tiles[layer] = decode_text(text.c_str(), format.encoding.c_str(), format.compression.c_str(), cells);
+    }
+
+    return tiles;
+  }
+
+  size_t Chunk_Index::memory_bytes() const
+  {
+    // a node per chunk plus the bucket array
+    return m_spans.capacity() * sizeof(Span)
+      + m_chunks.size() * (sizeof(std::pair<const uint64_t, size_t>) + sizeof(void *))
+      + m_chunks.bucket_count() * sizeof(void *);
+  }
+
+  Map_File read_tmx_map(Job_System &t_jobs, const std::string &t_file_path)
+  {
+    const Xml_Document doc(read_file(t_file_path));
+    const auto &root = doc.root();
+
+    if (std::strcmp(root.name, "map") != 0) {
+      throw std::runtime_error("Not a TMX map: '" + t_file_path + "'");
+    }
+
+    const auto infinite = doc.attribute(root, "infinite");
+
+    Map_File map;
+    map.tile_size = sf::Vector2u(int_attribute(doc, root, "tilewidth"), int_attribute(doc, root, "tileheight"));
+    map.width = int_attribute(doc, root, "width");
+    map.height = int_attribute(doc, root, "height");
+
+    const auto directory = parent_path(t_file_path);
+
+    for (auto node = doc.first_child(root, "tileset"); node; node = doc.next_sibling(*node, "tileset"))
+    {
+      Map_File::Tileset tileset;
+      tileset.first_gid = int_attribute(doc, *node, "firstgid");
+
+      if (const auto source = doc.attribute(*node, "source"))
+      {
+        // external tileset, its image is relative to the .tsx
+        const auto tsx_path = directory + source;
+        const Xml_Document tsx(read_file(tsx_path));
+        read_tileset(tsx, tsx.root(), parent_path(tsx_path), tileset);
+      } else {
+        read_tileset(doc, *node, directory, tileset);
+      }
+
+      map.tilesets.push_back(std::move(tileset));
+    }
+
+    std::vector<Layer_Source> sources;
+    read_layers(doc, root, true, map, sources);
+
+    if (infinite && std::strcmp(infinite, "1") == 0)
+    {
+      map.chunks = index_chunks(doc, t_file_path, sources, map.layers.size());
+      SPICED_LOG(Map, Info, "Indexed " << t_file_path << ", " << map.chunks->memory_bytes() << " bytes for its chunks");
+      return map;
+    }
+
+    // the document is only read from here on, so layers can be decoded side by side
+    const auto cells = size_t(map.width) * map.height;
+    const auto decode = [&](const size_t t_begin, const size_t t_end) {
+      for (auto i = t_begin; i < t_end; ++i) {
+        map.layers[sources[i].layer].data = decode_layer(doc, *sources[i].data, cells);
+      }
+    };
+
+    if (cells * sources.size() < min_parallel_decode_tiles) {
+      decode(0, sources.size());
+    } else {
+      t_jobs.parallel_for(sources.size(), 1, decode);
+    }
+
+    return map;
+  }
+}
+
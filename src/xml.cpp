@@ -0,0 +1,353 @@
+#include "xml.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace spiced {
+  namespace {
+    const size_t none = size_t(-1);
+
+    /// [begin, end) of a string in the buffer, kept until parsing is done and it can be terminated
+    struct Span
+    {
+      size_t begin;
+      size_t end;
+    };
+
+    bool is_space(const char t_c)
+    {
+      return t_c == ' ' || t_c == '\t' || t_c == '\n' || t_c == '\r';
+    }
+
+    bool is_name_char(const char t_c)
+    {
+      return !is_space(t_c) && t_c != '/' && t_c != '>' && t_c != '<' && t_c != '=' && t_c != '\0';
+    }
+
+    /// Writes t_code as UTF-8 at t_out, returns the number of bytes written
+    size_t write_utf8(char *t_out, const unsigned long t_code)
+    {
+      if (t_code < 0x80) {
+        t_out[0] = char(t_code);
+        return 1;
+      } else if (t_code < 0x800) {
+        t_out[0] = char(0xC0 | (t_code >> 6));
+        t_out[1] = char(0x80 | (t_code & 0x3F));
+        return 2;
+      } else if (t_code < 0x10000) {
+        t_out[0] = char(0xE0 | (t_code >> 12));
+        t_out[1] = char(0x80 | ((t_code >> 6) & 0x3F));
+        t_out[2] = char(0x80 | (t_code & 0x3F));
+        return 3;
+      } else {
+        t_out[0] = char(0xF0 | (t_code >> 18));
+        t_out[1] = char(0x80 | ((t_code >> 12) & 0x3F));
+        t_out[2] = char(0x80 | ((t_code >> 6) & 0x3F));
+        t_out[3] = char(0x80 | (t_code & 0x3F));
+        return 4;
+      }
+    }
+  }
+
+  Xml_Document::Xml_Document(std::string t_text)
+    : m_buffer(std::move(t_text))
+  {
+    parse();
+  }
+
+  void Xml_Document::parse()
+  {
+    char *const data = &m_buffer[0];
+    const auto size = m_buffer.size();
+    size_t p = 0;
+
+    std::vector<Span> names;
+    std::vector<Span> texts;
+    std::vector<Span> attribute_names;
+    std::vector<Span> attribute_values;
+    std::vector<size_t> last_child;
+    std::vector<size_t> open;
+
+    const auto fail = [&p](const std::string &t_what) {
+      throw std::runtime_error("Malformed XML at offset " + std::to_string(p) + ": " + t_what);
+    };
+
+    const auto starts_with = [&](const char *t_prefix) {
+      return m_buffer.compare(p, std::strlen(t_prefix), t_prefix) == 0;
+    };
+
+    const auto skip_past = [&](const char *t_terminator) {
+      const auto pos = m_buffer.find(t_terminator, p);
+      if (pos == std::string::npos) {
+        fail(std::string("missing '") + t_terminator + "'");
+      }
+      p = pos + std::strlen(t_terminator);
+    };
+
+    const auto skip_spaces = [&]() {
+      while (p < size && is_space(data[p])) {
+        ++p;
+      }
+    };
+
+    const auto read_name = [&]() {
+      const auto begin = p;
+      while (p < size && is_name_char(data[p])) {
+        ++p;
+      }
+      if (p == begin) {
+        fail("expected a name");
+      }
+      return Span{begin, p};
+    };
+
+    // entities always decode to fewer bytes than they are spelled with, so this works in place
+    const auto decode = [&](const size_t t_begin, const size_t t_end) {
+      auto in = m_buffer.find('&', t_begin);
+      if (in == std::string::npos || in >= t_end) {
+        return t_end;
+      }
+
+      auto out = in;
+      while (in < t_end)
+      {
+        if (data[in] != '&') {
+          data[out++] = data[in++];
+          continue;
+        }
+
+        const auto semicolon = m_buffer.find(';', in);
+        if (semicolon == std::string::npos || semicolon >= t_end) {
+          fail("unterminated entity");
+        }
+
+        const char *entity = data + in + 1;
+        const auto length = semicolon - in - 1;
+
+        if (length == 2 && std::strncmp(entity, "lt", 2) == 0) {
+          data[out++] = '<';
+        } else if (length == 2 && std::strncmp(entity, "gt", 2) == 0) {
+          data[out++] = '>';
+        } else if (length == 3 && std::strncmp(entity, "amp", 3) == 0) {
+          data[out++] = '&';
+        } else if (length == 4 && std::strncmp(entity, "quot", 4) == 0) {
+          data[out++] = '"';
+        } else if (length == 4 && std::strncmp(entity, "apos", 4) == 0) {
+          data[out++] = '\'';
+        } else if (length > 1 && entity[0] == '#') {
+          const bool hex = entity[1] == 'x' || entity[1] == 'X';
+          char *digits_end = nullptr;
+          const auto code = std::strtoul(entity + (hex ? 2 : 1), &digits_end, hex ? 16 : 10);
+          if (digits_end != data + semicolon || code > 0x10FFFF) {
+            fail("invalid character reference");
+          }
+          out += write_utf8(data + out, code);
+        } else {
+          fail("unknown entity");
+        }
+
+        in = semicolon + 1;
+      }
+
+      return out;
+    };
+
+    // a UTF-8 byte order mark
+    if (starts_with("\xEF\xBB\xBF")) {
+      p = 3;
+    }
+
+    while (p < size)
+    {
+      if (data[p] != '<')
+      {
+        const auto begin = p;
+        p = std::min(m_buffer.find('<', p), size);
+
+        bool blank = true;
+        for (auto i = begin; i < p && blank; ++i) {
+          blank = is_space(data[i]);
+        }
+
+        if (!blank)
+        {
+          if (open.empty()) {
+            fail("text outside of the root element");
+          }
+
+          auto &text = texts[open.back()];
+          if (text.begin == none) {
+            text = Span{begin, decode(begin, p)};
+          }
+        }
+        continue;
+      }
+
+      if (starts_with("<?")) {
+        skip_past("?>");
+      } else if (starts_with("<!--")) {
+        skip_past("-->");
+      } else if (starts_with("<![CDATA[")) {
+        const auto begin = p + 9;
+        skip_past("]]>");
+        if (!open.empty() && texts[open.back()].begin == none) {
+          texts[open.back()] = Span{begin, p - 3};
+        }
+      } else if (starts_with("<!")) {
+        skip_past(">");
+      } else if (starts_with("</")) {
+        p += 2;
+        const auto name = read_name();
+        skip_spaces();
+        if (p >= size || data[p] != '>') {
+          fail("expected '>'");
+        }
+        ++p;
+
+        if (open.empty()) {
+          fail("closing tag without an open element");
+        }
+
+        const auto &open_name = names[open.back()];
+        if (m_buffer.compare(open_name.begin, open_name.end - open_name.begin, data + name.begin, name.end - name.begin) != 0) {
+          fail("closing tag does not match '" + m_buffer.substr(open_name.begin, open_name.end - open_name.begin) + "'");
+        }
+        open.pop_back();
+      } else {
+        ++p;
+
+        if (open.empty() && !m_nodes.empty()) {
+          fail("more than one root element");
+        }
+
+        const auto index = m_nodes.size();
+        m_nodes.push_back(Node{nullptr, nullptr, attribute_names.size(), 0, none, none});
+        names.push_back(read_name());
+        texts.push_back(Span{none, none});
+        last_child.push_back(none);
+
+        if (!open.empty())
+        {
+          const auto parent = open.back();
+          if (last_child[parent] == none) {
+            m_nodes[parent].first_child = index;
+          } else {
+            m_nodes[last_child[parent]].next_sibling = index;
+          }
+          last_child[parent] = index;
+        }
+
+        for (;;)
+        {
+          skip_spaces();
+          if (p >= size) {
+            fail("unterminated element");
+          }
+
+          if (data[p] == '/') {
+            if (p + 1 >= size || data[p + 1] != '>') {
+              fail("expected '>'");
+            }
+            p += 2;
+            break;
+          }
+
+          if (data[p] == '>') {
+            ++p;
+            open.push_back(index);
+            break;
+          }
+
+          const auto name = read_name();
+          skip_spaces();
+          if (p >= size || data[p] != '=') {
+            fail("expected '='");
+          }
+          ++p;
+          skip_spaces();
+          if (p >= size || (data[p] != '"' && data[p] != '\'')) {
+            fail("expected a quoted value");
+          }
+
+          const auto quote = data[p++];
+          const auto begin = p;
+          const auto end = m_buffer.find(quote, p);
+          if (end == std::string::npos) {
+            fail("unterminated attribute value");
+          }
+          p = end + 1;
+
+          attribute_names.push_back(name);
+          attribute_values.push_back(Span{begin, decode(begin, end)});
+          ++m_nodes[index].attribute_count;
+        }
+      }
+    }
+
+    if (!open.empty()) {
+      fail("unclosed element '" + m_buffer.substr(names[open.back()].begin, names[open.back()].end - names[open.back()].begin) + "'");
+    }
+    if (m_nodes.empty()) {
+      fail("no root element");
+    }
+
+    // every string's end is a delimiter nothing else refers to, so they can all be terminated now
+    const auto terminate = [data](const Span &t_span) -> const char * {
+      data[t_span.end] = '\0';
+      return data + t_span.begin;
+    };
+
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+      m_nodes[i].name = terminate(names[i]);
+      m_nodes[i].text = texts[i].begin == none ? "" : terminate(texts[i]);
+    }
+
+    m_attributes.reserve(attribute_names.size());
+    for (size_t i = 0; i < attribute_names.size(); ++i)
+    {
+      m_attributes.push_back(Attribute{terminate(attribute_names[i]), terminate(attribute_values[i])});
+    }
+  }
+
+  const Xml_Document::Node &Xml_Document::root() const
+  {
+    return m_nodes.front();
+  }
+
+  const char *Xml_Document::attribute(const Node &t_node, const char *t_name) const
+  {
+    for (size_t i = t_node.first_attribute; i < t_node.first_attribute + t_node.attribute_count; ++i)
+    {
+      if (std::strcmp(m_attributes[i].name, t_name) == 0) {
+        return m_attributes[i].value;
+      }
+    }
+    return nullptr;
+  }
+
+  const Xml_Document::Node *Xml_Document::first_child(const Node &t_node, const char *t_name) const
+  {
+    auto index = t_node.first_child;
+    while (index != none && t_name && std::strcmp(m_nodes[index].name, t_name) != 0) {
+      index = m_nodes[index].next_sibling;
+    }
+    return index == none ? nullptr : &m_nodes[index];
+  }
+
+  const Xml_Document::Node *Xml_Document::next_sibling(const Node &t_node, const char *t_name) const
+  {
+    auto index = t_node.next_sibling;
+    while (index != none && t_name && std::strcmp(m_nodes[index].name, t_name) != 0) {
+      index = m_nodes[index].next_sibling;
+    }
+    return index == none ? nullptr : &m_nodes[index];
+  }
+
+  size_t Xml_Document::offset(const char *t_text) const
+  {
+    return size_t(t_text - m_buffer.data());
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef GAME_ENGINE_XML_HPP
+#define GAME_ENGINE_XML_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace spiced
+{
+  /// In-place XML parser, enough for Tiled's TMX and TSX files: elements, attributes, text, CDATA,
+  /// comments, processing instructions and the predefined and numeric character entities.
+  /// DTDs are skipped and namespaces are not interpreted.
+  ///
+  /// The document owns its text. Parsing decodes and terminates names, values and text inside
+  /// that buffer, so nothing is copied and every string handed out lives as long as the document.
+  class Xml_Document
+  {
+  public:
+    struct Node
+    {
+      const char *name;
+
+      /// First run of character data directly inside the element, untrimmed, "" if there is none
+      const char *text;
+
+      size_t first_attribute;
+      size_t attribute_count;
+      size_t first_child;
+      size_t next_sibling;
+    };
+
+    /// Throws std::runtime_error, with the offset, if t_text is not well formed
+    explicit Xml_Document(std::string t_text);
+    Xml_Document(const Xml_Document &) = delete;
+    Xml_Document &operator=(const Xml_Document &) = delete;
+
+    const Node &root() const;
+
+    /// Value of attribute t_name of t_node, nullptr if it has none
+    const char *attribute(const Node &t_node, const char *t_name) const;
+
+    /// First child of t_node, or first child named t_name. nullptr if there is none
+    const Node *first_child(const Node &t_node, const char *t_name = nullptr) const;
+
+    /// Next sibling of t_node, or next sibling named t_name. nullptr if there is none
+    const Node *next_sibling(const Node &t_node, const char *t_name = nullptr) const;
+
+    /// Offset of t_text, a string handed out by this document, from the start of the parsed text.
+    /// Character data without entities is left as it was, so it can be read again from there later.
+    size_t offset(const char *t_text) const;
+
+  private:
+    struct Attribute
+    {
+      const char *name;
+      const char *value;
+    };
+
+    void parse();
+
+    std::string m_buffer;
+    std::vector<Node> m_nodes;
+    std::vector<Attribute> m_attributes;
+  };
+}
+
+#endif